@@ -56,6 +56,27 @@ vcparser.updateAnniversary.restype = c_int
 vcparser.newCard.argtypes = []
 vcparser.newCard.restype = c_void_p
 
+# Set up createCardWithSource and writeCardIncremental, so edits only rewrite the changed lines
+vcparser.createCardWithSource.argtypes = [c_char_p, POINTER(c_void_p), POINTER(c_void_p)]
+vcparser.createCardWithSource.restype = c_int
+vcparser.writeCardIncremental.argtypes = [c_char_p, c_void_p, c_void_p]
+vcparser.writeCardIncremental.restype = c_int
+vcparser.deleteCardSource.argtypes = [c_void_p]
+vcparser.deleteCardSource.restype = None
+
+# Set up the directory watcher, so the card list only re-parses the files that changed
+class WatchEvent(Structure):
+    _fields_ = [("type", c_int), ("fileName", c_char_p), ("card", c_void_p), ("error", c_int)]
+
+WATCH_ADDED, WATCH_CHANGED, WATCH_REMOVED, WATCH_INVALID = range(4)
+WatchCallback = CFUNCTYPE(None, POINTER(WatchEvent), c_void_p)
+vcparser.vcWatchDirectory.argtypes = [c_char_p, WatchCallback, c_void_p]
+vcparser.vcWatchDirectory.restype = c_void_p
+vcparser.vcProcessWatchEvents.argtypes = [c_void_p, c_int]
+vcparser.vcProcessWatchEvents.restype = c_int
+vcparser.vcStopWatching.argtypes = [c_void_p]
+vcparser.vcStopWatching.restype = None
+
 
 # Python wrapper functions for C library
 #Create Card wrapper function
@@ -82,6 +103,17 @@ def writeCard_c(filename, card_ptr):
     #print(f"Python wrapper: writeCard returned {returnCode}")
     return returnCode
 
+#Create Card wrapper that also remembers where each line of the card is in the file
+def createCardWithSource_c(filename):
+    card_ptr = c_void_p()
+    source_ptr = c_void_p()
+    returnCode = vcparser.createCardWithSource(filename.encode("utf-8"), byref(card_ptr), byref(source_ptr))
+    return returnCode, card_ptr.value, source_ptr.value
+
+#Write Card wrapper that only rewrites what changed since createCardWithSource_c
+def writeCardIncremental_c(filename, card_ptr, source_ptr):
+    return vcparser.writeCardIncremental(filename.encode("utf-8"), c_void_p(card_ptr), c_void_p(source_ptr))
+
 #Get FN wrapper function, which is a helper function that extracts the FN field from a Card.
 def get_fn(card_ptr):
     result = vcparser.getFN(c_void_p(card_ptr))
@@ -270,20 +302,43 @@ class VCardModel():
         self._vcards = []  # List of valid vCard filenames.
         self.current_data = {}  # Dictionary holding data of the currently loaded card.
         self.current_card_ptr = None  # Pointer (int) to the current card (from C library).
+        self.current_source_ptr = None  # Where the current card's lines are in its file, for incremental writes.
         self.db_manager = db_manager  # Instance of DatabaseManager.
+        self._watcher = None  # Watches the cards folder, so a reload only handles the files that changed.
+        self._watch_callback = WatchCallback(self._on_watch_event)  # Kept so ctypes doesn't free it
         self._reload()
 
     def _reload(self):
         #print("Reloading vCard list from disk...")
-        self._vcards = scan_cards_folder("cards")
+        if self._watcher is not None and vcparser.vcProcessWatchEvents(self._watcher, 0) < 0:
+            # The folder is gone or was replaced: drop the watcher and watch (or scan) it again below
+            print("Error: the cards folder can't be watched any more.")
+            vcparser.vcStopWatching(self._watcher)
+            self._watcher = None
+        if self._watcher is None:
+            # The first scan reports every card in the folder through _on_watch_event
+            self._watcher = vcparser.vcWatchDirectory(b"cards", self._watch_callback, None)
+            if self._watcher is None:
+                # Can't watch the folder, fall back to scanning all of it
+                self._vcards = scan_cards_folder("cards")
+                for filename in self._vcards:
+                    self._loadFileToDB(filename)
         #print("Valid vCard files found:", self._vcards)
-        
-        # For each valid file, insert into database
-        for filename in self._vcards:
-            self._loadFileToDB(filename)
+
+    #Keep the list of valid files and the database in step with a change in the cards folder
+    def _on_watch_event(self, event, context):
+        filename = event.contents.fileName.decode("utf-8")
+        if event.contents.type in (WATCH_ADDED, WATCH_CHANGED):
+            if filename not in self._vcards:
+                self._vcards.append(filename)
+            # The watcher has parsed and validated the card already, and keeps it until the next event for the file
+            self._storeCardInDB(filename, event.contents.card)
+        elif filename in self._vcards:
+            self._vcards.remove(filename)
 
     #Get the list of vCard files
     def get_vcard_list(self):
+        self._reload()
         #Return a list of tuples where each tuple is (display_name, return_value)
         return [(f, f) for f in self._vcards] 
 
@@ -291,10 +346,12 @@ class VCardModel():
     def load_vcard(self, filename):
         #print(f"load_vcard() called for file: {filename}")
         full_path = os.path.join("cards", filename)
-        ret, card_ptr = createCard_c(full_path) #Create the card
+        ret, card_ptr, source_ptr = createCardWithSource_c(full_path) #Create the card
         if ret == 0 and card_ptr is not None:
             if validateCard_c(card_ptr) == 0:
+                vcparser.deleteCardSource(self.current_source_ptr)
                 self.current_card_ptr = card_ptr
+                self.current_source_ptr = source_ptr
                 #Get the FN, birthday, and anniversary fields from the card
                 fn = get_fn(card_ptr)
                 bday = get_birthday(card_ptr)
@@ -318,6 +375,7 @@ class VCardModel():
                 self.db_manager.insert_contact(fn, bday if bday != "" else None, anniv if anniv != "" else None, file_id)
             else:
                 #print(f"Error: validateCard failed for file {filename}")
+                vcparser.deleteCardSource(source_ptr)
                 self.current_data = {}
         else:
             #print(f"Error: createCard failed for file {filename}")
@@ -363,6 +421,8 @@ class VCardModel():
         self._vcards.append(data["filename"])
         self.current_data = data
         self.current_card_ptr = new_card_ptr
+        vcparser.deleteCardSource(self.current_source_ptr)
+        self.current_source_ptr = None
 
         # Update the database.
         now = datetime.now().strftime("%Y-%m-%d %H:%M:%S")
@@ -379,7 +439,7 @@ class VCardModel():
             update_fn(self.current_card_ptr, data["contactName"])
             update_birthday(self.current_card_ptr, data["birthday"])
             update_anniversary(self.current_card_ptr, data["anniversary"])
-            ret = writeCard_c(file_path, self.current_card_ptr)
+            ret = writeCardIncremental_c(file_path, self.current_card_ptr, self.current_source_ptr)
             #print(f"update_vcard: writeCard returned {ret}")
             if ret != 0:
                 print("Error: writeCard failed during update.")
@@ -455,6 +515,12 @@ class VCardModel():
         if validCode != 0:
             ##print(f"Error: Card '{filename}' is invalid (validateCard code {validCode}).")
             return
+        self._storeCardInDB(filename, card_ptr)
+
+    #Insert or update the FILE and CONTACT rows of a valid card
+    def _storeCardInDB(self, filename, card_ptr):
+        full_path = os.path.join("cards", filename)
+
         # Extract relevant data from the Card to store in DB.
         # If these are empty strings, we might store None in the DB
         fn = get_fn(card_ptr)
@@ -24,6 +24,12 @@ typedef struct listNode{
     struct listNode* next;
 } Node;
 
+/**
+ * Optional hash index over the nodes of a list, see createListIndex.
+ * The layout is private to LinkedListAPI.c.
+ **/
+typedef struct listIndex ListIndex;
+
 /**
  * Metadata head of the list. 
  * Contains no actual data but contains
@@ -37,6 +43,7 @@ typedef struct listHead{
     void (*deleteData)(void* toBeDeleted);
     int (*compare)(const void* first,const void* second);
     char* (*printData)(void* toBePrinted);
+    ListIndex* index; //NULL unless createListIndex was called
 } List;
 
 
@@ -214,4 +221,34 @@ int getLength(List* list);
  **/
 void* findElement(List * list, bool (*customCompare)(const void* first,const void* second), const void* searchRecord);
 
+
+/** Builds a hash index over the list so that findIndexedElement and deleteDataFromList run in O(1) expected time.
+ * The index is kept in sync by insertFront, insertBack, insertSorted, deleteDataFromList and clearList,
+ * and is freed by freeList. Two elements are considered equal when the list's compare function returns 0,
+ * and elements that compare equal must have the same hash.
+ *@pre List exists and is valid. Data must not be changed in a way that changes its hash while it is in the list.
+ *@post Every element currently in the list is indexed. An existing index is replaced.
+ *@return true on success, false if the arguments are invalid or memory could not be allocated (the list is left unindexed)
+ *@param list - a pointer to the List struct
+ *@param hashFunction - a pointer to a function that hashes a single piece of data
+ **/
+bool createListIndex(List* list, unsigned long (*hashFunction)(const void* data));
+
+
+/** Frees the hash index of the list, if it has one. The list itself is not changed.
+ *@param list - a pointer to the List struct
+ **/
+void removeListIndex(List* list);
+
+
+/** Searches for an element equal to searchRecord according to the list's compare function.
+ * Uses the hash index when the list has one, otherwise falls back to a linear scan.
+ *@pre List exists and is valid.
+ *@post List remains unchanged.
+ *@return The data associated with the matching list element, or NULL if element is not found.
+ *@param list - a pointer to the List sruct
+ *@param searchRecord - a pointer to search data, of the same type as the data in the list
+ **/
+void* findIndexedElement(List* list, const void* searchRecord);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+/**
+ * @file StringBuilder.h
+ * @brief File containing the function definitions of a growable string buffer.
+ * The builder tracks its own length, so appending never rescans the string,
+ * and its capacity doubles when it runs out, so building a string of n bytes is O(n).
+ */
+
+#ifndef _STRING_BUILDER_
+#define _STRING_BUILDER_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * Growable string. data is always null-terminated, length does not include the terminator.
+ **/
+typedef struct stringBuilder{
+    char* data;
+    size_t length;
+    size_t capacity;
+} StringBuilder;
+
+
+/** Function to initialize a string builder with an empty string.
+*@pre sb must not be NULL
+*@post sb holds an empty, null-terminated string
+*@return true on success, false if malloc fails
+*@param sb - pointer to the StringBuilder to initialize
+*@param initialCapacity - number of bytes to reserve up front (0 picks a small default)
+**/
+bool initializeStringBuilder(StringBuilder* sb, size_t initialCapacity);
+
+
+/** Makes sure the builder can hold extra more bytes without growing again.
+*@pre sb has been initialized
+*@return true on success, false if the allocation fails (the builder is left unchanged)
+*@param sb - pointer to the StringBuilder
+*@param extra - number of bytes that are about to be appended
+**/
+bool reserveStringBuilder(StringBuilder* sb, size_t extra);
+
+
+/** Appends the first count bytes of chars to the builder.
+*@pre sb has been initialized
+*@return true on success, false if the allocation fails
+*@param sb - pointer to the StringBuilder
+*@param chars - bytes to append, do not need to be null-terminated
+*@param count - number of bytes to append
+**/
+bool appendChars(StringBuilder* sb, const char* chars, size_t count);
+
+
+/** Appends a null-terminated string to the builder. NULL is treated as an empty string.
+*@pre sb has been initialized
+*@return true on success, false if the allocation fails
+*@param sb - pointer to the StringBuilder
+*@param str - string to append
+**/
+bool appendString(StringBuilder* sb, const char* str);
+
+
+/** Appends a single character to the builder.
+*@pre sb has been initialized
+*@return true on success, false if the allocation fails
+*@param sb - pointer to the StringBuilder
+*@param c - character to append
+**/
+bool appendChar(StringBuilder* sb, char c);
+
+
+/** Hands the built string over to the caller and resets the builder to an uninitialized state.
+*@pre sb has been initialized
+*@post sb no longer owns the string. It must be initialized again before reuse.
+*@return the built string (must be freed by the caller), or NULL if the builder was never initialized
+*@param sb - pointer to the StringBuilder
+**/
+char* detachString(StringBuilder* sb);
+
+
+/** Frees the memory owned by the builder.
+*@post sb->data is NULL, length and capacity are 0
+*@param sb - pointer to the StringBuilder
+**/
+void freeStringBuilder(StringBuilder* sb);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _VCALLOC_H
+#define _VCALLOC_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*	Allocator used for every allocation made by the library (cards, properties, list nodes, strings).
+	The functions follow the contract of malloc, realloc and free; context is passed back unchanged
+	so an arena or a counting allocator can find its state. free is never called with NULL.
+*/
+typedef struct vcAllocator {
+	void*	(*malloc)(void* context, size_t size);
+	void*	(*realloc)(void* context, void* ptr, size_t size);
+	void	(*free)(void* context, void* ptr);
+	void*	context;
+} VCAllocator;
+
+/** Sets the allocator used by all threads that don't have their own (see vcSetThreadAllocator).
+ *@pre No other thread is using the library while the allocator changes
+ *@param allocator - the allocator to copy, NULL restores malloc/realloc/free
+ *@return false (and nothing changes) if one of the functions is missing, true otherwise
+ **/
+bool vcSetAllocator(const VCAllocator* allocator);
+
+/** Sets the allocator for the calling thread only, e.g. a per-request arena around one createCard call.
+ *@param allocator - the allocator to copy, NULL makes the thread use the global allocator again
+ *@return false (and nothing changes) if one of the functions is missing, true otherwise
+ **/
+bool vcSetThreadAllocator(const VCAllocator* allocator);
+
+/** Allocation functions of the library, they go through the allocator of the calling thread.
+ *  Memory returned by the library (e.g. the string from cardToString) must be released with vcFree,
+ *  and a Card must be deleted while the allocator that created it is active.
+ *  With the default allocator vcFree is the same as free.
+ **/
+void* vcMalloc(size_t size);
+void* vcCalloc(size_t count, size_t size);
+void* vcRealloc(void* ptr, size_t size);
+void vcFree(void* ptr);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _VCBLOB_H
+#define _VCBLOB_H
+
+#include "VCParser.h"
+
+/*	Large base64 values of PHOTO, KEY and LOGO.
+	When a PHOTO, KEY or LOGO line holds base64 data (a data: URI with ;base64, or ENCODING=b), the parser does
+	not copy its value out of the card file. The folds are taken out in place, the values list points at the text
+	in the file, and the file stays in memory as long as a property (or a copy of one) uses it. Nothing is decoded
+	while parsing; getPropertyBlob decodes the data when it is asked for.
+	The values of such a property must not be freed or replaced by hand; delete or copy the whole property instead.
+*/
+
+/** Function to decode the base64 data of a property, e.g. PHOTO:data:image/jpeg;base64,... or
+ *  a 3.0 style PHOTO;ENCODING=b:... The data is decoded again on every call.
+ *@return OK, INV_PROP if the value holds no base64 data (e.g. it is a URI) or is not valid base64,
+		  OTHER_ERROR if the allocation failed
+ *@param property - the property, any property with base64 data works, not only those kept in the card file
+		 data - receives the decoded bytes, freed with vcFree
+		 length - receives the number of bytes
+ **/
+VCardErrorCode getPropertyBlob(const Property* property, unsigned char** data, size_t* length);
+
+/** Function to get the base64 text of a property without decoding or copying it.
+ *@return the text, owned by the property; NULL if the value holds no base64 data
+ *@param property - the property
+		 length - receives the length of the text
+ **/
+const char* getPropertyBlobText(const Property* property, size_t* length);
+
+/** Tells whether the values of a property point into the card file it was read from.
+ **/
+bool isBlobProperty(const Property* property);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _VCDIFF_H
+#define _VCDIFF_H
+
+#include "VCParser.h"
+#include "VectorAPI.h"
+
+/*	Edit scripts between two versions of a card.
+	diffCards compares two cards and returns the edits that turn the first into the second, as a Vector
+	of CardEdit. Optional properties are matched by name, group and parameters (all exact, parameters
+	in order) and keep their relative order, so a property whose values changed becomes one CHANGE edit,
+	and everything else is a REMOVE or an ADD. applyCardPatch replays the script on a copy of the first card.
+*/
+
+typedef enum cardEditType { EDIT_REMOVE, EDIT_ADD, EDIT_CHANGE, EDIT_FN, EDIT_BIRTHDAY, EDIT_ANNIVERSARY } CardEditType;
+
+typedef struct cardEdit {
+	CardEditType	type;
+
+	//REMOVE, ADD and CHANGE: position in the optional property list at the time the edit is applied
+	int	index;
+
+	//ADD, CHANGE and FN: the property as it is in the new card. NULL for the other types
+	Property*	property;
+
+	//BIRTHDAY and ANNIVERSARY: the new date, NULL if the new card has none
+	DateTime*	dateTime;
+} CardEdit;
+
+/** Compares two cards and builds the edit script from the first to the second.
+ *  The edits are ordered for applyCardPatch: removals from the back, then additions from the front,
+ *  then changes, then FN and the dates.
+ *@pre both cards are valid Card structures
+ *@post the cards have not been modified, the edits hold copies of everything they need
+ *@return a Vector of CardEdit (empty if the cards are the same), to be freed with freeVector,
+		  or NULL if a card is NULL or an allocation failed
+ *@param from - the old version
+		 to - the new version
+ **/
+Vector* diffCards(const Card* from, const Card* to);
+
+/** Applies an edit script made by diffCards to the old version of the card.
+ *  Either every edit is applied or, on error, the card is left unchanged.
+ *@pre patch was made by diffCards with a card equal to card as the old version
+ *@post card is equal to the new version; patch is unchanged and can be applied to other copies
+ *@return OK, INV_CARD if the card or the patch is NULL, INV_PROP if an edit does not fit the card,
+		  OTHER_ERROR if an allocation failed
+ *@param card - the card to update
+		 patch - the edit script
+ **/
+VCardErrorCode applyCardPatch(Card* card, const Vector* patch);
+
+// ************* Vector helper functions for CardEdit ***************
+void deleteCardEdit(void* toBeDeleted);
+int compareCardEdits(const void* first,const void* second);
+char* cardEditToString(void* edit);
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ * @file VCGen.h
+ * @brief Synthetic vCard 4.0 corpus generator, used by the vcgen tool and the benchmark driver.
+ * Every card is generated from its own seed, derived from the corpus seed and the card number,
+ * so the same options always produce byte-identical files, independent of how many cards are generated.
+ */
+
+#ifndef _VCGEN_H
+#define _VCGEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//Kinds of optional properties the generator can emit, used to index the property mix
+typedef enum genProp { GEN_N, GEN_ADR, GEN_TEL, GEN_EMAIL, GEN_GEO, GEN_ORG, GEN_PROP_COUNT } GenProperty;
+
+//How value lengths are picked between valueMin and valueMax
+typedef enum genDist { GEN_UNIFORM, GEN_LONG_TAIL } GenDistribution;
+
+typedef struct genOptions {
+	uint64_t seed;
+
+	//Number of optional properties per card
+	int properties;
+
+	//Relative weight of each property kind. N is emitted at most once per valid card.
+	int mix[GEN_PROP_COUNT];
+
+	//Fraction (0-1) of properties written with a group prefix, e.g. "item3.TEL"
+	double groupFraction;
+
+	//Average number of parameters per property
+	double parameterDensity;
+
+	//Column at which lines are folded, and the fraction (0-1) of longer lines that get folded.
+	//Lines longer than 1000 bytes are always folded.
+	int foldWidth;
+	double foldFraction;
+
+	//Length of free text values (ORG, street, e-mail user name)
+	int valueMin;
+	int valueMax;
+	GenDistribution distribution;
+
+	//Fraction (0-1) of cards that are made invalid in one random way
+	double invalidFraction;
+} GeneratorOptions;
+
+
+/** Fills in the default options: 10 properties with an even mix, 1 parameter per property,
+ * folding at 75 columns, 5-40 character values and no invalid cards.
+ *@param options - pointer to the options to initialize
+ **/
+void initializeGeneratorOptions(GeneratorOptions* options);
+
+
+/** Parses a property mix such as "N=1,ADR=2,TEL=4" into options->mix. Kinds that are not listed get weight 0.
+ *@return true on success, false if the string names an unknown kind or a negative weight
+ *@param options - pointer to the options to update
+ *@param mix - comma separated list of KIND=weight pairs
+ **/
+bool parsePropertyMix(GeneratorOptions* options, const char* mix);
+
+
+/** Writes card number cardNumber of the corpus described by options to a stream.
+ *@return 0 on success, -1 on a write error
+ *@param file - stream to write the card to
+ *@param options - pointer to the generator options
+ *@param cardNumber - position of the card in the corpus, selects its seed
+ *@param invalid - set to true if the card was deliberately made invalid, may be NULL
+ **/
+int writeGeneratedCard(FILE* file, const GeneratorOptions* options, long cardNumber, bool* invalid);
+
+
+/** Writes card number cardNumber of the corpus to its own file.
+ *@return 0 on success, -1 if the file could not be written
+ *@param fileName - path of the file to create
+ *@param options - pointer to the generator options
+ *@param cardNumber - position of the card in the corpus, selects its seed
+ *@param invalid - set to true if the card was deliberately made invalid, may be NULL
+ **/
+int generateCardFile(const char* fileName, const GeneratorOptions* options, long cardNumber, bool* invalid);
+
+#endif
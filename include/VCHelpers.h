@@ -1,7 +1,104 @@
 #include "VCParser.h"
+#include "StringBuilder.h"
+#include "VCStats.h"
+#include "VCAlloc.h"
+#include "VCTrace.h"
+
+//Per-thread counters behind vcGetStats, and the clock used to time the parser phases
+extern _Thread_local VCStats threadStats;
+unsigned long long statsNow(void);
+void addStats(VCStats *into, const VCStats *from);
+
+//PHOTO, KEY and LOGO values that stay in the card file, see VCBlob.c
+typedef struct blobSource BlobSource;
+
+//The properties a parse is limited to, see VCProjection.h
+typedef struct cardProjection CardProjection;
+bool projectionKeepsLine(const CardProjection *projection, const char *line, size_t length, bool legacy);
+
+//Reads logical lines out of a card that is already in memory. Keeps no other state,
+//so any number of cards can be parsed at the same time.
+typedef struct lineReader {
+    const char *data;
+    size_t length;
+    size_t position;   //Offset of the next physical line
+    size_t lineOffset; //Offset where the last logical line returned by readAndCombineLines starts
+    bool legacy;       //Set by the parser for vCard 2.1 and 3.0: quoted-printable soft line breaks, no UTF-8 check
+    char *buffer;      //data again if the reader owns it and may keep it for blob values, NULL if it belongs to the caller
+    BlobSource *blobSource; //Where blob values are kept, the reader holds one reference. NULL until the first one
+    char *blobValue;   //Value of the last line if it is a blob, unfolded in place and null-terminated. NULL otherwise
+    const CardProjection *projection; //Lines of other properties are skipped, NULL keeps every line
+} LineReader;
+
+//Reading vCard 2.1 and 3.0 cards, see VCLegacy.c
+bool isQuotedPrintableLine(const char *line, size_t length);
+bool isBase64Line(const char *line, size_t length);
+char *convertLegacyLine(const char *line, VCardErrorCode *error);
+bool addLegacyFN(Card *card);
+
+//Blob values, see VCBlob.h
+size_t findBlobValue(const char *line, size_t length);
+bool readBlobValue(LineReader *reader, size_t start, size_t end, VCardErrorCode *error);
+void useBlobSource(Property *property, BlobSource *source);
+void releaseBlobSource(BlobSource *source);
+
+//Spans of the source file each part of a card came from, see VCSource.h
+typedef struct cardSource CardSource;
+void recordSourceSpan(CardSource *source, const void *part, const LineReader *reader);
+void markSourceBroken(CardSource *source);
+
+//Typed N and ADR components, see VCStructured.h
+typedef struct structuredValue StructuredValue;
+int structuredComponentCount(const char *name);
+StructuredValue *parseStructuredValue(const char *name, const char *raw);
+StructuredValue *copyStructuredValue(const StructuredValue *value);
+
+//Layout of a Property allocated by createProperty. The list heads live right after the
+//Property, and the name and group strings are packed in after them, so a property costs
+//one malloc instead of five. Only the list nodes, the values and the typed view are separate.
+//Property is a public struct, so a property may also be built by hand field by field; propertyBlock
+//tells the two apart, and only a block has the structured and blob extras.
+typedef struct propertyBlock {
+    Property property;
+    List parameters;
+    List values;
+    StructuredValue *structured; //N and ADR only, NULL otherwise
+    BlobSource *blob;            //Holds the card file the values point into, for blob values only, NULL otherwise
+    size_t stringBytes;          //Size of the name and group packed after the block
+} PropertyBlock;
+PropertyBlock *propertyBlock(const Property *property);
+void freePropertyString(const Property *property, char *string);
 
 //Helper functions for the parser
-char *readAndCombineLines(FILE *file, VCardErrorCode *error);
+VCardErrorCode loadCard(const char *fileName, Card **obj, CardSource *source, const CardProjection *projection);
+VCardErrorCode parseCardBuffer(const char *data, size_t length, bool owned, const CardProjection *projection, Card **obj);
+bool hasCardExtension(const char *fileName);
+char *readCardFile(const char *fileName, size_t *length, VCardErrorCode *error);
+void initializeLineReader(LineReader *reader, const char *data, size_t length);
+void initializeOwningLineReader(LineReader *reader, char *data, size_t length);
+void finishLineReader(LineReader *reader);
+char *readAndCombineLines(LineReader *reader, VCardErrorCode *error);
+bool isValidUtf8(const char *data, size_t length);
+Property *createProperty(const char *name, const char *group);
+
+//Helper functions to copy the parts of a card, shared by cloneCard and the shared cards
+char *copyString(const char *str);
+Parameter *copyParameter(const Parameter *parameter);
+Property *copyProperty(const Property *property);
+DateTime *copyDate(const DateTime *dateTime);
+
+//Escapes of property values (\\ \n \; \,), decoded while parsing and added back by the writers
+const char *unescapeValue(const char *src, const char *end, char *dst, size_t *length,
+                          bool splitAtSemicolon, bool keepCommaEscapes);
+bool appendEscapedValue(StringBuilder *sb, const char *value, bool keepCommaEscapes, bool escapeCommas);
+bool keepsCommaEscapes(const char *name);
+bool isUriValue(const Property *property);
+
+//Helper functions to serialize a card, shared by the toString functions and writeCard
+bool appendProperty(StringBuilder *sb, const Property *property);
+bool appendDateTime(StringBuilder *sb, const DateTime *dateTime);
+bool appendCard(StringBuilder *sb, const Card *obj);
+bool endLine(StringBuilder *sb, size_t lineStart);
 
 //Helper functions to validate the card and it's different components
 VCardErrorCode validateDateTime(const DateTime *dt);
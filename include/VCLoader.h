@@ -0,0 +1,72 @@
+#ifndef _VCLOADER_H
+#define _VCLOADER_H
+
+#include "VCParser.h"
+#include "VCProjection.h"
+#include "VCScan.h"
+
+/*	Batch loader for scanning many small card files.
+	Files are opened, read and closed in batches through io_uring, so a batch of hundreds of files
+	costs three submissions instead of three or four system calls per file. When io_uring is not
+	available (old kernel, seccomp profile), or the kernel lacks one of the opcodes a batch uses
+	(before 5.6), the loader falls back to plain open/read/close.
+	A loader is not thread safe, use one per thread.
+*/
+typedef struct vcLoader VCLoader;
+
+typedef struct loadedFile {
+	//File contents followed by a null byte, allocated with vcMalloc. NULL if the file could not be read
+	char*	data;
+	size_t	length;
+
+	//0, or the errno value of the open, stat or read that failed
+	int	error;
+} LoadedFile;
+
+/** Creates a loader.
+ *@param batchSize - number of files submitted together, 0 for the default (256)
+ *@param useIoUring - false forces the plain system call path
+ *@return the new loader, or NULL if the allocation failed. Must be freed with deleteLoader.
+ **/
+VCLoader* createLoader(int batchSize, bool useIoUring);
+
+/** Frees a loader and its io_uring instance.
+ **/
+void deleteLoader(VCLoader* loader);
+
+/** Tells whether the loader is using io_uring or the fallback path.
+ **/
+bool loaderUsesIoUring(const VCLoader* loader);
+
+/** Reads count whole files into memory.
+ *@pre files has room for count entries
+ *@post every entry of files is set; the caller frees each data with vcFree
+ *@param loader - the loader
+		 fileNames - the files to read
+		 count - number of files
+		 files - receives the contents, files[i] belongs to fileNames[i]
+ **/
+void loadFiles(VCLoader* loader, char* const* fileNames, int count, LoadedFile* files);
+
+/** Loads and parses count card files, batch by batch, straight from the loaded buffers.
+ *  Each file gets the same result as createCard would give it (createCardWithProjection after setLoaderProjection).
+ *@pre cards and errors have room for count entries
+ *@post cards[i] is the parsed card (to be freed with deleteCard) when errors[i] is OK, NULL otherwise
+ *@return the number of cards that were parsed successfully
+ **/
+int createCardsFromFiles(VCLoader* loader, char* const* fileNames, int count, Card** cards, VCardErrorCode* errors);
+
+/** Same as createCardsFromFiles, parsing only the files whose card matches a filter (see VCScan.h).
+ *  The other files are read and matched, but no Card is built for them.
+ *@post cards[i] is the parsed card (to be freed with deleteCard) when the file matched and errors[i] is OK;
+		cards[i] is NULL with errors[i] OK when the file did not match, or could not be read as a card far enough to match
+ *@return the number of matching cards that were parsed successfully
+ **/
+int scanCardFiles(VCLoader* loader, char* const* fileNames, int count, const CardFilter* filter, Card** cards, VCardErrorCode* errors);
+
+/** Makes createCardsFromFiles and scanCardFiles read only the properties of a projection, or every property again for NULL.
+ *@pre the projection outlives its use by the loader
+ **/
+void setLoaderProjection(VCLoader* loader, const CardProjection* projection);
+
+#endif
@@ -7,6 +7,9 @@
 #include <stdlib.h>
 
 #include "LinkedListAPI.h"
+#include "VCStats.h"
+#include "VCAlloc.h"
+#include "VCTrace.h"
 
 typedef enum ers {OK, INV_FILE, INV_CARD, INV_PROP, INV_DT, WRITE_ERROR, OTHER_ERROR } VCardErrorCode;
 
@@ -68,6 +71,12 @@ typedef struct prop {
 
 } Property;
 
+/*	The parser and the copy functions allocate a Property in one block with its lists, name and group.
+	A Property may also be built by hand, with name, group and both lists allocated on their own
+	(vcMalloc and initializeList); deleteProperty frees such a property field by field. Only parsed
+	and copied properties have the typed N/ADR view (VCStructured.h) and the blob values (VCBlob.h).
+*/
+
 
 //Represents an vCard object
 typedef struct vCard {
@@ -106,6 +115,26 @@ char* cardToString(const Card* obj);
 char* errorToString(VCardErrorCode err);
 // *************************************************************************
 
+/** Function to parse a card that is already in memory, e.g. a buffer filled by the batch loader (VCLoader.h).
+ *  The rules are the same as for createCard, including the CRLF line endings.
+ *@pre data points to length bytes, it does not need to be null-terminated
+ *@post data has not been modified, the new Card does not reference it
+ *@return the error code indicating success or the error encountered while parsing
+ *@param data - the contents of a vCard file
+		 length - the number of bytes in data
+		 obj - receives the new Card on success
+ **/
+VCardErrorCode createCardFromBuffer(const char* data, size_t length, Card** obj);
+
+/** Function to make an independent deep copy of a card, without going through cardToString and createCard.
+ *@pre obj is a card created by createCard, createCardFromBuffer or newCard
+ *@post obj has not been modified; the copy shares no memory with it and is freed with deleteCard
+ *@return the error code indicating success (OK), INV_CARD for a NULL card or OTHER_ERROR if an allocation failed
+ *@param obj - the card to copy
+		 copy - receives the new Card on success
+ **/
+VCardErrorCode cloneCard(const Card* obj, Card** copy);
+
 // ************* List helper functions - MUST be implemented *************** 
 void deleteProperty(void* toBeDeleted);
 int compareProperties(const void* first,const void* second);
@@ -0,0 +1,61 @@
+#ifndef _VCPIPELINE_H
+#define _VCPIPELINE_H
+
+#include "VCParser.h"
+#include "VCProjection.h"
+
+/*	Pipelined ingestion of many card files.
+	A reader thread loads file contents in batches (VCLoader.h), a pool of worker threads parses and
+	validates them, and the calling thread hands the finished cards to a consumer callback, so I/O,
+	parsing and the consumer's own work overlap. The stages are connected by bounded lock-free rings;
+	a stage that gets ahead waits for the next one instead of buffering without limit.
+	The worker threads allocate with the global allocator (vcSetAllocator), thread overrides don't apply.
+*/
+
+typedef struct pipelineResult {
+	//The file name as it was passed in, and its position in the input
+	const char*	fileName;
+	int	index;
+
+	//The parsed card, owned by the consumer from now on (free it with deleteCard). NULL on error
+	Card*	card;
+
+	//OK, the error from createCard, or the error from validateCard when validation is on
+	VCardErrorCode	error;
+} PipelineResult;
+
+typedef void (*PipelineConsumer)(const PipelineResult* result, void* context);
+
+typedef struct pipelineOptions {
+	//Number of parser threads, 0 uses one per online CPU
+	int	workers;
+
+	//Capacity of each ring, rounded up to a power of two
+	int	queueSize;
+
+	//Deliver results in input order; otherwise they are delivered as soon as they are parsed
+	bool	ordered;
+
+	//Run validateCard on every parsed card and report invalid cards as errors
+	bool	validate;
+
+	//Read only these properties (see VCProjection.h), NULL reads every property
+	const CardProjection*	projection;
+} PipelineOptions;
+
+/** Sets the default options: one worker per CPU, queues of 1024, ordered, with validation, every property.
+ **/
+void initializePipelineOptions(PipelineOptions* options);
+
+/** Loads, parses and optionally validates count card files and passes every result to consumer.
+ *  The consumer runs on the calling thread, once per file.
+ *@param fileNames - the files to parse
+		 count - number of files
+		 options - pipeline options, NULL for the defaults
+		 consumer - callback that receives each result
+		 context - passed to the consumer unchanged
+ *@return the number of results with error OK, or -1 if the threads could not be started
+ **/
+int runPipeline(char* const* fileNames, int count, const PipelineOptions* options, PipelineConsumer consumer, void* context);
+
+#endif
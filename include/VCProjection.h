@@ -0,0 +1,39 @@
+#ifndef _VCPROJECTION_H
+#define _VCPROJECTION_H
+
+#include "VCParser.h"
+
+/*	Projection pushdown: parsing only the properties a job needs.
+	A projection is a set of property names. A card parsed with one gets only those of its optional
+	properties, BDAY and ANNIVERSARY. The line reader skips the lines of every other property as soon as
+	it has read their name: they are not unfolded, copied or tokenized, and no Property, Parameter or value
+	is allocated for them. BEGIN, VERSION, FN and END are always read and checked like in createCard
+	(for a 2.1 card N is read as well, in case FN has to be built from it). Skipped lines still have to end
+	with CRLF, their contents are not checked otherwise.
+	A projection is read only once it is created, so any number of threads can parse with it.
+*/
+typedef struct cardProjection CardProjection;
+
+/** Function to create a projection.
+ *@param names - the property names to read, as they appear in the card (e.g. "EMAIL"), without groups
+		 count - the number of names
+ *@return the projection, or NULL if a name is NULL or empty or the allocation failed.
+		  Must be freed with deleteProjection, after the last parse that uses it.
+ **/
+CardProjection* createProjection(char* const* names, int count);
+
+/** Frees a projection. Does nothing for NULL.
+ **/
+void deleteProjection(CardProjection* projection);
+
+/** Same as createCard, reading only the properties of the projection.
+ *@param projection - the properties to read, NULL reads every property
+ **/
+VCardErrorCode createCardWithProjection(const char* fileName, const CardProjection* projection, Card** obj);
+
+/** Same as createCardFromBuffer, reading only the properties of the projection.
+ *@param projection - the properties to read, NULL reads every property
+ **/
+VCardErrorCode createCardFromBufferWithProjection(const char* data, size_t length, const CardProjection* projection, Card** obj);
+
+#endif
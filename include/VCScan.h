@@ -0,0 +1,58 @@
+#ifndef _VCSCAN_H
+#define _VCSCAN_H
+
+#include "VCParser.h"
+
+/*	Predicate pushdown: finding the cards that match a filter without building the others.
+	A filter is a list of predicates that all have to hold, e.g. "BDAY month == 6" and "has TEL with TYPE=cell".
+	A card is matched on its lines as they are read: only the lines of the properties the predicates look at
+	are unfolded (the others are skipped like with a projection, see VCProjection.h), each one is split into
+	name, parameters and value in place, and reading stops as soon as every predicate holds. No Card, Property
+	or Parameter is allocated for a card that does not match; a card that matches is then parsed like createCard.
+	2.1 and 3.0 cards are converted line by line first, so TEL;CELL matches TYPE=cell like in the parsed card.
+	A filter is read only once it is used, so any number of threads can scan with it.
+*/
+typedef struct cardFilter CardFilter;
+
+/** Creates an empty filter, which every card matches.
+ *@return the filter, or NULL if the allocation failed. Must be freed with deleteCardFilter.
+ **/
+CardFilter* createCardFilter(void);
+
+/** Frees a filter. Does nothing for NULL.
+ **/
+void deleteCardFilter(CardFilter* filter);
+
+/** Adds "BDAY month == month": the card has a BDAY date with that month, e.g. 19850612 or --0612 for 6.
+ *  Text values (VALUE=text), times and dates without a month do not match.
+ *@return false if the month is not between 1 and 12, the filter is full (64 predicates) or the allocation failed
+ **/
+bool addBirthdayMonthFilter(CardFilter* filter, int month);
+
+/** Adds "EMAIL domain == domain": one of the EMAIL values of the card ends with @domain, compared without case.
+ *@return false if the domain is NULL or empty, the filter is full or the allocation failed
+ **/
+bool addEmailDomainFilter(CardFilter* filter, const char* domain);
+
+/** Adds "has property with parameter=value", e.g. ("TEL", "TYPE", "cell"). The property name is compared as it
+ *  appears in the card, without its group; the parameter name and value without case. A value list
+ *  (TYPE=cell,voice or TYPE="cell,voice") matches when one of its items does.
+ *@return false if an argument is NULL or empty, the filter is full or the allocation failed
+ **/
+bool addParameterFilter(CardFilter* filter, const char* property, const char* parameter, const char* value);
+
+/** Tells whether the card in a buffer matches a filter, reading only the lines the filter looks at.
+ *@return true if every predicate holds; false otherwise, or if the lines it reads are not valid card lines
+ *@param data - the card file contents
+		 length - its length in bytes
+		 filter - the filter, NULL matches every card
+ **/
+bool cardMatchesFilter(const char* data, size_t length, const CardFilter* filter);
+
+/** Same as createCardFromBuffer for a card that matches the filter.
+ *@post *obj is NULL when the card does not match, the result is OK in that case
+ *@return OK, or the error createCardFromBuffer gives a matching card
+ **/
+VCardErrorCode scanCardBuffer(const char* data, size_t length, const CardFilter* filter, Card** obj);
+
+#endif
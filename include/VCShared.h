@@ -0,0 +1,60 @@
+#ifndef _VCSHARED_H
+#define _VCSHARED_H
+
+#include "VCParser.h"
+
+/*	Immutable, reference counted cards for read-heavy services.
+	A SharedCard never changes after it is created, so any number of threads can read it without locking.
+	An update returns a new version that shares every unchanged property (and DateTime) with the old one;
+	only the changed part and the list of property pointers are new. Versions are freed when their last
+	reference is released, shared parts when the last version using them is gone.
+	Memory comes from the allocator of the thread that creates or releases it, so share cards between
+	threads only with the global allocator (vcSetAllocator).
+*/
+typedef struct sharedCard SharedCard;
+
+/** Turns a card into the first version of a shared card.
+ *@pre card was created by createCard, createCardFromBuffer or newCard and is not used anywhere else
+ *@post on success the card belongs to the shared card and must not be used or deleted any more;
+		on failure nothing has changed and the caller still owns it
+ *@return the shared card with one reference, or NULL if card is NULL, has no FN or an allocation failed
+ **/
+SharedCard* shareCard(Card* card);
+
+/** Takes one more reference to a version, for another reader.
+ *@return card, for convenience
+ **/
+SharedCard* retainSharedCard(SharedCard* card);
+
+/** Drops one reference. The last release frees the version and every part no other version uses.
+ **/
+void releaseSharedCard(SharedCard* card);
+
+/** Read access to a version through the usual Card structure, e.g. for getFN, cardToString or validateCard.
+ *@post the returned Card and everything it points to must not be modified or deleted
+ *@return the card, valid for as long as the caller holds a reference
+ **/
+const Card* sharedCardView(const SharedCard* card);
+
+/** Number of references to a version, mostly useful for tests and debugging.
+ **/
+int sharedCardReferences(const SharedCard* card);
+
+/** Creates a new version with a different FN value, same rules as updateFN.
+ *@post card is unchanged; *updated has one reference and shares all other properties with card
+ *@return OK, INV_PROP for an empty or missing value, OTHER_ERROR if an allocation failed
+ *@param card - the version to start from
+		 newFN - the new full name
+		 updated - receives the new version
+ **/
+VCardErrorCode updateSharedFN(const SharedCard* card, const char* newFN, SharedCard** updated);
+
+/** Creates a new version with a text birthday, same rules as updateBirthday.
+ **/
+VCardErrorCode updateSharedBirthday(const SharedCard* card, const char* newBirthday, SharedCard** updated);
+
+/** Creates a new version with a text anniversary, same rules as updateAnniversary.
+ **/
+VCardErrorCode updateSharedAnniversary(const SharedCard* card, const char* newAnniv, SharedCard** updated);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _VCSOURCE_H
+#define _VCSOURCE_H
+
+#include "VCParser.h"
+
+/*	Incremental writes of edited cards.
+	createCardWithSource parses a card like createCard and also remembers the bytes each part of the card
+	(FN, BDAY, ANNIVERSARY and every optional property) came from. writeCardIncremental then rewrites only
+	the parts that changed since: an edit of the same length is written in place, anything else rewrites
+	the file from the first changed byte on. Parts that did not change keep their original bytes, including
+	their folding and groups, in whatever order the file has them (e.g. N in front of FN); a new optional
+	property goes right after the one in front of it in the list. If the file was changed by someone else in the meantime (different size or
+	modification time), or the card was written to another file, the whole card is written like writeCard.
+	So is a vCard 2.1 or 3.0 card the first time: its lines have another syntax than the 4.0 ones writeCard makes.
+*/
+typedef struct cardSource CardSource;
+
+/** Same as createCard, and records where each part of the card is in the file.
+ *@post on success *source belongs to the caller and must be freed with deleteCardSource,
+		it has to be freed before or after the card, in any order
+ *@return the error code of createCard; on error *source is NULL
+ *@param fileName - the card file
+		 obj - receives the new Card
+		 source - receives the recorded spans
+ **/
+VCardErrorCode createCardWithSource(const char* fileName, Card** obj, CardSource** source);
+
+/** Writes a card to its file, rewriting only the parts that changed since it was read or last written.
+ *  The output is the same as writeCard's for every changed part. A failed allocation leaves the file as it was;
+ *  after a failed write the next call writes the whole card.
+ *@pre source was made by createCardWithSource for obj, and obj has only been changed through its
+		update functions, the list functions or applyCardPatch since
+ *@post source describes the new contents of the file
+ *@return OK, WRITE_ERROR if the file can't be written, OTHER_ERROR if an allocation failed
+ *@param fileName - the file to write, usually the one the card was read from
+		 obj - the card
+		 source - the spans from createCardWithSource, or NULL to write the whole card
+ **/
+VCardErrorCode writeCardIncremental(const char* fileName, const Card* obj, CardSource* source);
+
+/** Frees the recorded spans. Does nothing for NULL.
+ **/
+void deleteCardSource(CardSource* source);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _VCSTATS_H
+#define _VCSTATS_H
+
+/*	Runtime counters for the parser.
+	Every thread has its own set, so the numbers describe only the calls made by the calling thread
+	and no locking is needed to update them. Counters only ever grow until vcResetStats is called.
+*/
+typedef struct vcStats {
+	//Input seen by createCard
+	unsigned long long	bytesRead;
+	unsigned long long	physicalLines;
+	unsigned long long	logicalLines;
+	unsigned long long	foldedLines; //Continuation lines that were unfolded into the previous line
+
+	//Objects produced by createCard
+	unsigned long long	properties;
+	unsigned long long	parameters;
+	unsigned long long	values;
+
+	//Heap allocations made by the library (vcMalloc, vcCalloc and vcRealloc calls)
+	unsigned long long	allocations;
+
+	//Wall clock time, in nanoseconds
+	unsigned long long	readNs;      //Reading and unfolding lines
+	unsigned long long	tokenizeNs;  //The rest of createCard: splitting lines and building the Card
+	unsigned long long	validateNs;  //validateCard
+	unsigned long long	serializeNs; //cardToString and writeCard
+
+} VCStats;
+
+/** Copies the counters of the calling thread into stats.
+ *@param stats - pointer to the struct that receives the counters, must not be NULL
+ **/
+void vcGetStats(VCStats* stats);
+
+/** Sets all counters of the calling thread back to 0.
+ **/
+void vcResetStats(void);
+
+#endif
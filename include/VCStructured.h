@@ -0,0 +1,65 @@
+#ifndef _VCSTRUCTURED_H
+#define _VCSTRUCTURED_H
+
+#include "VCParser.h"
+
+/*	Typed views of the structured N and ADR values.
+	The parser keeps the flat values list of these properties as before, and also splits the value into its
+	components and comma separated sub-components while the line is being read, with the escapes (\; \, \\ \n)
+	decoded. The views are stored with the property, so reading a family name or a street never tokenizes
+	the value again. Copies made by cloneCard, the shared cards and the diff functions keep their view.
+*/
+
+//One component of a structured value
+typedef struct structuredComponent {
+	//Number of sub-components. 0 if the component is empty
+	int		count;
+
+	//The sub-components, e.g. {"Jr.", "M.D."}. NULL if count is 0
+	char**	values;
+} StructuredComponent;
+
+//The five components of N, in the order of RFC 6350
+typedef struct structuredName {
+	StructuredComponent	family;
+	StructuredComponent	given;
+	StructuredComponent	additional;
+	StructuredComponent	prefixes;
+	StructuredComponent	suffixes;
+} StructuredName;
+
+//The seven components of ADR, in the order of RFC 6350
+typedef struct structuredAddress {
+	StructuredComponent	poBox;
+	StructuredComponent	extended;
+	StructuredComponent	street;
+	StructuredComponent	locality;
+	StructuredComponent	region;
+	StructuredComponent	postalCode;
+	StructuredComponent	country;
+} StructuredAddress;
+
+/** Function to get the components of an N property.
+ *  Components missing from the value are empty, components past the fifth are not part of the view.
+ *@pre property was created by the parser, createProperty or one of the copy functions
+ *@return the view, owned by the property and valid until it is deleted or refreshed;
+		  NULL if the property is not N or its values were built by hand and never refreshed
+ *@param property - the property
+ **/
+const StructuredName* getStructuredName(const Property* property);
+
+/** Function to get the components of an ADR property. Same rules as getStructuredName, with seven components.
+ **/
+const StructuredAddress* getStructuredAddress(const Property* property);
+
+/** Function to rebuild the view of an N or ADR property from its flat values list, after the list was
+ *  filled or changed by hand. Every value is one component, and is split on the commas that are not escaped.
+ *@pre property was created by the parser or one of the copy functions
+ *@post views returned earlier for the property are no longer valid
+ *@return OK, INV_PROP if the property is not N or ADR or was built by hand field by field (it has no room for a view),
+		  OTHER_ERROR if the allocation failed (the old view is kept)
+ *@param property - the property
+ **/
+VCardErrorCode refreshStructuredValue(Property* property);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef _VCTRACE_H
+#define _VCTRACE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*	Optional tracing of the parser phases, written as Chrome trace-event JSON
+	(load the file in chrome://tracing or https://ui.perfetto.dev).
+	Spans are only recorded when the library is compiled with -DVC_TRACE (make DEFS=-DVC_TRACE);
+	otherwise the macros below compile to nothing and vcTraceStart returns false.
+*/
+
+/** Starts recording. Events go into a buffer shared by all threads; once it is full new events are dropped.
+ *@param capacity - maximum number of spans kept, 0 for the default (262144)
+ *@return false if tracing is not compiled in or the buffer could not be allocated
+ **/
+bool vcTraceStart(size_t capacity);
+
+/** Writes every recorded span to fileName as Chrome trace JSON. Recording continues afterwards.
+ *@pre No other thread is inside the library while the trace is written
+ *@return false if tracing is not active or the file could not be written
+ **/
+bool vcTraceDump(const char* fileName);
+
+/** Stops recording and frees the event buffer.
+ *@pre No other thread is inside the library
+ **/
+void vcTraceStop(void);
+
+#ifdef VC_TRACE
+
+//Used through the macros below, spans nest per thread and must be closed in reverse order
+void vcTraceBegin(const char* name, const char* detail);
+void vcTraceEnd(void);
+int vcTraceDepth(void);
+void vcTraceUnwind(int depth);
+
+#define VC_TRACE_BEGIN(name) vcTraceBegin((name), NULL)
+#define VC_TRACE_BEGIN_DETAIL(name, detail) vcTraceBegin((name), (detail))
+#define VC_TRACE_END() vcTraceEnd()
+//Closes every span opened since VC_TRACE_DEPTH returned depth, for functions with many return paths
+#define VC_TRACE_DEPTH() vcTraceDepth()
+#define VC_TRACE_UNWIND(depth) vcTraceUnwind(depth)
+
+#else
+
+#define VC_TRACE_BEGIN(name) ((void)0)
+#define VC_TRACE_BEGIN_DETAIL(name, detail) ((void)0)
+#define VC_TRACE_END() ((void)0)
+#define VC_TRACE_DEPTH() 0
+#define VC_TRACE_UNWIND(depth) ((void)(depth))
+
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _VCWATCH_H
+#define _VCWATCH_H
+
+#include "VCParser.h"
+
+/*	Watches a directory of card files with inotify and keeps a parsed, validated Card for every file in it.
+	Only the files that were written, moved in, moved out or deleted are parsed again, and each change is
+	reported to a callback, so keeping a view of a card folder up to date costs O(changes) instead of a
+	rescan of the whole folder. The watcher is not thread safe; create it and process its events on one thread.
+*/
+
+typedef enum watchEventType {
+	WATCH_ADDED,	//A file is now a valid card that was not one before: new, moved in, or fixed
+	WATCH_CHANGED,	//A valid card was rewritten and is still valid
+	WATCH_REMOVED,	//A file that was reported before was deleted or moved away
+	WATCH_INVALID	//A file was written or moved in but is not a valid card (any more)
+} WatchEventType;
+
+typedef struct watchEvent {
+	WatchEventType	type;
+
+	//Name of the file inside the watched directory
+	const char*	fileName;
+
+	//ADDED and CHANGED: the card, owned by the watcher and valid until the next event for the file. NULL otherwise
+	const Card*	card;
+
+	//INVALID: the error from createCard or validateCard. OK otherwise
+	VCardErrorCode	error;
+} WatchEvent;
+
+typedef void (*WatchCallback)(const WatchEvent* event, void* context);
+
+typedef struct cardWatcher CardWatcher;
+
+/** Starts watching a directory. Every .vcf and .vcard file already in it is parsed and reported
+ *  (ADDED or INVALID) before this returns.
+ *@return the watcher, or NULL if the directory can't be watched or an allocation failed.
+		  Must be freed with vcStopWatching.
+ *@param directory - the directory to watch
+		 callback - receives every event, on the thread that calls vcWatchDirectory or vcProcessWatchEvents
+		 context - passed to the callback unchanged
+ **/
+CardWatcher* vcWatchDirectory(const char* directory, WatchCallback callback, void* context);
+
+/** Waits for changes in the directory, parses the changed files and reports them.
+ *  All changes that arrived together are handled at once, and a file that changed several times is parsed once.
+ *@return the number of events reported, or -1 if the directory is gone or can't be read any more.
+		  The files of a directory that was deleted or moved are reported as REMOVED before -1 is returned.
+ *@param watcher - the watcher
+		 timeout - milliseconds to wait for the first change, 0 to only handle what is already there,
+				   -1 to wait as long as it takes
+ **/
+int vcProcessWatchEvents(CardWatcher* watcher, int timeout);
+
+/** The inotify file descriptor, for callers that wait on several descriptors with poll or epoll.
+ *  It becomes readable when vcProcessWatchEvents has something to do.
+ **/
+int vcWatchFd(const CardWatcher* watcher);
+
+/** Looks up the current card of a file in the watched directory.
+ *@return the card, owned by the watcher, or NULL if the file is unknown or invalid
+ **/
+const Card* vcGetWatchedCard(CardWatcher* watcher, const char* fileName);
+
+/** Stops watching and frees the watcher with all of its cards. Does nothing for NULL.
+ **/
+void vcStopWatching(CardWatcher* watcher);
+
+#endif
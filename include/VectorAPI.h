@@ -0,0 +1,170 @@
+/**
+ * @file VectorAPI.h
+ * @brief File containing the function definitions of a contiguous, growable array.
+ * Uses the same deleteData/compare/printData function pointers as LinkedListAPI.h,
+ * so the same helper functions work for both containers.
+ */
+
+#ifndef _VECTOR_API_
+#define _VECTOR_API_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/**
+ * Metadata head of the vector.
+ * Stores the elements as one contiguous array of pointers, together with
+ * the function pointers for working with the abstracted data.
+ **/
+typedef struct vectorHead{
+    void** data;
+    int length;
+    int capacity;
+    void (*deleteData)(void* toBeDeleted);
+    int (*compare)(const void* first,const void* second);
+    char* (*printData)(void* toBePrinted);
+} Vector;
+
+
+/**
+ * Vector iterator structure.
+ * Used the same way as a ListIterator: create it, then call nextVectorElement until it returns NULL.
+ **/
+typedef struct vectorIter{
+    Vector* vector;
+    int index;
+} VectorIterator;
+
+
+/** Function to initialize the vector metadata head with the appropriate function pointers.
+*@pre function pointer arguments must not be NULL
+*@post Vector structure has been allocated and initialized, with no elements
+*@return On success returns newly allocated Vector struct. Returns NULL if malloc fails
+*@param printFunction - function pointer to print a single element of the vector
+*@param deleteFunction - function pointer to delete a single piece of data from the vector
+*@param compareFunction - function pointer to compare two elements in order to test for equality or order
+**/
+Vector* initializeVector(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
+
+
+/** Deletes the entire vector, freeing all memory associated with it, including the Vector struct itself.
+* Uses the supplied function pointer to release allocated memory for the data.
+*@param vector - pointer to the Vector struct
+**/
+void freeVector(Vector* vector);
+
+
+/** Clears the vector: frees the data stored in it without deleting the Vector struct.
+* The capacity is kept, so the vector can be refilled without reallocating.
+*@post Vector struct still exists, length = 0
+*@param vector - pointer to the Vector struct
+**/
+void clearVector(Vector* vector);
+
+
+/** Makes sure the vector can hold at least capacity elements without reallocating.
+*@return true on success, false if the allocation fails
+*@param vector - pointer to the Vector struct
+*@param capacity - minimum number of elements
+**/
+bool reserveVector(Vector* vector, int capacity);
+
+
+/** Appends an element to the end of the vector. The capacity doubles when it runs out.
+*@return true on success, false if the arguments are invalid or the allocation fails
+*@param vector - pointer to the Vector struct
+*@param toBeAdded - a pointer to data that is to be added to the vector
+**/
+bool pushBack(Vector* vector, void* toBeAdded);
+
+
+/** Inserts an element at the given index, shifting the following elements up.
+*@return true on success, false if the arguments are invalid, the index is out of range or the allocation fails
+*@param vector - pointer to the Vector struct
+*@param index - position of the new element, from 0 up to and including the length
+*@param toBeAdded - a pointer to data that is to be added to the vector
+**/
+bool insertAt(Vector* vector, int index, void* toBeAdded);
+
+
+/** Removes the last element and returns it. The data is not freed.
+*@return the removed data, or NULL if the vector is empty
+*@param vector - pointer to the Vector struct
+**/
+void* popBack(Vector* vector);
+
+
+/** Returns the element at the given index. Does not alter the vector.
+*@return the data at index, or NULL if the index is out of range
+*@param vector - pointer to the Vector struct
+*@param index - position of the element, 0 is the front
+**/
+void* getAt(Vector* vector, int index);
+
+
+/** Removes the element at the given index, shifting the following elements down, and returns it.
+* The data is not freed.
+*@return the removed data, or NULL if the index is out of range
+*@param vector - pointer to the Vector struct
+*@param index - position of the element to remove
+**/
+void* removeAt(Vector* vector, int index);
+
+
+/**Returns the number of elements in the vector.
+ *@return number of elements in the vector (0 or more), -1 if vector is NULL
+ *@param vector - pointer to the Vector struct
+ **/
+int getVectorLength(Vector* vector);
+
+
+/** Sorts the vector in place using its compare function. The sort is stable.
+*@return true on success, false if the temporary buffer could not be allocated
+*@param vector - pointer to the Vector struct
+**/
+bool sortVector(Vector* vector);
+
+
+/** Binary search for an element equal to searchRecord, using the vector's compare function.
+*@pre The vector is sorted with sortVector (or kept in compare order)
+*@return the index of a matching element, or -1 if there is none
+*@param vector - pointer to the Vector struct
+*@param searchRecord - a pointer to search data
+**/
+int searchVector(Vector* vector, const void* searchRecord);
+
+
+/** Linear search with a custom comparator, same contract as findElement in LinkedListAPI.h.
+*@return The data of the first element that matches, or NULL if none does
+*@param vector - pointer to the Vector struct
+*@param customCompare - a pointer to comparator function for customizing the search
+*@param searchRecord - a pointer to search data, which contains seach criteria
+**/
+void* findInVector(Vector* vector, bool (*customCompare)(const void* first,const void* second), const void* searchRecord);
+
+
+/**Returns a string that contains a string representation of the vector, front to back,
+ * built with the vector's printData function pointer. Returned string must be freed by the calling function.
+ *@return on success: char * to string representation of vector.  on failure: NULL
+ *@param vector - pointer to the Vector struct
+ **/
+char* vectorToString(Vector* vector);
+
+
+/** Function for creating an iterator for the vector. It starts at the front of the vector.
+ *@return The newly created iterator object.
+ *@param vector - pointer to the Vector struct to iterate over.
+**/
+VectorIterator createVectorIterator(Vector* vector);
+
+
+/** Returns the next element of the vector through the iterator, or NULL once the end is reached.
+*@return The data that the iterator pointed to when the function was called.
+*@param iter - a pointer to an iterator for a Vector struct.
+**/
+void* nextVectorElement(VectorIterator* iter);
+
+#endif
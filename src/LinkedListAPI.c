@@ -1,5 +1,123 @@
 #include "LinkedListAPI.h"
+#include "StringBuilder.h"
+#include "VCAlloc.h"
 #include "assert.h"
+#include <stdint.h>
+
+/**
+ * Slot of the hash index. node is NULL for an empty slot.
+ * The hash is stored so that growing the table and probing don't call the hash function again.
+ **/
+typedef struct indexSlot{
+	Node* node;
+	uint64_t hash;
+} IndexSlot;
+
+/**
+ * Open addressing table (linear probing) from data to the node holding it.
+ * capacity is always a power of two and the table is kept at most half full.
+ **/
+struct listIndex{
+	IndexSlot* slots;
+	size_t capacity;
+	size_t count;
+	unsigned long (*hash)(const void* data);
+};
+
+#define INDEX_MIN_CAPACITY 16
+
+//Mixes the bits of the user supplied hash, so weak hashes (e.g. sequential ids) still spread over the table.
+//The mix is done in 64 bits even where unsigned long has 32; the slot index is taken from the result afterwards.
+static uint64_t mixHash(unsigned long hash){
+	uint64_t h = hash;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+//Places a node into a table that is known to have room for it
+static void placeInSlots(IndexSlot* slots, size_t capacity, Node* node, uint64_t hash){
+	size_t pos = (size_t)(hash & (capacity - 1));
+
+	while (slots[pos].node != NULL){
+		pos = (pos + 1) & (capacity - 1);
+	}
+
+	slots[pos].node = node;
+	slots[pos].hash = hash;
+}
+
+static bool growIndex(ListIndex* index, size_t capacity){
+	IndexSlot* slots = vcCalloc(capacity, sizeof(IndexSlot));
+	if (slots == NULL){
+		return false;
+	}
+
+	for (size_t i = 0; i < index->capacity; i++){
+		if (index->slots[i].node != NULL){
+			placeInSlots(slots, capacity, index->slots[i].node, index->slots[i].hash);
+		}
+	}
+
+	vcFree(index->slots);
+	index->slots = slots;
+	index->capacity = capacity;
+
+	return true;
+}
+
+//Adds a newly linked node to the index. If memory runs out, the index is dropped
+//and lookups fall back to a linear scan, so the list itself always stays usable.
+static void indexNode(List* list, Node* node){
+	ListIndex* index = list->index;
+
+	if ((index->count + 1) * 2 > index->capacity && !growIndex(index, index->capacity * 2)){
+		removeListIndex(list);
+		return;
+	}
+
+	placeInSlots(index->slots, index->capacity, node, mixHash(index->hash(node->data)));
+	(index->count)++;
+}
+
+//Finds the slot of the node whose data compares equal to data, or -1
+static long findSlot(List* list, const void* data){
+	ListIndex* index = list->index;
+	uint64_t hash = mixHash(index->hash(data));
+	size_t pos = (size_t)(hash & (index->capacity - 1));
+
+	while (index->slots[pos].node != NULL){
+		if (index->slots[pos].hash == hash && list->compare(data, index->slots[pos].node->data) == 0){
+			return (long)pos;
+		}
+		pos = (pos + 1) & (index->capacity - 1);
+	}
+
+	return -1;
+}
+
+//Empties a slot, then moves later entries of the probe run back so no lookup stops early
+static void removeSlot(ListIndex* index, size_t pos){
+	size_t mask = index->capacity - 1;
+	size_t next = (pos + 1) & mask;
+
+	index->slots[pos].node = NULL;
+	(index->count)--;
+
+	while (index->slots[next].node != NULL){
+		size_t home = (size_t)(index->slots[next].hash & mask);
+
+		//The entry can fill the hole if its home slot is not between the hole and its current slot
+		if (((next - home) & mask) >= ((next - pos) & mask)){
+			index->slots[pos] = index->slots[next];
+			index->slots[next].node = NULL;
+			pos = next;
+		}
+
+		next = (next + 1) & mask;
+	}
+}
 
 /** Function to initialize the list metadata head to the appropriate function pointers. Allocates memory to the struct.
 *@return pointer to the list head
@@ -13,7 +131,7 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
     assert(deleteFunction != NULL);
     assert(compareFunction != NULL);
 
-    List * tmpList = malloc(sizeof(List));
+    List * tmpList = vcMalloc(sizeof(List));
 	
 	tmpList->head = NULL;
 	tmpList->tail = NULL;
@@ -23,6 +141,8 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 	tmpList->deleteData = deleteFunction;
 	tmpList->compare = compareFunction;
 	tmpList->printData = printFunction;
+
+	tmpList->index = NULL;
 	
 	return tmpList;
 }
@@ -37,7 +157,8 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
 void freeList(List* list){	
 
     clearList(list);
-	free(list);
+	removeListIndex(list);
+	vcFree(list);
 }
 
 /** Clears the list: frees the contents of the list - Node structs and data stored in them - 
@@ -63,12 +184,17 @@ void clearList(List* list){
 		list->deleteData(list->head->data);
 		tmp = list->head;
 		list->head = list->head->next;
-		free(tmp);
+		vcFree(tmp);
 	}
 	
 	list->head = NULL;
 	list->tail = NULL;
 	list->length = 0;
+
+	if (list->index != NULL){
+		memset(list->index->slots, 0, sizeof(IndexSlot) * list->index->capacity);
+		list->index->count = 0;
+	}
 }
 
 /**Function for creating a node for the linked list. 
@@ -81,7 +207,7 @@ void clearList(List* list){
 * @param data - is a void * pointer to any data type.  Data must be allocated on the heap.
 **/
 Node* initializeNode(void* data){
-	Node* tmpNode = (Node*)malloc(sizeof(Node));
+	Node* tmpNode = (Node*)vcMalloc(sizeof(Node));
 	
 	if (tmpNode == NULL){
 		return NULL;
@@ -117,6 +243,10 @@ void insertBack(List* list, void* toBeAdded){
         list->tail->next = newNode;
     	list->tail = newNode;
     }
+
+	if (list->index != NULL){
+		indexNode(list, newNode);
+	}
 }
 
 /**Inserts a Node at the front of a linked list.  List metadata is updated
@@ -142,6 +272,10 @@ void insertFront(List* list, void* toBeAdded){
         list->head->previous = newNode;
     	list->head = newNode;
     }
+
+	if (list->index != NULL){
+		indexNode(list, newNode);
+	}
 }
 
 /**Returns a pointer to the data at the front of the list. Does not alter list structure.
@@ -176,6 +310,16 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 	}
 	
 	Node* tmp = list->head;
+
+	//With an index the node is found directly instead of scanning from the head
+	if (list->index != NULL){
+		long slot = findSlot(list, toBeDeleted);
+		if (slot < 0){
+			return NULL;
+		}
+		tmp = list->index->slots[slot].node;
+		removeSlot(list->index, (size_t)slot);
+	}
 	
 	while(tmp != NULL){
 		if (list->compare(toBeDeleted, tmp->data) == 0){
@@ -195,7 +339,7 @@ void* deleteDataFromList(List* list, void* toBeDeleted){
 			}
 			
 			void* data = delNode->data;
-			free(delNode);
+			vcFree(delNode);
 			
 			(list->length)--;
 
@@ -249,8 +393,8 @@ void insertSorted(List *list, void *toBeAdded){
 		
 			//printf("Inserting %s before %s\n", newDescr, currDescr);
 
-			free(currDescr);
-			free(newDescr);
+			vcFree(currDescr);
+			vcFree(newDescr);
 		
 			Node* newNode = initializeNode(toBeAdded);
 			newNode->next = currNode;
@@ -259,6 +403,10 @@ void insertSorted(List *list, void *toBeAdded){
 			currNode->previous = newNode;
 			(list->length)++;
 
+			if (list->index != NULL){
+				indexNode(list, newNode);
+			}
+
 			return;
 		}
 	
@@ -277,28 +425,26 @@ returned string must be freed by the calling function.
  **/
 char* toString(List * list){
 	ListIterator iter = createIterator(list);
-	char* str;
-		
-	str = (char*)malloc(sizeof(char));
-	if (str == NULL){
-		free(str);
+	StringBuilder sb;
+
+	if (!initializeStringBuilder(&sb, 0)){
 		return NULL;
 	}
-	strcpy(str, "");
 	
 	void* elem;
 	while((elem = nextElement(&iter)) != NULL){
 		char* currDescr = list->printData(elem);
 		if (currDescr != NULL){
-			int newLen = strlen(str)+50+strlen(currDescr);
-			str = (char*)realloc(str, newLen);
-			//strcat(str, "\n");
-			strcat(str, currDescr);
-			free(currDescr);
+			//The builder tracks its length, so this stays linear in the size of the list
+			bool appended = appendString(&sb, currDescr);
+			vcFree(currDescr);
+			if (!appended){
+				freeStringBuilder(&sb);
+				return NULL;
+			}
 		}
 	}
-	return str;
-	free(str);
+	return detachString(&sb);
 }
 
 ListIterator createIterator(List* list){
@@ -342,3 +488,72 @@ void* findElement(List * list, bool (*customCompare)(const void* first,const voi
 
 	return NULL;
 }
+
+bool createListIndex(List* list, unsigned long (*hashFunction)(const void* data)){
+	if (list == NULL || hashFunction == NULL){
+		return false;
+	}
+
+	removeListIndex(list);
+
+	ListIndex* index = vcMalloc(sizeof(ListIndex));
+	if (index == NULL){
+		return false;
+	}
+
+	//Size the table for the current contents up front so building it never has to grow
+	size_t capacity = INDEX_MIN_CAPACITY;
+	while (capacity < (size_t)list->length * 2){
+		capacity *= 2;
+	}
+
+	index->slots = vcCalloc(capacity, sizeof(IndexSlot));
+	if (index->slots == NULL){
+		vcFree(index);
+		return false;
+	}
+	index->capacity = capacity;
+	index->count = 0;
+	index->hash = hashFunction;
+
+	for (Node* node = list->head; node != NULL; node = node->next){
+		placeInSlots(index->slots, capacity, node, mixHash(hashFunction(node->data)));
+		(index->count)++;
+	}
+
+	list->index = index;
+
+	return true;
+}
+
+void removeListIndex(List* list){
+	if (list == NULL || list->index == NULL){
+		return;
+	}
+
+	vcFree(list->index->slots);
+	vcFree(list->index);
+	list->index = NULL;
+}
+
+void* findIndexedElement(List* list, const void* searchRecord){
+	if (list == NULL || searchRecord == NULL){
+		return NULL;
+	}
+
+	if (list->index == NULL){
+		for (Node* node = list->head; node != NULL; node = node->next){
+			if (list->compare(searchRecord, node->data) == 0){
+				return node->data;
+			}
+		}
+		return NULL;
+	}
+
+	long slot = findSlot(list, searchRecord);
+	if (slot < 0){
+		return NULL;
+	}
+
+	return list->index->slots[slot].node->data;
+}
@@ -0,0 +1,107 @@
+#include "StringBuilder.h"
+#include "VCAlloc.h"
+
+#define DEFAULT_CAPACITY 64
+
+bool initializeStringBuilder(StringBuilder* sb, size_t initialCapacity){
+	if (sb == NULL){
+		return false;
+	}
+
+	if (initialCapacity == 0){
+		initialCapacity = DEFAULT_CAPACITY;
+	}
+
+	sb->data = vcMalloc(initialCapacity);
+	if (sb->data == NULL){
+		sb->length = 0;
+		sb->capacity = 0;
+		return false;
+	}
+
+	sb->data[0] = '\0';
+	sb->length = 0;
+	sb->capacity = initialCapacity;
+
+	return true;
+}
+
+bool reserveStringBuilder(StringBuilder* sb, size_t extra){
+	if (sb == NULL || sb->data == NULL){
+		return false;
+	}
+
+	size_t needed = sb->length + extra + 1; //+1 for the null terminator
+	if (needed <= sb->capacity){
+		return true;
+	}
+
+	//Double until it fits so that n appends cost O(n) copying in total
+	size_t newCapacity = sb->capacity;
+	while (newCapacity < needed){
+		newCapacity *= 2;
+	}
+
+	char* tmp = vcRealloc(sb->data, newCapacity);
+	if (tmp == NULL){
+		return false;
+	}
+
+	sb->data = tmp;
+	sb->capacity = newCapacity;
+
+	return true;
+}
+
+bool appendChars(StringBuilder* sb, const char* chars, size_t count){
+	if (count == 0){
+		return sb != NULL && sb->data != NULL;
+	}
+
+	if (!reserveStringBuilder(sb, count)){
+		return false;
+	}
+
+	memcpy(sb->data + sb->length, chars, count);
+	sb->length += count;
+	sb->data[sb->length] = '\0';
+
+	return true;
+}
+
+bool appendString(StringBuilder* sb, const char* str){
+	if (str == NULL){
+		return sb != NULL && sb->data != NULL;
+	}
+
+	return appendChars(sb, str, strlen(str));
+}
+
+bool appendChar(StringBuilder* sb, char c){
+	return appendChars(sb, &c, 1);
+}
+
+char* detachString(StringBuilder* sb){
+	if (sb == NULL){
+		return NULL;
+	}
+
+	char* str = sb->data;
+
+	sb->data = NULL;
+	sb->length = 0;
+	sb->capacity = 0;
+
+	return str;
+}
+
+void freeStringBuilder(StringBuilder* sb){
+	if (sb == NULL){
+		return;
+	}
+
+	vcFree(sb->data);
+	sb->data = NULL;
+	sb->length = 0;
+	sb->capacity = 0;
+}
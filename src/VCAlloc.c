@@ -0,0 +1,108 @@
+#include "VCAlloc.h"
+#include "VCHelpers.h"
+
+static void *defaultMalloc(void *context, size_t size)
+{
+    (void)context;
+    return malloc(size);
+}
+
+static void *defaultRealloc(void *context, void *ptr, size_t size)
+{
+    (void)context;
+    return realloc(ptr, size);
+}
+
+static void defaultFree(void *context, void *ptr)
+{
+    (void)context;
+    free(ptr);
+}
+
+static const VCAllocator defaultAllocator = {defaultMalloc, defaultRealloc, defaultFree, NULL};
+
+static VCAllocator globalAllocator = {defaultMalloc, defaultRealloc, defaultFree, NULL};
+
+// Per-thread override, only used while hasThreadAllocator is set
+static _Thread_local VCAllocator threadAllocator;
+static _Thread_local bool hasThreadAllocator = false;
+
+static bool isCompleteAllocator(const VCAllocator *allocator)
+{
+    return allocator->malloc != NULL && allocator->realloc != NULL && allocator->free != NULL;
+}
+
+static const VCAllocator *currentAllocator(void)
+{
+    return hasThreadAllocator ? &threadAllocator : &globalAllocator;
+}
+
+bool vcSetAllocator(const VCAllocator *allocator)
+{
+    if (allocator == NULL)
+    {
+        globalAllocator = defaultAllocator;
+        return true;
+    }
+    if (!isCompleteAllocator(allocator))
+    {
+        return false;
+    }
+    globalAllocator = *allocator;
+    return true;
+}
+
+bool vcSetThreadAllocator(const VCAllocator *allocator)
+{
+    if (allocator == NULL)
+    {
+        hasThreadAllocator = false;
+        return true;
+    }
+    if (!isCompleteAllocator(allocator))
+    {
+        return false;
+    }
+    threadAllocator = *allocator;
+    hasThreadAllocator = true;
+    return true;
+}
+
+// Every allocation is also counted in the stats of the calling thread
+void *vcMalloc(size_t size)
+{
+    const VCAllocator *allocator = currentAllocator();
+    threadStats.allocations++;
+    return allocator->malloc(allocator->context, size);
+}
+
+void *vcCalloc(size_t count, size_t size)
+{
+    if (size != 0 && count > (size_t)-1 / size)
+    {
+        return NULL; // count * size would overflow
+    }
+    void *ptr = vcMalloc(count * size);
+    if (ptr != NULL)
+    {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void *vcRealloc(void *ptr, size_t size)
+{
+    const VCAllocator *allocator = currentAllocator();
+    threadStats.allocations++;
+    return allocator->realloc(allocator->context, ptr, size);
+}
+
+void vcFree(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+    const VCAllocator *allocator = currentAllocator();
+    allocator->free(allocator->context, ptr);
+}
@@ -0,0 +1,409 @@
+#include <stdatomic.h>
+#include "VCBlob.h"
+#include "VCHelpers.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// A card file (or, for a buffer that belongs to the caller, one value copied out of it) kept for
+// the blob values that point into it
+struct blobSource
+{
+    atomic_int references;
+    char *data;
+};
+
+// ************* Finding and keeping the values ***************
+
+static bool startsWithIgnoringCase(const char *text, size_t length, const char *prefix)
+{
+    size_t prefixLength = strlen(prefix);
+    if (length < prefixLength)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < prefixLength; i++)
+    {
+        char c = text[i];
+        if ((c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c) != prefix[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool equalsIgnoringCase(const char *text, const char *upper)
+{
+    return strlen(text) == strlen(upper) && startsWithIgnoringCase(text, strlen(text), upper);
+}
+
+// Tells whether the parameters, from the first ';' to the ':', have ENCODING=b or ENCODING=BASE64
+static bool hasBase64Encoding(const char *parameters, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (parameters[i] != ';' || !startsWithIgnoringCase(parameters + i + 1, length - i - 1, "ENCODING="))
+        {
+            continue;
+        }
+        const char *value = parameters + i + 1 + strlen("ENCODING=");
+        size_t valueLength = length - (value - parameters);
+        const char *valueEnd = memchr(value, ';', valueLength);
+        valueLength = valueEnd != NULL ? (size_t)(valueEnd - value) : valueLength;
+        return (valueLength == 1 && (value[0] == 'b' || value[0] == 'B')) ||
+               (valueLength == 6 && startsWithIgnoringCase(value, valueLength, "BASE64"));
+    }
+    return false;
+}
+
+// Function to check whether a line holds a value the parser leaves in the card file: a PHOTO, KEY or LOGO
+// with base64 data. Only the first physical line is looked at, so it must hold everything up to the ':'
+// and, for a data: URI, the ";base64,".
+/*
+@param line - the first physical line, without its CRLF
+@param length - its length
+@return the offset of the value, just past the ':'; 0 if the value is not a blob
+*/
+size_t findBlobValue(const char *line, size_t length)
+{
+    // The cheap test first, nearly every line fails it
+    const char *colon = memchr(line, ':', length);
+    if (colon == NULL)
+    {
+        return 0;
+    }
+    const char *nameEnd = memchr(line, ';', colon - line);
+    nameEnd = nameEnd != NULL ? nameEnd : colon;
+    const char *dot = memchr(line, '.', nameEnd - line);
+    const char *name = dot != NULL ? dot + 1 : line; // Without the group
+    size_t nameLength = nameEnd - name;
+    if (!((nameLength == 5 && memcmp(name, "PHOTO", 5) == 0) || (nameLength == 3 && memcmp(name, "KEY", 3) == 0) ||
+          (nameLength == 4 && memcmp(name, "LOGO", 4) == 0)))
+    {
+        return 0;
+    }
+
+    const char *value = colon + 1;
+    size_t valueLength = length - (value - line);
+    if (hasBase64Encoding(nameEnd, colon - nameEnd))
+    {
+        return value - line;
+    }
+    if (!startsWithIgnoringCase(value, valueLength, "DATA:"))
+    {
+        return 0;
+    }
+    const char *comma = memchr(value, ',', valueLength);
+    if (comma == NULL || comma - value < 12 || !startsWithIgnoringCase(comma - 7, 7, ";BASE64"))
+    {
+        return 0; // Not base64, or the ";base64," is folded onto the next line
+    }
+    return value - line;
+}
+
+// Function to prepare the value of a blob line for the parser. The value is unfolded in place, either in
+// the card file the reader owns, or in a copy of just the value if the file belongs to the caller.
+/*
+@param reader - the reader, it has already moved past the line
+@param start - the offset of the value
+@param end - the offset of the CR that ends the last physical line of the value
+@param error - receives the error, if any
+@return true with reader->blobValue set, false on an error
+*/
+bool readBlobValue(LineReader *reader, size_t start, size_t end, VCardErrorCode *error)
+{
+    char *bytes;
+    if (reader->buffer != NULL)
+    {
+        // The first blob of the card keeps the whole file, later ones share it
+        if (reader->blobSource == NULL)
+        {
+            reader->blobSource = vcMalloc(sizeof(BlobSource));
+            if (reader->blobSource == NULL)
+            {
+                *error = OTHER_ERROR;
+                return false;
+            }
+            atomic_init(&reader->blobSource->references, 1);
+            reader->blobSource->data = reader->buffer;
+        }
+        bytes = reader->buffer + start;
+    }
+    else
+    {
+        // One allocation of exactly the value, no growing while it is unfolded
+        BlobSource *source = vcMalloc(sizeof(BlobSource));
+        char *copy = vcMalloc(end - start + 1);
+        if (source == NULL || copy == NULL)
+        {
+            vcFree(source);
+            vcFree(copy);
+            *error = OTHER_ERROR;
+            return false;
+        }
+        memcpy(copy, reader->data + start, end - start);
+        atomic_init(&source->references, 1);
+        source->data = copy;
+        releaseBlobSource(reader->blobSource); // The properties that use the previous value hold their own reference
+        reader->blobSource = source;
+        bytes = copy;
+    }
+
+    // Every CRLF in the value is followed by the space or tab of a continuation line (see combineLines)
+    const char *in = bytes;
+    const char *stop = bytes + (end - start);
+    char *out = bytes;
+    while (in < stop)
+    {
+        const char *newline = memchr(in, '\n', stop - in);
+        size_t run = (newline != NULL ? newline - 1 : stop) - in;
+        memmove(out, in, run); // Nothing moves until the first fold
+        out += run;
+        if (newline == NULL)
+        {
+            break;
+        }
+        in = newline + 2; // Past the LF and the space or tab
+    }
+    *out = '\0'; // At most where the CR was
+
+    if (!isValidUtf8(bytes, out - bytes))
+    {
+        *error = INV_CARD;
+        return false;
+    }
+    reader->blobValue = bytes;
+    return true;
+}
+
+static void keepBlobValue(void *value)
+{
+    (void)value; // Freed with the card file, see releaseBlobSource
+}
+
+// Function to make a property use values that point into a kept card file
+/*
+@pre the values list of the property is empty
+@param property - a property made by createProperty
+@param source - the kept file, the property takes a reference on it
+*/
+void useBlobSource(Property *property, BlobSource *source)
+{
+    atomic_fetch_add_explicit(&source->references, 1, memory_order_relaxed);
+    propertyBlock(property)->blob = source;
+    property->values->deleteData = &keepBlobValue;
+}
+
+// Function to drop a reference on a kept card file, the file is freed with the last one. Does nothing for NULL.
+void releaseBlobSource(BlobSource *source)
+{
+    if (source != NULL && atomic_fetch_sub_explicit(&source->references, 1, memory_order_acq_rel) == 1)
+    {
+        vcFree(source->data);
+        vcFree(source);
+    }
+}
+
+// ************* Decoding ***************
+
+// Value of each base64 character. Everything else is 0 as well, base64Value tells them apart from 'A'
+static const signed char base64Values[256] = {
+    ['A'] = 0, ['B'] = 1, ['C'] = 2, ['D'] = 3, ['E'] = 4, ['F'] = 5, ['G'] = 6, ['H'] = 7,
+    ['I'] = 8, ['J'] = 9, ['K'] = 10, ['L'] = 11, ['M'] = 12, ['N'] = 13, ['O'] = 14, ['P'] = 15,
+    ['Q'] = 16, ['R'] = 17, ['S'] = 18, ['T'] = 19, ['U'] = 20, ['V'] = 21, ['W'] = 22, ['X'] = 23,
+    ['Y'] = 24, ['Z'] = 25, ['a'] = 26, ['b'] = 27, ['c'] = 28, ['d'] = 29, ['e'] = 30, ['f'] = 31,
+    ['g'] = 32, ['h'] = 33, ['i'] = 34, ['j'] = 35, ['k'] = 36, ['l'] = 37, ['m'] = 38, ['n'] = 39,
+    ['o'] = 40, ['p'] = 41, ['q'] = 42, ['r'] = 43, ['s'] = 44, ['t'] = 45, ['u'] = 46, ['v'] = 47,
+    ['w'] = 48, ['x'] = 49, ['y'] = 50, ['z'] = 51, ['0'] = 52, ['1'] = 53, ['2'] = 54, ['3'] = 55,
+    ['4'] = 56, ['5'] = 57, ['6'] = 58, ['7'] = 59, ['8'] = 60, ['9'] = 61, ['+'] = 62, ['/'] = 63,
+};
+
+static int base64Value(char c)
+{
+    int value = base64Values[(unsigned char)c];
+    return value == 0 && c != 'A' ? -1 : value; // The table is 0 for the characters it does not list
+}
+
+#ifdef __SSE2__
+// Decodes 16 characters into 12 bytes. Every character is turned into its 6 bits with range compares
+// (SSE2 has no byte shuffle), then pairs and quads are merged with shifts and the 24 bits of each quad
+// are stored in order.
+/*
+@return false if one of the characters is not in the base64 alphabet
+*/
+static bool decodeBlock(const char *text, unsigned char *out)
+{
+    __m128i chars = _mm_loadu_si128((const __m128i *)text);
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    __m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+    __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+    __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+    if (_mm_movemask_epi8(valid) != 0xFFFF)
+    {
+        return false; // Bytes above 0x7F are negative and fail every range as well
+    }
+
+    __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+    shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+    shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+    shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+    shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+    __m128i sextets = _mm_add_epi8(chars, shift);
+
+    // 16-bit lanes: first << 6 | second; 32-bit lanes: pair << 12 | pair
+    __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(sextets, _mm_set1_epi16(0x00FF)), 6), _mm_srli_epi16(sextets, 8));
+    __m128i quads = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0xFFFF)), 12), _mm_srli_epi32(pairs, 16));
+
+    unsigned int lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, quads);
+    for (int i = 0; i < 4; i++)
+    {
+        out[3 * i] = (unsigned char)(lanes[i] >> 16);
+        out[3 * i + 1] = (unsigned char)(lanes[i] >> 8);
+        out[3 * i + 2] = (unsigned char)lanes[i];
+    }
+    return true;
+}
+#endif
+
+// Decodes base64 text with optional '=' padding at the end
+/*
+@pre out has room for length / 4 * 3 bytes
+@return the number of bytes, or -1 if the text is not valid base64
+*/
+static long decodeBase64(const char *text, size_t length, unsigned char *out)
+{
+    // The padding only ever ends the text
+    size_t padding = 0;
+    while (padding < 2 && padding < length && text[length - 1 - padding] == '=')
+    {
+        padding++;
+    }
+    if ((length % 4 != 0 && padding > 0) || length % 4 == 1)
+    {
+        return -1;
+    }
+    length -= padding;
+
+    size_t i = 0;
+    unsigned char *start = out;
+#ifdef __SSE2__
+    for (; length - i >= 16; i += 16, out += 12)
+    {
+        if (!decodeBlock(text + i, out))
+        {
+            return -1;
+        }
+    }
+#endif
+    // The rest, four characters at a time, then the two or three of the last group
+    unsigned int bits = 0;
+    int count = 0;
+    for (; i < length; i++)
+    {
+        int value = base64Value(text[i]);
+        if (value < 0)
+        {
+            return -1;
+        }
+        bits = bits << 6 | (unsigned int)value;
+        if (++count == 4)
+        {
+            *out++ = (unsigned char)(bits >> 16);
+            *out++ = (unsigned char)(bits >> 8);
+            *out++ = (unsigned char)bits;
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 2)
+    {
+        *out++ = (unsigned char)(bits >> 4);
+    }
+    else if (count == 3)
+    {
+        *out++ = (unsigned char)(bits >> 10);
+        *out++ = (unsigned char)(bits >> 2);
+    }
+    return out - start;
+}
+
+// ************* Public functions ***************
+
+const char *getPropertyBlobText(const Property *property, size_t *length)
+{
+    if (property == NULL || property->parameters == NULL || property->values == NULL ||
+        property->values->head == NULL || length == NULL)
+    {
+        return NULL;
+    }
+
+    // ENCODING=b: the whole value is the data
+    for (Node *node = property->parameters->head; node != NULL; node = node->next)
+    {
+        const Parameter *parameter = node->data;
+        if (equalsIgnoringCase(parameter->name, "ENCODING") &&
+            (equalsIgnoringCase(parameter->value, "B") || equalsIgnoringCase(parameter->value, "BASE64")))
+        {
+            const char *text = property->values->head->data;
+            *length = strlen(text);
+            return text;
+        }
+    }
+
+    // A data: URI is split at its ';' like every value, the data is in the part that starts with "base64,"
+    const char *first = property->values->head->data;
+    if (!startsWithIgnoringCase(first, strlen(first), "DATA:"))
+    {
+        return NULL;
+    }
+    for (Node *node = property->values->head->next; node != NULL; node = node->next)
+    {
+        const char *value = node->data;
+        if (startsWithIgnoringCase(value, strlen(value), "BASE64,"))
+        {
+            *length = strlen(value) - strlen("base64,");
+            return value + strlen("base64,");
+        }
+    }
+    return NULL;
+}
+
+VCardErrorCode getPropertyBlob(const Property *property, unsigned char **data, size_t *length)
+{
+    if (data == NULL || length == NULL)
+    {
+        return INV_PROP;
+    }
+    size_t textLength = 0;
+    const char *text = getPropertyBlobText(property, &textLength);
+    if (text == NULL)
+    {
+        return INV_PROP;
+    }
+
+    unsigned char *bytes = vcMalloc(textLength / 4 * 3 + 3); // Room for a last group without padding
+    if (bytes == NULL)
+    {
+        return OTHER_ERROR;
+    }
+    long decoded = decodeBase64(text, textLength, bytes);
+    if (decoded < 0)
+    {
+        vcFree(bytes);
+        return INV_PROP;
+    }
+    *data = bytes;
+    *length = (size_t)decoded;
+    return OK;
+}
+
+bool isBlobProperty(const Property *property)
+{
+    const PropertyBlock *block = property != NULL ? propertyBlock(property) : NULL;
+    return block != NULL && block->blob != NULL;
+}
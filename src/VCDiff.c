@@ -0,0 +1,476 @@
+#include "VCDiff.h"
+#include "VCHelpers.h"
+
+// ************* Comparing the parts of a card ***************
+
+static bool sameStrings(const List *first, const List *second)
+{
+    if (first->length != second->length)
+    {
+        return false;
+    }
+    for (Node *a = first->head, *b = second->head; a != NULL && b != NULL; a = a->next, b = b->next)
+    {
+        if (strcmp(a->data, b->data) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Name, group and parameters, the part of a property that identifies it in a diff
+static bool sameKey(const Property *first, const Property *second)
+{
+    if (strcmp(first->name, second->name) != 0 || strcmp(first->group, second->group) != 0 ||
+        first->parameters->length != second->parameters->length)
+    {
+        return false;
+    }
+    for (Node *a = first->parameters->head, *b = second->parameters->head; a != NULL && b != NULL; a = a->next, b = b->next)
+    {
+        const Parameter *paramA = a->data;
+        const Parameter *paramB = b->data;
+        if (strcmp(paramA->name, paramB->name) != 0 || strcmp(paramA->value, paramB->value) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameProperty(const Property *first, const Property *second)
+{
+    return sameKey(first, second) && sameStrings(first->values, second->values);
+}
+
+static bool sameDate(const DateTime *first, const DateTime *second)
+{
+    if (first == NULL || second == NULL)
+    {
+        return first == second;
+    }
+    return first->UTC == second->UTC && first->isText == second->isText && strcmp(first->date, second->date) == 0 &&
+           strcmp(first->time, second->time) == 0 && strcmp(first->text, second->text) == 0;
+}
+
+// ************* Building the edit script ***************
+
+static CardEdit *createEdit(CardEditType type, int index)
+{
+    CardEdit *edit = vcCalloc(1, sizeof(CardEdit));
+    if (edit != NULL)
+    {
+        edit->type = type;
+        edit->index = index;
+    }
+    return edit;
+}
+
+// Adds an edit that carries a copy of property
+static bool addPropertyEdit(Vector *patch, CardEditType type, int index, const Property *property)
+{
+    CardEdit *edit = createEdit(type, index);
+    if (edit == NULL)
+    {
+        return false;
+    }
+    edit->property = copyProperty(property);
+    if (edit->property == NULL || !pushBack(patch, edit))
+    {
+        deleteCardEdit(edit);
+        return false;
+    }
+    return true;
+}
+
+// Adds an edit that carries a copy of dateTime, or no date if it is NULL
+static bool addDateEdit(Vector *patch, CardEditType type, const DateTime *dateTime)
+{
+    CardEdit *edit = createEdit(type, 0);
+    if (edit == NULL)
+    {
+        return false;
+    }
+    if (dateTime != NULL)
+    {
+        edit->dateTime = copyDate(dateTime);
+        if (edit->dateTime == NULL)
+        {
+            deleteCardEdit(edit);
+            return false;
+        }
+    }
+    if (!pushBack(patch, edit))
+    {
+        deleteCardEdit(edit);
+        return false;
+    }
+    return true;
+}
+
+// Copies the property pointers of a list into an array so they can be matched by position
+static Property **propertyArray(const List *list)
+{
+    Property **array = vcMalloc((list->length > 0 ? list->length : 1) * sizeof(Property *));
+    if (array != NULL)
+    {
+        int i = 0;
+        for (Node *node = list->head; node != NULL; node = node->next)
+        {
+            array[i++] = node->data;
+        }
+    }
+    return array;
+}
+
+Vector *diffCards(const Card *from, const Card *to)
+{
+    if (from == NULL || to == NULL || from->fn == NULL || to->fn == NULL ||
+        from->optionalProperties == NULL || to->optionalProperties == NULL)
+    {
+        return NULL;
+    }
+
+    int fromCount = from->optionalProperties->length;
+    int toCount = to->optionalProperties->length;
+    Vector *patch = initializeVector(&cardEditToString, &deleteCardEdit, &compareCardEdits);
+    Property **fromArray = propertyArray(from->optionalProperties);
+    Property **toArray = propertyArray(to->optionalProperties);
+    int *match = vcMalloc((toCount > 0 ? toCount : 1) * sizeof(int));    // Old index for every new property, -1 for none
+    bool *kept = vcCalloc(fromCount > 0 ? fromCount : 1, sizeof(bool)); // Old properties that have a match
+    bool ok = patch != NULL && fromArray != NULL && toArray != NULL && match != NULL && kept != NULL;
+
+    // Every new property takes the first old property with the same key after the previous match,
+    // so the matched properties are in the same order in both cards
+    int last = -1;
+    for (int j = 0; ok && j < toCount; j++)
+    {
+        match[j] = -1;
+        for (int i = last + 1; i < fromCount; i++)
+        {
+            if (sameKey(fromArray[i], toArray[j]))
+            {
+                match[j] = i;
+                kept[i] = true;
+                last = i;
+                break;
+            }
+        }
+    }
+
+    // Removals from the back so the indices of the earlier ones stay valid. What is left are the
+    // matched properties in order, and inserting the additions in order at their new index rebuilds
+    // the new list, so changes can then use the new indices as well.
+    for (int i = fromCount - 1; ok && i >= 0; i--)
+    {
+        if (!kept[i])
+        {
+            CardEdit *edit = createEdit(EDIT_REMOVE, i);
+            ok = edit != NULL && pushBack(patch, edit);
+            if (!ok)
+            {
+                vcFree(edit);
+            }
+        }
+    }
+    for (int j = 0; ok && j < toCount; j++)
+    {
+        if (match[j] < 0)
+        {
+            ok = addPropertyEdit(patch, EDIT_ADD, j, toArray[j]);
+        }
+    }
+    for (int j = 0; ok && j < toCount; j++)
+    {
+        if (match[j] >= 0 && !sameStrings(fromArray[match[j]]->values, toArray[j]->values))
+        {
+            ok = addPropertyEdit(patch, EDIT_CHANGE, j, toArray[j]);
+        }
+    }
+
+    if (ok && !sameProperty(from->fn, to->fn))
+    {
+        ok = addPropertyEdit(patch, EDIT_FN, 0, to->fn);
+    }
+    if (ok && !sameDate(from->birthday, to->birthday))
+    {
+        ok = addDateEdit(patch, EDIT_BIRTHDAY, to->birthday);
+    }
+    if (ok && !sameDate(from->anniversary, to->anniversary))
+    {
+        ok = addDateEdit(patch, EDIT_ANNIVERSARY, to->anniversary);
+    }
+
+    vcFree(fromArray);
+    vcFree(toArray);
+    vcFree(match);
+    vcFree(kept);
+    if (!ok)
+    {
+        if (patch != NULL)
+        {
+            freeVector(patch);
+        }
+        return NULL;
+    }
+    return patch;
+}
+
+// ************* Applying the edit script ***************
+
+// Delete function for the vectors below, which only borrow the properties
+static void keepData(void *data)
+{
+    (void)data;
+}
+
+static void deleteProperties(Vector *properties)
+{
+    for (int i = 0; i < properties->length; i++)
+    {
+        deleteProperty(properties->data[i]);
+    }
+}
+
+VCardErrorCode applyCardPatch(Card *card, const Vector *patch)
+{
+    if (card == NULL || card->optionalProperties == NULL || patch == NULL)
+    {
+        return INV_CARD;
+    }
+
+    // The new property list is put together in a vector of pointers first, with copies of everything
+    // the patch adds, so nothing in the card changes until every edit is known to fit.
+    // The two other vectors hold what the card gives up and what it gets on success.
+    Vector *properties = initializeVector(&propertyToString, &keepData, &compareProperties);
+    Vector *replaced = initializeVector(&propertyToString, &keepData, &compareProperties);
+    Vector *added = initializeVector(&propertyToString, &keepData, &compareProperties);
+    Property *fn = NULL;
+    DateTime *birthday = card->birthday;
+    DateTime *anniversary = card->anniversary;
+    bool newFN = false, newBirthday = false, newAnniversary = false;
+    VCardErrorCode err = OK;
+
+    if (properties == NULL || replaced == NULL || added == NULL ||
+        !reserveVector(properties, card->optionalProperties->length + patch->length))
+    {
+        err = OTHER_ERROR;
+    }
+    for (Node *node = card->optionalProperties->head; err == OK && node != NULL; node = node->next)
+    {
+        pushBack(properties, node->data);
+    }
+
+    for (int i = 0; err == OK && i < patch->length; i++)
+    {
+        const CardEdit *edit = patch->data[i];
+        Property *copy = NULL;
+        DateTime *date = NULL;
+
+        switch (edit->type)
+        {
+        case EDIT_REMOVE:
+            if (edit->index < 0 || edit->index >= properties->length)
+            {
+                err = INV_PROP;
+                break;
+            }
+            pushBack(replaced, removeAt(properties, edit->index));
+            break;
+
+        case EDIT_ADD:
+        case EDIT_CHANGE:
+            if (edit->property == NULL || edit->index < 0 || edit->index > properties->length ||
+                (edit->type == EDIT_CHANGE && (edit->index == properties->length ||
+                                               !sameKey(getAt(properties, edit->index), edit->property))))
+            {
+                err = INV_PROP;
+                break;
+            }
+            copy = copyProperty(edit->property);
+            if (copy == NULL || !pushBack(added, copy))
+            {
+                deleteProperty(copy);
+                err = OTHER_ERROR;
+                break;
+            }
+            if (edit->type == EDIT_ADD)
+            {
+                insertAt(properties, edit->index, copy); // Can't fail, the capacity was reserved
+            }
+            else
+            {
+                pushBack(replaced, properties->data[edit->index]);
+                properties->data[edit->index] = copy;
+            }
+            break;
+
+        case EDIT_FN:
+            if (edit->property == NULL || fn != NULL)
+            {
+                err = INV_PROP;
+                break;
+            }
+            fn = copyProperty(edit->property);
+            newFN = true;
+            err = fn != NULL ? OK : OTHER_ERROR;
+            break;
+
+        case EDIT_BIRTHDAY:
+        case EDIT_ANNIVERSARY:
+            if (edit->type == EDIT_BIRTHDAY ? newBirthday : newAnniversary)
+            {
+                err = INV_PROP;
+                break;
+            }
+            if (edit->dateTime != NULL && (date = copyDate(edit->dateTime)) == NULL)
+            {
+                err = OTHER_ERROR;
+                break;
+            }
+            if (edit->type == EDIT_BIRTHDAY)
+            {
+                birthday = date;
+                newBirthday = true;
+            }
+            else
+            {
+                anniversary = date;
+                newAnniversary = true;
+            }
+            break;
+
+        default:
+            err = INV_PROP;
+            break;
+        }
+    }
+
+    if (err != OK)
+    {
+        // Only the copies made here are freed, the card keeps all of its parts
+        if (added != NULL)
+        {
+            deleteProperties(added);
+        }
+        freeVector(added);
+        freeVector(replaced);
+        freeVector(properties);
+        deleteProperty(fn);
+        if (newBirthday)
+        {
+            deleteDate(birthday);
+        }
+        if (newAnniversary)
+        {
+            deleteDate(anniversary);
+        }
+        return err;
+    }
+
+    // Rebuild the list in the new order. Taking the head off is O(1) because it is the first node compared.
+    List *list = card->optionalProperties;
+    while (list->head != NULL)
+    {
+        deleteDataFromList(list, list->head->data);
+    }
+    for (int i = 0; i < properties->length; i++)
+    {
+        insertBack(list, properties->data[i]);
+    }
+
+    if (newFN)
+    {
+        deleteProperty(card->fn);
+        card->fn = fn;
+    }
+    if (newBirthday)
+    {
+        deleteDate(card->birthday);
+        card->birthday = birthday;
+    }
+    if (newAnniversary)
+    {
+        deleteDate(card->anniversary);
+        card->anniversary = anniversary;
+    }
+
+    // The card owns the added copies now, and the removed and replaced properties go
+    deleteProperties(replaced);
+    freeVector(added);
+    freeVector(replaced);
+    freeVector(properties);
+    return OK;
+}
+
+// ************* Vector helper functions ***************
+
+void deleteCardEdit(void *toBeDeleted)
+{
+    if (toBeDeleted == NULL)
+    {
+        return;
+    }
+    CardEdit *edit = (CardEdit *)toBeDeleted;
+    deleteProperty(edit->property);
+    deleteDate(edit->dateTime);
+    vcFree(edit);
+}
+
+int compareCardEdits(const void *first, const void *second)
+{
+    const CardEdit *editA = first;
+    const CardEdit *editB = second;
+    if (editA->type != editB->type)
+    {
+        return editA->type < editB->type ? -1 : 1;
+    }
+    return editA->index < editB->index ? -1 : editA->index > editB->index;
+}
+
+// One edit per line, e.g. "REMOVE 3", "ADD 0 work.EMAIL;TYPE=work:a@b.c" or "BIRTHDAY BDAY:19900101"
+char *cardEditToString(void *edit)
+{
+    if (edit == NULL)
+    {
+        return NULL;
+    }
+
+    static const char *const names[] = {"REMOVE", "ADD", "CHANGE", "FN", "BIRTHDAY", "ANNIVERSARY"};
+    const CardEdit *cardEdit = edit;
+    StringBuilder sb;
+    char index[16];
+    if (cardEdit->type > EDIT_ANNIVERSARY || !initializeStringBuilder(&sb, 0))
+    {
+        return NULL;
+    }
+
+    bool ok = appendString(&sb, names[cardEdit->type]);
+    if (cardEdit->type <= EDIT_CHANGE)
+    {
+        snprintf(index, sizeof(index), " %d", cardEdit->index);
+        ok = ok && appendString(&sb, index);
+    }
+    if (cardEdit->property != NULL)
+    {
+        ok = ok && appendChar(&sb, ' ');
+        if (strlen(cardEdit->property->group) > 0)
+        {
+            ok = ok && appendString(&sb, cardEdit->property->group) && appendChar(&sb, '.');
+        }
+        ok = ok && appendProperty(&sb, cardEdit->property);
+    }
+    if (cardEdit->type == EDIT_BIRTHDAY || cardEdit->type == EDIT_ANNIVERSARY)
+    {
+        ok = ok && appendString(&sb, cardEdit->type == EDIT_BIRTHDAY ? " BDAY" : " ANNIVERSARY");
+        ok = ok && (cardEdit->dateTime != NULL ? appendDateTime(&sb, cardEdit->dateTime) : appendString(&sb, " (none)"));
+    }
+
+    if (!ok)
+    {
+        freeStringBuilder(&sb);
+        return NULL;
+    }
+    return detachString(&sb);
+}
@@ -0,0 +1,212 @@
+#include <ctype.h>
+#include "VCHelpers.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Property values are mostly plain text, so both directions look for the next byte that needs work
+// 16 bytes at a time and copy everything in front of it as one run. Without SSE2 the same is done
+// one byte at a time.
+
+// Copies bytes from src to out until the first '\\' or, if stopAtSemicolon is set, ';'
+/*
+@pre out has room for end - src bytes
+@return the number of bytes copied; src + the result is end or the byte that stopped the run
+*/
+static size_t copyUnescapedRun(const char *src, const char *end, char *out, bool stopAtSemicolon)
+{
+    const char *start = src;
+#ifdef __SSE2__
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i semicolon = _mm_set1_epi8(stopAtSemicolon ? ';' : '\\');
+    while (end - src >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)src);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, backslash), _mm_cmpeq_epi8(chunk, semicolon)));
+        _mm_storeu_si128((__m128i *)(out + (src - start)), chunk); // Stays inside out, see @pre
+        if (mask != 0)
+        {
+            return (src - start) + __builtin_ctz(mask);
+        }
+        src += 16;
+    }
+#endif
+    while (src < end && *src != '\\' && !(stopAtSemicolon && *src == ';'))
+    {
+        out[src - start] = *src;
+        src++;
+    }
+    return src - start;
+}
+
+// Function to decode the escapes of one property value in a single pass
+/*
+@pre dst has room for end - src bytes, the decoded value is never longer than the raw one.
+     dst does not overlap src..end: runs are copied 16 bytes at a time, which would overwrite
+     raw text not read yet once an escape has made the output shorter
+@param src - the raw value, with its escapes
+@param end - the end of the raw text
+@param dst - receives the decoded value, it is not null-terminated
+@param length - receives the length of the decoded value
+@param splitAtSemicolon - stop at the first unescaped ';', for properties with several values
+@param keepCommaEscapes - leave \, and \\ as they are, for N and ADR whose sub-components
+                          are split on the commas later (see VCStructured.c) and for comma lists
+                          (see keepsCommaEscapes)
+@return the position the value ended at: end, or the unescaped ';'
+*/
+const char *unescapeValue(const char *src, const char *end, char *dst, size_t *length,
+                          bool splitAtSemicolon, bool keepCommaEscapes)
+{
+    char *out = dst;
+    while (src < end)
+    {
+        size_t run = copyUnescapedRun(src, end, out, splitAtSemicolon);
+        src += run;
+        out += run;
+        if (src == end || *src == ';')
+        {
+            break;
+        }
+
+        // A backslash: decode it with the character after it
+        if (src + 1 == end)
+        {
+            *out++ = *src++; // Trailing backslash, nothing to escape
+            break;
+        }
+        char escaped = src[1];
+        src += 2;
+        switch (escaped)
+        {
+        case 'n':
+        case 'N':
+            *out++ = '\n';
+            break;
+        case ';':
+            *out++ = ';';
+            break;
+        case ',':
+        case '\\':
+            if (keepCommaEscapes)
+            {
+                *out++ = '\\';
+            }
+            *out++ = escaped;
+            break;
+        default:
+            // Not an escape of RFC 6350, the backslash is dropped like the typed N and ADR view does
+            // (see VCStructured.c), so the writer has nothing to tell apart from an escaped backslash
+            *out++ = escaped;
+            break;
+        }
+    }
+    *length = out - dst;
+    return src;
+}
+
+// Function to tell whether the values of a property keep their \, and \\ escapes once decoded.
+// Their commas separate items (components of N and ADR, or the list of CATEGORIES and NICKNAME),
+// so an escaped comma has to stay told apart from a separator.
+bool keepsCommaEscapes(const char *name)
+{
+    return structuredComponentCount(name) > 0 || strcmp(name, "CATEGORIES") == 0 || strcmp(name, "NICKNAME") == 0;
+}
+
+// Compares two strings, ignoring ASCII case
+static bool equalsIgnoringCase(const char *a, const char *b)
+{
+    for (; *a != '\0' && toupper((unsigned char)*a) == toupper((unsigned char)*b); a++, b++)
+    {
+    }
+    return *a == '\0' && *b == '\0';
+}
+
+// Function to tell whether the values of a property are URIs rather than text: it has VALUE=uri, or
+// it is one of the properties RFC 6350 gives a URI value by default. Their commas are not escaped.
+bool isUriValue(const Property *property)
+{
+    static const char *const uriProperties[] = {"SOURCE", "PHOTO", "IMPP", "GEO", "LOGO", "MEMBER", "SOUND",
+                                                "UID", "URL", "KEY", "FBURL", "CALADRURI", "CALURI", "RELATED"};
+    if (property->parameters != NULL)
+    {
+        ListIterator iter = createIterator(property->parameters);
+        Parameter *parameter;
+        while ((parameter = nextElement(&iter)) != NULL)
+        {
+            if (parameter->name != NULL && parameter->value != NULL && equalsIgnoringCase(parameter->name, "VALUE") &&
+                equalsIgnoringCase(parameter->value, "uri"))
+            {
+                return true;
+            }
+        }
+    }
+    for (size_t i = 0; i < sizeof(uriProperties) / sizeof(uriProperties[0]); i++)
+    {
+        if (strcmp(property->name, uriProperties[i]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the length of the run in front of the first byte that writeCard has to escape:
+// '\n', ';' and, unless keepCommaEscapes is set, '\\' and (if escapeCommas is set) ','
+static size_t plainRunLength(const char *value, size_t length, bool keepCommaEscapes, bool escapeCommas)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i semicolon = _mm_set1_epi8(';');
+    const __m128i backslash = _mm_set1_epi8(keepCommaEscapes ? ';' : '\\');
+    const __m128i comma = _mm_set1_epi8(keepCommaEscapes || !escapeCommas ? ';' : ',');
+    while (length - i >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(value + i));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, semicolon));
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, comma));
+        int mask = _mm_movemask_epi8(_mm_or_si128(special, _mm_cmpeq_epi8(chunk, backslash)));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+#endif
+    while (i < length && value[i] != '\n' && value[i] != ';' &&
+           (keepCommaEscapes || (value[i] != '\\' && (!escapeCommas || value[i] != ','))))
+    {
+        i++;
+    }
+    return i;
+}
+
+// Function to append a value with the escapes writeCard needs, the reverse of unescapeValue
+/*
+@param sb - the builder
+@param value - the decoded value
+@param keepCommaEscapes - leave commas and backslashes alone, for the values that still hold their \, and \\
+                          escapes (see keepsCommaEscapes)
+@param escapeCommas - escape the commas of a text value, false for URIs (see isUriValue)
+@return true on success, false if an allocation failed
+*/
+bool appendEscapedValue(StringBuilder *sb, const char *value, bool keepCommaEscapes, bool escapeCommas)
+{
+    size_t length = strlen(value);
+    bool ok = true;
+    while (ok && length > 0)
+    {
+        size_t run = plainRunLength(value, length, keepCommaEscapes, escapeCommas);
+        ok = appendChars(sb, value, run);
+        if (ok && run < length)
+        {
+            char special = value[run];
+            ok = appendChar(sb, '\\') && appendChar(sb, special == '\n' ? 'n' : special);
+            run++;
+        }
+        value += run;
+        length -= run;
+    }
+    return ok;
+}
@@ -0,0 +1,346 @@
+#include <math.h>
+#include "VCGen.h"
+#include "StringBuilder.h"
+
+//Longest physical line written without folding, CRLF included. The parser reads lines of any length,
+//but a corpus should stay readable by other vCard readers too
+#define MAX_UNFOLDED_LINE 1000
+
+static const char* propertyKinds[GEN_PROP_COUNT] = {"N", "ADR", "TEL", "EMAIL", "GEO", "ORG"};
+
+static const char* words[] = {
+	"alpha", "north", "maple", "river", "stone", "cedar", "harbour", "guelph", "quebec", "laurier",
+	"summit", "valley", "orchard", "bridge", "garden", "lake", "field", "market", "station", "park"
+};
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+static const char* domains[] = {"example.com", "viagenie.ca", "uoguelph.ca", "mail.test"};
+static const char* telTypes[] = {"work", "home", "cell", "voice", "text", "fax"};
+
+//The different ways a card can be broken when invalidFraction picks it
+typedef enum { BAD_NO_FN, BAD_NO_END, BAD_LF_ONLY, BAD_NO_COLON, BAD_EMPTY_PARAM, BAD_N_COMPONENTS, BAD_DUPLICATE_BDAY, BAD_KIND_COUNT } BadKind;
+
+//xorshift64* state, one per card
+typedef struct { uint64_t state; } Rng;
+
+static uint64_t splitMix(uint64_t x){
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static uint64_t nextRandom(Rng* rng){
+	rng->state ^= rng->state >> 12;
+	rng->state ^= rng->state << 25;
+	rng->state ^= rng->state >> 27;
+	return rng->state * 0x2545f4914f6cdd1dULL;
+}
+
+//Uniform double in [0, 1)
+static double nextUnit(Rng* rng){
+	return (nextRandom(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int nextInt(Rng* rng, int bound){
+	return bound <= 0 ? 0 : (int)(nextRandom(rng) % (uint64_t)bound);
+}
+
+void initializeGeneratorOptions(GeneratorOptions* options){
+	options->seed = 2750;
+	options->properties = 10;
+	for (int i = 0; i < GEN_PROP_COUNT; i++){
+		options->mix[i] = 1;
+	}
+	options->groupFraction = 0.0;
+	options->parameterDensity = 1.0;
+	options->foldWidth = 75;
+	options->foldFraction = 1.0;
+	options->valueMin = 5;
+	options->valueMax = 40;
+	options->distribution = GEN_UNIFORM;
+	options->invalidFraction = 0.0;
+}
+
+bool parsePropertyMix(GeneratorOptions* options, const char* mix){
+	int weights[GEN_PROP_COUNT] = {0};
+	const char* pos = mix;
+
+	while (*pos != '\0'){
+		const char* eq = strchr(pos, '=');
+		if (eq == NULL){
+			return false;
+		}
+
+		int kind = -1;
+		for (int i = 0; i < GEN_PROP_COUNT; i++){
+			if (strlen(propertyKinds[i]) == (size_t)(eq - pos) && strncmp(pos, propertyKinds[i], eq - pos) == 0){
+				kind = i;
+			}
+		}
+
+		char* end;
+		long weight = strtol(eq + 1, &end, 10);
+		if (kind < 0 || end == eq + 1 || weight < 0 || (*end != ',' && *end != '\0')){
+			return false;
+		}
+		weights[kind] = (int)weight;
+
+		pos = *end == ',' ? end + 1 : end;
+	}
+
+	memcpy(options->mix, weights, sizeof(weights));
+	return true;
+}
+
+static int pickLength(const GeneratorOptions* options, Rng* rng){
+	int min = options->valueMin > 0 ? options->valueMin : 1;
+	int max = options->valueMax > min ? options->valueMax : min;
+
+	if (options->distribution == GEN_LONG_TAIL){
+		//Pareto with alpha 1.2: most values stay near the minimum, a few get very long
+		double length = min * pow(1.0 - nextUnit(rng), -1.0 / 1.2);
+		return length > max ? max : (int)length;
+	}
+
+	return min + nextInt(rng, max - min + 1);
+}
+
+//Appends length characters of word-like text, with no characters that are special in vCard
+static void appendText(StringBuilder* sb, Rng* rng, int length){
+	int start = (int)sb->length;
+
+	while ((int)sb->length - start < length){
+		if ((int)sb->length > start){
+			appendChar(sb, ' ');
+		}
+		appendString(sb, words[nextInt(rng, WORD_COUNT)]);
+	}
+
+	sb->length = start + length;
+	sb->data[sb->length] = '\0';
+
+	//Don't end on a space that was cut in half
+	if (length > 0 && sb->data[sb->length - 1] == ' '){
+		sb->data[sb->length - 1] = 'x';
+	}
+}
+
+static void appendFormat(StringBuilder* sb, const char* format, long a, long b){
+	char buffer[64];
+	int length = snprintf(buffer, sizeof(buffer), format, a, b);
+	appendChars(sb, buffer, length);
+}
+
+static void appendParameters(StringBuilder* sb, const GeneratorOptions* options, Rng* rng, GenProperty kind){
+	int count = (int)options->parameterDensity;
+	if (nextUnit(rng) < options->parameterDensity - count){
+		count++;
+	}
+
+	for (int p = 0; p < count; p++){
+		switch (p){
+			case 0:
+				appendString(sb, ";TYPE=");
+				appendString(sb, kind == GEN_TEL ? telTypes[nextInt(rng, 6)] : (nextInt(rng, 2) ? "work" : "home"));
+				break;
+			case 1:
+				appendFormat(sb, ";PREF=%ld", 1 + nextInt(rng, 9), 0);
+				break;
+			case 2:
+				appendString(sb, nextInt(rng, 2) ? ";LANGUAGE=en" : ";LANGUAGE=fr");
+				break;
+			default:
+				appendFormat(sb, ";X-P%ld=v%ld", p, nextInt(rng, 100000));
+				break;
+		}
+	}
+}
+
+static void appendValue(StringBuilder* sb, const GeneratorOptions* options, Rng* rng, GenProperty kind){
+	switch (kind){
+		case GEN_N:
+			appendText(sb, rng, 4 + nextInt(rng, 8));
+			appendChar(sb, ';');
+			appendText(sb, rng, 3 + nextInt(rng, 8));
+			appendString(sb, nextInt(rng, 2) ? ";;;" : ";;Dr.;");
+			break;
+		case GEN_ADR:
+			appendString(sb, ";;");
+			appendFormat(sb, "%ld ", 1 + nextInt(rng, 9999), 0);
+			appendText(sb, rng, pickLength(options, rng));
+			appendChar(sb, ';');
+			appendString(sb, words[nextInt(rng, WORD_COUNT)]);
+			appendString(sb, nextInt(rng, 2) ? ";ON;" : ";QC;");
+			appendFormat(sb, "N%ldB %ldX6", nextInt(rng, 10), nextInt(rng, 10));
+			appendString(sb, ";Canada");
+			break;
+		case GEN_TEL:
+			appendFormat(sb, "tel:+1-%ld-555-%04ld", 200 + nextInt(rng, 800), nextInt(rng, 10000));
+			break;
+		case GEN_EMAIL:{
+			int length = pickLength(options, rng);
+			appendText(sb, rng, length > 64 ? 64 : length);
+			for (size_t i = sb->length - (length > 64 ? 64 : length); i < sb->length; i++){
+				if (sb->data[i] == ' '){
+					sb->data[i] = '.';
+				}
+			}
+			appendChar(sb, '@');
+			appendString(sb, domains[nextInt(rng, 4)]);
+			break;
+		}
+		case GEN_GEO:{
+			char buffer[64];
+			int length = snprintf(buffer, sizeof(buffer), "geo:%.6f,%.6f", nextUnit(rng) * 180.0 - 90.0, nextUnit(rng) * 360.0 - 180.0);
+			appendChars(sb, buffer, length);
+			break;
+		}
+		default:
+			appendText(sb, rng, pickLength(options, rng));
+			break;
+	}
+}
+
+//Writes one content line, folding it according to the options
+static int writeLine(FILE* file, const GeneratorOptions* options, Rng* rng, const char* line, size_t length, const char* lineEnd){
+	int width = options->foldWidth > 1 ? options->foldWidth : MAX_UNFOLDED_LINE - 2;
+	bool mustFold = length + 2 > MAX_UNFOLDED_LINE;
+	bool fold = length > (size_t)width && (mustFold || nextUnit(rng) < options->foldFraction);
+
+	if (fold){
+		size_t column = 0;
+		for (size_t i = 0; i < length; i++){
+			if (column == (size_t)width){
+				fputs("\r\n ", file);
+				column = 1;
+			}
+			fputc(line[i], file);
+			column++;
+		}
+	}else{
+		fwrite(line, 1, length, file);
+	}
+
+	return fputs(lineEnd, file) == EOF ? -1 : 0;
+}
+
+static GenProperty pickKind(const GeneratorOptions* options, Rng* rng, bool haveN){
+	int total = 0;
+	for (int i = 0; i < GEN_PROP_COUNT; i++){
+		total += (i == GEN_N && haveN) ? 0 : options->mix[i];
+	}
+	if (total == 0){
+		return GEN_ORG;
+	}
+
+	int pick = nextInt(rng, total);
+	for (int i = 0; i < GEN_PROP_COUNT; i++){
+		int weight = (i == GEN_N && haveN) ? 0 : options->mix[i];
+		if (pick < weight){
+			return (GenProperty)i;
+		}
+		pick -= weight;
+	}
+	return GEN_ORG;
+}
+
+int writeGeneratedCard(FILE* file, const GeneratorOptions* options, long cardNumber, bool* invalid){
+	Rng rng = {splitMix(options->seed ^ splitMix((uint64_t)cardNumber))};
+	if (rng.state == 0){
+		rng.state = 1;
+	}
+
+	bool broken = options->invalidFraction > 0 && nextUnit(&rng) < options->invalidFraction;
+	BadKind bad = broken ? (BadKind)nextInt(&rng, BAD_KIND_COUNT) : BAD_KIND_COUNT;
+	//The line that gets damaged, for the kinds that damage a single line
+	int badLine = nextInt(&rng, options->properties > 0 ? options->properties : 1);
+
+	StringBuilder line;
+	if (!initializeStringBuilder(&line, 256)){
+		return -1;
+	}
+
+	int status = 0;
+	status |= fputs("BEGIN:VCARD\r\nVERSION:4.0\r\n", file) == EOF ? -1 : 0;
+
+	if (bad != BAD_NO_FN){
+		appendString(&line, "FN:");
+		appendText(&line, &rng, pickLength(options, &rng));
+		status |= writeLine(file, options, &rng, line.data, line.length, "\r\n");
+	}
+
+	if (nextInt(&rng, 2) || bad == BAD_DUPLICATE_BDAY){
+		line.length = 0;
+		appendFormat(&line, "BDAY:%04ld%02ld", 1940 + nextInt(&rng, 70), 1 + nextInt(&rng, 12));
+		appendFormat(&line, "%02ld", 1 + nextInt(&rng, 28), 0);
+		status |= writeLine(file, options, &rng, line.data, line.length, "\r\n");
+		if (bad == BAD_DUPLICATE_BDAY){
+			status |= writeLine(file, options, &rng, line.data, line.length, "\r\n");
+		}
+	}
+
+	bool haveN = false;
+	for (int i = 0; i < options->properties; i++){
+		GenProperty kind = pickKind(options, &rng, haveN);
+		if (i == badLine && bad == BAD_N_COMPONENTS){
+			kind = GEN_N; //validateCard rejects an N that does not have 5 components
+		}
+		haveN = haveN || kind == GEN_N;
+
+		line.length = 0;
+		line.data[0] = '\0';
+		if (nextUnit(&rng) < options->groupFraction){
+			appendFormat(&line, "item%ld.", 1 + nextInt(&rng, 9), 0);
+		}
+		appendString(&line, propertyKinds[kind]);
+		appendParameters(&line, options, &rng, kind);
+		if (i == badLine && bad == BAD_EMPTY_PARAM){
+			appendString(&line, ";TYPE=");
+		}
+		if (i == badLine && bad == BAD_NO_COLON){
+			status |= writeLine(file, options, &rng, line.data, line.length, "\r\n");
+			continue;
+		}
+		appendChar(&line, ':');
+		if (i == badLine && bad == BAD_N_COMPONENTS){
+			appendString(&line, "Doe;John");
+		}else{
+			appendValue(&line, options, &rng, kind);
+		}
+
+		status |= writeLine(file, options, &rng, line.data, line.length, i == badLine && bad == BAD_LF_ONLY ? "\n" : "\r\n");
+	}
+
+	//Kinds that need a property line still need one when the card has no properties
+	if (options->properties == 0 && (bad == BAD_NO_COLON || bad == BAD_EMPTY_PARAM || bad == BAD_N_COMPONENTS || bad == BAD_LF_ONLY)){
+		status |= fputs("TEL;TYPE=\n", file) == EOF ? -1 : 0;
+	}
+
+	if (bad != BAD_NO_END){
+		status |= fputs("END:VCARD\r\n", file) == EOF ? -1 : 0;
+	}
+
+	freeStringBuilder(&line);
+
+	if (invalid != NULL){
+		*invalid = broken;
+	}
+
+	return status;
+}
+
+int generateCardFile(const char* fileName, const GeneratorOptions* options, long cardNumber, bool* invalid){
+	FILE* file = fopen(fileName, "w");
+	if (file == NULL){
+		return -1;
+	}
+
+	int status = writeGeneratedCard(file, options, cardNumber, invalid);
+
+	if (fclose(file) != 0){
+		status = -1;
+	}
+
+	return status;
+}
@@ -1,107 +1,567 @@
 #include "VCHelpers.h"
 #include "VCParser.h"
 
-// This function reads one "logical" line from the file.
-// The function uses a static buffer ("leftoverLine") to hold a line that was read
-// but not processed because it starts a new logical line.
-char *readAndCombineLines(FILE *file, VCardErrorCode *error)
-{
-    static char leftoverLine[1024] = ""; // Holds a line that was read but not processed
-    char lineFromFile[1024];             // Buffer to store a line from the file
-    char *currentLine = NULL;            // The combined line we will build
-    size_t currentLineLength = 0;        // Current length of the combined line
-
-    // If we have a leftoverLine line from the previous call, use it first.
-    if (strlen(leftoverLine) > 0)
-    {
-        currentLineLength = strlen(leftoverLine);
-        currentLine = malloc(currentLineLength + 1);
-        if (currentLine == NULL)
-        {
-            return NULL;
-        }
-        strcpy(currentLine, leftoverLine);
-        leftoverLine[0] = '\0'; // Clear leftoverLine so it's not used again
+// Only .vcf and .vcard files are accepted
+bool hasCardExtension(const char *fileName)
+{
+    const char *dot = strrchr(fileName, '.'); // Find last occurrence of '.'
+    return dot != NULL && (strcmp(dot, ".vcf") == 0 || strcmp(dot, ".vcard") == 0);
+}
+
+// Loads a whole card file into memory so it can be parsed with a LineReader
+char *readCardFile(const char *fileName, size_t *length, VCardErrorCode *error)
+{
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL)
+    {
+        *error = INV_FILE;
+        return NULL;
     }
 
-    // Read each line from the file.
-    while (fgets(lineFromFile, sizeof(lineFromFile), file))
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        size = ftell(file);
+    }
+    if (size < 0 || fseek(file, 0, SEEK_SET) != 0)
     {
-        size_t physLen = strlen(lineFromFile);
-        //printf("Read line from file: %s\n", lineFromFile);
-        //printf("Length of line from file: %ld\n", strlen(lineFromFile));
+        fclose(file);
+        *error = INV_FILE;
+        return NULL;
+    }
 
-        // Check for valid CRLF (\r\n) line endings
-        if (physLen >= 2 && lineFromFile[physLen - 2] == '\r' && lineFromFile[physLen - 1] == '\n') {
-            lineFromFile[physLen - 2] = '\0'; // Remove CR and LF
-        } else if (physLen >= 1 && lineFromFile[physLen - 1] == '\n') {
-            *error = INV_CARD; // LF-only line endings are invalid
-            free(currentLine);
-            return NULL;
-        } else {
-            *error = INV_CARD; // No valid line ending
-            free(currentLine);
-            return NULL;
+    char *data = vcMalloc((size_t)size + 1);
+    if (data == NULL)
+    {
+        fclose(file);
+        *error = OTHER_ERROR;
+        return NULL;
+    }
+
+    size_t read = fread(data, 1, (size_t)size, file);
+    if (ferror(file))
+    {
+        vcFree(data);
+        fclose(file);
+        *error = INV_FILE;
+        return NULL;
+    }
+    fclose(file);
+
+    data[read] = '\0';
+    *length = read;
+    *error = OK;
+    return data;
+}
+
+void initializeLineReader(LineReader *reader, const char *data, size_t length)
+{
+    reader->data = data;
+    reader->length = length;
+    reader->position = 0;
+    reader->lineOffset = 0;
+    reader->legacy = false;
+    reader->buffer = NULL;
+    reader->blobSource = NULL;
+    reader->blobValue = NULL;
+    reader->projection = NULL;
+}
+
+// Same as initializeLineReader, for a buffer the reader takes over. Blob values can then stay in it
+// (see VCBlob.c), finishLineReader frees it or leaves it to them.
+void initializeOwningLineReader(LineReader *reader, char *data, size_t length)
+{
+    initializeLineReader(reader, data, length);
+    reader->buffer = data;
+}
+
+// Releases what the reader still holds once the card is parsed
+void finishLineReader(LineReader *reader)
+{
+    if (reader->blobSource != NULL)
+    {
+        releaseBlobSource(reader->blobSource); // Also frees the buffer, unless a property still uses it
+    }
+    else
+    {
+        vcFree(reader->buffer);
+    }
+    reader->buffer = NULL;
+    reader->blobSource = NULL;
+    reader->blobValue = NULL;
+}
+
+// Finds the physical line that starts at offset. end is set to the offset of its CR.
+// Every physical line must end with CRLF; LF-only endings and a missing last line ending are invalid.
+static bool findPhysicalLine(const LineReader *reader, size_t offset, size_t *end)
+{
+    const char *newline = memchr(reader->data + offset, '\n', reader->length - offset);
+    if (newline == NULL)
+    {
+        return false; // No valid line ending
+    }
+    size_t newlineOffset = newline - reader->data;
+    if (newlineOffset == offset || reader->data[newlineOffset - 1] != '\r')
+    {
+        return false; // LF-only line endings are invalid
+    }
+    *end = newlineOffset - 1;
+    return true;
+}
+
+// Tells whether the physical line that ends at end (the offset of its CR) ends with a
+// quoted-printable soft line break, i.e. the next physical line continues it as is
+static bool endsWithSoftBreak(const LineReader *reader, size_t start, size_t end, bool quotedPrintable)
+{
+    return quotedPrintable && end > start && reader->data[end - 1] == '=';
+}
+
+// Moves the reader past the physical lines up to offset, the end of a logical line found by combineLines,
+// counting them in the stats. Up to capacity unfolded bytes are copied into line on the way.
+/*
+@return the number of bytes copied
+*/
+static size_t takeLines(LineReader *reader, size_t offset, bool quotedPrintable, char *line, size_t capacity)
+{
+    size_t copied = 0;
+    bool softBreak = false;
+    reader->lineOffset = reader->position;
+    while (reader->position < offset)
+    {
+        size_t start = reader->position;
+        size_t end = 0;
+        if (!findPhysicalLine(reader, start, &end))
+        {
+            break; // combineLines checked every line up to offset, so this can't happen
+        }
+        threadStats.bytesRead += end + 2 - start;
+        threadStats.physicalLines++;
+        if (softBreak)
+        {
+            threadStats.foldedLines++;
+        }
+        else if (reader->data[start] == ' ' || reader->data[start] == '\t')
+        {
+            threadStats.foldedLines++;
+            start++;
+        }
+        softBreak = endsWithSoftBreak(reader, reader->position, end, quotedPrintable);
+        size_t take = end - start - (softBreak ? 1 : 0);
+        take = copied + take > capacity ? capacity - copied : take; // Stop at the value of a blob line
+        if (take > 0)
+        {
+            memcpy(line + copied, reader->data + start, take);
+            copied += take;
         }
+        reader->position = end + 2;
+    }
+    return copied;
+}
 
-        // printf("Read physical line: '%s'\n", lineFromFile);
+// This function reads one "logical" line: a physical line plus all the continuation lines
+// (starting with a space or a tab) that follow it. The first pass finds how far the logical line
+// reaches and how long it is once unfolded, the second copies it into a single allocation and
+// checks that it is valid UTF-8. In vCard 2.1 and 3.0 cards a quoted-printable value also continues
+// after a line that ends with '=' (a soft line break); the '=' is dropped and the next line kept whole,
+// and the empty line that may end a base64 value is taken with it.
+// Of a PHOTO, KEY or LOGO line with base64 data only the name and parameters are copied, the value is
+// left in the card and pointed to by blobValue (see VCBlob.c). Lines of properties the reader's
+// projection leaves out are only walked over (see VCProjection.c).
+// The reader only moves past the lines it returns, so nothing is kept between calls.
+static char *combineLines(LineReader *reader, VCardErrorCode *error)
+{
+    reader->blobValue = NULL;
 
-        // Check if the line is a continuation:
-        if (lineFromFile[0] == ' ' || lineFromFile[0] == '\t')
+    size_t offset;
+    size_t unfoldedLength;
+    size_t blobValue;     // Offset of the value of a blob line, 0 for every other line
+    bool quotedPrintable;
+    bool base64;          // A legacy base64 value, which may be ended by an empty line
+    bool skip;            // The projection leaves the line out
+    do
+    {
+        if (reader->position >= reader->length)
         {
-            //  We want to remove the first character and append the rest to currentLine.
-            size_t extra = physLen > 0 ? physLen - 1 : 0; // Extra length without the first character
+            return NULL; // End of input
+        }
 
-            // If no logical line exists yet, start one (this is unexpected but we handle it)
-            if (currentLine == NULL)
+        offset = reader->position;
+        unfoldedLength = 0;
+        blobValue = 0;
+        quotedPrintable = false;
+        base64 = false;
+        skip = false;
+        size_t end;
+        bool first = true;
+        bool softBreak = false; // The previous physical line ended with a soft line break
+        while (offset < reader->length)
+        {
+            bool continuation = !softBreak && (reader->data[offset] == ' ' || reader->data[offset] == '\t');
+            if (!first && !continuation && !softBreak)
             {
-                currentLine = malloc(extra + 1);
-                if (currentLine == NULL)
-                {
-                    return NULL;
-                }
-                strcpy(currentLine, lineFromFile + 1);
-                currentLineLength = extra;
+                break; // The next physical line starts a new logical line
             }
-            else
+            if (!findPhysicalLine(reader, offset, &end))
             {
-                // Increase the memory for currentLine and append the new part.
-                char *temp = realloc(currentLine, currentLineLength + extra + 1);
-                if (temp == NULL)
-                {
-                    free(currentLine);
-                    return NULL;
-                }
-                currentLine = temp;
-                strcat(currentLine, lineFromFile + 1); // Append after skipping the first character
-                currentLineLength += extra;
+                *error = INV_CARD;
+                return NULL;
             }
-        }
-        else
-        {
-            // If the physical line is NOT a continuation, then we have a new logical line.
-            // But if we already built a logical line, we must return it now.
-            if (currentLine != NULL)
+            if (first && reader->projection != NULL)
+            {
+                skip = !projectionKeepsLine(reader->projection, reader->data + offset, end - offset, reader->legacy);
+            }
+            if (first && reader->legacy)
             {
-                // Save the new physical line into 'leftoverLine' for the next call.
-                strcpy(leftoverLine, lineFromFile);
-                return currentLine;
+                quotedPrintable = isQuotedPrintableLine(reader->data + offset, end - offset);
+                base64 = isBase64Line(reader->data + offset, end - offset);
             }
-            else
+            else if (first && !skip)
             {
-                // No logical line built yet: start one with the current physical line.
-                currentLine = malloc(physLen + 1);
-                if (currentLine == NULL)
-                {
-                    return NULL;
-                }
-                strcpy(currentLine, lineFromFile);
-                currentLineLength = physLen;
-                // Continue the loop to check if the next physical line is a continuation.
+                blobValue = findBlobValue(reader->data + offset, end - offset);
             }
+            // Continuation lines lose their first character. A continuation at the very start is unexpected,
+            // but it is handled the same way.
+            unfoldedLength += end - offset - (continuation ? 1 : 0);
+            softBreak = endsWithSoftBreak(reader, offset, end, quotedPrintable);
+            unfoldedLength -= softBreak ? 1 : 0;
+            offset = end + 2;
+            first = false;
+        }
+        if (base64 && reader->length - offset >= 2 && reader->data[offset] == '\r' && reader->data[offset + 1] == '\n')
+        {
+            offset += 2; // The empty line 2.1 writers put after a base64 value belongs to it
         }
+        if (skip)
+        {
+            takeLines(reader, offset, quotedPrintable, NULL, 0);
+            threadStats.logicalLines++;
+        }
+    } while (skip);
+
+    if (blobValue != 0)
+    {
+        blobValue += reader->position;
+        unfoldedLength = blobValue - reader->position; // The name and parameters, up to the ':'
+    }
+
+    char *line = vcMalloc(unfoldedLength + 1);
+    if (line == NULL)
+    {
+        *error = OTHER_ERROR;
+        return NULL;
+    }
+    size_t copied = takeLines(reader, offset, quotedPrintable, line, unfoldedLength);
+    line[copied] = '\0';
+
+    // The unfolded line is still in cache, check it here. A sequence split by a fold is checked as a whole.
+    // Legacy lines may still be in another charset, they are checked once they are converted (see VCLegacy.c).
+    if (!reader->legacy && !isValidUtf8(line, copied))
+    {
+        vcFree(line);
+        *error = INV_CARD;
+        return NULL;
+    }
+    if (blobValue != 0 && !readBlobValue(reader, blobValue, offset - 2, error))
+    {
+        vcFree(line);
+        return NULL;
+    }
+    return line;
+}
+
+// Reads one logical line and records it in the stats of the calling thread
+char *readAndCombineLines(LineReader *reader, VCardErrorCode *error)
+{
+    unsigned long long start = statsNow();
+    VC_TRACE_BEGIN("unfold");
+    char *line = combineLines(reader, error);
+    VC_TRACE_END();
+    threadStats.readNs += statsNow() - start;
+    if (line != NULL)
+    {
+        threadStats.logicalLines++;
+    }
+    return line;
+}
+
+// Longest physical line the writers produce, in octets and without the CRLF (RFC 6350 3.2)
+#define FOLD_WIDTH 75
+
+// Finds where the physical line that starts at pos has to end: limit octets on, moved back so a
+// UTF-8 sequence is never split. The caller makes sure more than limit octets are left.
+static size_t foldPoint(const char *line, size_t pos, size_t limit)
+{
+    size_t cut = pos + limit;
+    while (cut > pos + 1 && ((unsigned char)line[cut] & 0xC0) == 0x80)
+    {
+        cut--; // Continuation byte, the sequence it belongs to starts on the next line
+    }
+    return cut;
+}
+
+// Function to end a logical line that was just appended: folds it into physical lines of at most
+// 75 octets (continuation lines start with a space that counts towards the 75) and adds the CRLF.
+// Lines that fit, nearly all of them, cost a single comparison. Longer lines are folded in place:
+// the line is moved back by the room the breaks need, then copied forward with the breaks in between.
+/*
+@param sb - the builder
+@param lineStart - the length of the builder before the line was appended
+@return true on success, false if an allocation failed
+*/
+bool endLine(StringBuilder *sb, size_t lineStart)
+{
+    size_t length = sb->length - lineStart;
+    if (length <= FOLD_WIDTH)
+    {
+        return appendChars(sb, "\r\n", 2);
+    }
+
+    size_t breaks = 0;
+    for (size_t pos = 0, limit = FOLD_WIDTH; length - pos > limit; limit = FOLD_WIDTH - 1)
+    {
+        pos = foldPoint(sb->data + lineStart, pos, limit);
+        breaks++;
+    }
+    if (!reserveStringBuilder(sb, breaks * 3 + 2))
+    {
+        return false;
+    }
+
+    char *out = sb->data + lineStart;
+    char *source = out + breaks * 3;
+    memmove(source, out, length);
+    size_t pos = 0;
+    for (size_t limit = FOLD_WIDTH; length - pos > limit; limit = FOLD_WIDTH - 1)
+    {
+        size_t cut = foldPoint(source, pos, limit);
+        memmove(out, source + pos, cut - pos); // The output never catches up with the rest of the line
+        out += cut - pos;
+        memcpy(out, "\r\n ", 3);
+        out += 3;
+        pos = cut;
+    }
+    // The rest of the line is already where it belongs
+    sb->length += breaks * 3;
+    return appendChars(sb, "\r\n", 2);
+}
+
+// Sets up a list head that is embedded in another allocation (same as initializeList, no malloc)
+static void initializeEmbeddedList(List *list, char *(*printFunction)(void *toBePrinted),
+                                   void (*deleteFunction)(void *toBeDeleted),
+                                   int (*compareFunction)(const void *first, const void *second))
+{
+    list->head = NULL;
+    list->tail = NULL;
+    list->length = 0;
+    list->deleteData = deleteFunction;
+    list->compare = compareFunction;
+    list->printData = printFunction;
+    list->index = NULL;
+}
+
+// Function to allocate a new, empty property in a single block
+/*
+@param name - the property name, copied into the block
+@param group - the group name, may be NULL for no group
+@return the new property, or NULL if the allocation failed. Must be freed with deleteProperty.
+*/
+Property *createProperty(const char *name, const char *group)
+{
+    if (name == NULL)
+    {
+        return NULL;
+    }
+    if (group == NULL)
+    {
+        group = "";
+    }
+
+    size_t nameLen = strlen(name) + 1;   // +1 for null terminator
+    size_t groupLen = strlen(group) + 1; // +1 for null terminator
+
+    PropertyBlock *block = vcMalloc(sizeof(PropertyBlock) + nameLen + groupLen);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    char *strings = (char *)(block + 1); // Strings start right after the struct
+    Property *property = &block->property;
+
+    property->name = strings;
+    memcpy(property->name, name, nameLen);
+    property->group = strings + nameLen;
+    memcpy(property->group, group, groupLen);
+
+    initializeEmbeddedList(&block->parameters, &parameterToString, &deleteParameter, &compareParameters);
+    initializeEmbeddedList(&block->values, &valueToString, &deleteValue, &compareValues);
+    property->parameters = &block->parameters;
+    property->values = &block->values;
+    block->structured = NULL;
+    block->blob = NULL;
+    block->stringBytes = nameLen + groupLen;
+
+    return property;
+}
+
+// Function to find the block a property was allocated in
+/*
+The lists of a property made by createProperty are the heads in its block. A property built by hand
+(Property is public) has lists of its own and no room after it, so only its own fields are read here.
+@param property - the property
+@return the block, or NULL for a property that was not made by createProperty
+*/
+PropertyBlock *propertyBlock(const Property *property)
+{
+    PropertyBlock *block = (PropertyBlock *)property;
+    if (property->parameters != &block->parameters || property->values != &block->values)
+    {
+        return NULL;
+    }
+    return block;
+}
+
+// Function to free a name or group string of a property, unless it is one of the strings packed in its
+// block. A name or group that replaced the packed one was allocated on its own.
+void freePropertyString(const Property *property, char *string)
+{
+    const PropertyBlock *block = propertyBlock(property);
+    if (block == NULL)
+    {
+        vcFree(string);
+        return;
+    }
+    const char *strings = (const char *)(block + 1);
+    if (string < strings || string >= strings + block->stringBytes)
+    {
+        vcFree(string);
+    }
+}
+
+// Function to copy a string into an allocation of exactly its size
+/*
+@param str - the string to copy
+@return the copy, or NULL if the allocation failed. Must be freed with vcFree.
+*/
+char *copyString(const char *str)
+{
+    size_t length = strlen(str) + 1; // +1 for null terminator
+    char *copy = vcMalloc(length);
+    if (copy != NULL)
+    {
+        memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+// Function to copy a parameter, its name and its value
+/*
+@param parameter - the parameter to copy
+@return the copy, or NULL if an allocation failed. Must be freed with deleteParameter.
+*/
+Parameter *copyParameter(const Parameter *parameter)
+{
+    Parameter *copy = vcMalloc(sizeof(Parameter));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    copy->name = copyString(parameter->name);
+    copy->value = copyString(parameter->value);
+    if (copy->name == NULL || copy->value == NULL)
+    {
+        deleteParameter(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+// Function to copy a property with all its parameters, values and typed view
+/*
+@param property - the property to copy
+@return the copy in its own block (see createProperty), or NULL if an allocation failed.
+        Must be freed with deleteProperty.
+*/
+Property *copyProperty(const Property *property)
+{
+    Property *copy = createProperty(property->name, property->group);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    for (Node *node = property->parameters->head; node != NULL; node = node->next)
+    {
+        Parameter *parameter = copyParameter(node->data);
+        if (parameter == NULL)
+        {
+            deleteProperty(copy);
+            return NULL;
+        }
+        insertBack(copy->parameters, parameter);
+    }
+
+    // Blob values stay where they are, in the card file the copy now holds as well
+    const PropertyBlock *block = propertyBlock(property);
+    BlobSource *blob = block != NULL ? block->blob : NULL;
+    if (blob != NULL)
+    {
+        useBlobSource(copy, blob);
+    }
+    for (Node *node = property->values->head; node != NULL; node = node->next)
+    {
+        char *value = blob != NULL ? node->data : copyString(node->data);
+        if (value == NULL)
+        {
+            deleteProperty(copy);
+            return NULL;
+        }
+        insertBack(copy->values, value);
+    }
+
+    const StructuredValue *structured = block != NULL ? block->structured : NULL;
+    if (structured != NULL)
+    {
+        propertyBlock(copy)->structured = copyStructuredValue(structured);
+        if (propertyBlock(copy)->structured == NULL)
+        {
+            deleteProperty(copy);
+            return NULL;
+        }
+    }
+
+    return copy;
+}
+
+// Function to copy a DateTime
+/*
+@param dateTime - the DateTime to copy
+@return the copy, or NULL if an allocation failed. Must be freed with deleteDate.
+        The date and time buffers keep at least the sizes updateBirthday uses.
+*/
+DateTime *copyDate(const DateTime *dateTime)
+{
+    DateTime *copy = vcMalloc(sizeof(DateTime));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+
+    size_t dateLen = strlen(dateTime->date) + 1;
+    size_t timeLen = strlen(dateTime->time) + 1;
+    copy->UTC = dateTime->UTC;
+    copy->isText = dateTime->isText;
+    copy->date = vcCalloc(dateLen > 9 ? dateLen : 9, sizeof(char)); // 8 digits + null
+    copy->time = vcCalloc(timeLen > 7 ? timeLen : 7, sizeof(char)); // 6 digits + null
+    copy->text = copyString(dateTime->text);
+    if (copy->date == NULL || copy->time == NULL || copy->text == NULL)
+    {
+        deleteDate(copy);
+        return NULL;
     }
-    return currentLine;
+    memcpy(copy->date, dateTime->date, dateLen);
+    memcpy(copy->time, dateTime->time, timeLen);
+    return copy;
 }
 
 // Function to check if a property name is valid (Sections 6.1 - 6.9.3)
@@ -0,0 +1,433 @@
+#include <iconv.h>
+#include "VCHelpers.h"
+#include "VCStructured.h"
+
+// vCard 2.1 and 3.0 cards are read by the same parser as 4.0 ones. The line reader joins the
+// quoted-printable soft line breaks, and every logical line after VERSION goes through
+// convertLegacyLine, which turns it into the 4.0 line it stands for: bare parameters get their
+// names, quoted-printable values are decoded, values in another CHARSET are converted to UTF-8,
+// and dates lose their '-' and ':' separators. Each line is converted once, as it is read, so
+// legacy cards need no separate pass before they are parsed.
+
+// Compares a span of text with a string, ignoring ASCII case
+static bool spanEquals(const char *span, size_t length, const char *str)
+{
+    if (strlen(str) != length)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        char a = span[i] >= 'a' && span[i] <= 'z' ? span[i] - 'a' + 'A' : span[i];
+        char b = str[i] >= 'a' && str[i] <= 'z' ? str[i] - 'a' + 'A' : str[i];
+        if (a != b)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Finds the ':' that ends the name and parameters, skipping quoted parameter values
+static const char *findValueColon(const char *line, size_t length)
+{
+    bool quoted = false;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (line[i] == '"')
+        {
+            quoted = !quoted;
+        }
+        else if (line[i] == ':' && !quoted)
+        {
+            return line + i;
+        }
+    }
+    return NULL;
+}
+
+// Function to tell whether a physical line starts a quoted-printable value
+/*
+@param line - the physical line, without its CRLF
+@param length - its length
+@return true if one of its parameters is QUOTED-PRINTABLE or ENCODING=QUOTED-PRINTABLE
+*/
+bool isQuotedPrintableLine(const char *line, size_t length)
+{
+    const char *colon = findValueColon(line, length);
+    size_t headerLength = colon != NULL ? (size_t)(colon - line) : length;
+    const char *token = "QUOTED-PRINTABLE";
+    size_t tokenLength = strlen(token);
+    for (size_t i = 0; i + tokenLength <= headerLength; i++)
+    {
+        if ((line[i] == 'Q' || line[i] == 'q') && spanEquals(line + i, tokenLength, token))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to tell whether a physical line starts a base64 value, which a 2.1 card may end with an empty line
+/*
+@param line - the physical line, without its CRLF
+@param length - its length
+@return true if one of its parameters is BASE64, ENCODING=BASE64 or ENCODING=B
+*/
+bool isBase64Line(const char *line, size_t length)
+{
+    const char *colon = findValueColon(line, length);
+    const char *end = colon != NULL ? colon : line + length;
+    const char *parameter = memchr(line, ';', end - line);
+    while (parameter != NULL)
+    {
+        parameter++;
+        const char *next = memchr(parameter, ';', end - parameter);
+        size_t parameterLength = (next != NULL ? next : end) - parameter;
+        if (spanEquals(parameter, parameterLength, "BASE64") || spanEquals(parameter, parameterLength, "ENCODING=BASE64") ||
+            spanEquals(parameter, parameterLength, "ENCODING=B"))
+        {
+            return true;
+        }
+        parameter = next;
+    }
+    return false;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// Decodes a quoted-printable value in place. The soft line breaks are already gone.
+/*
+@return the decoded length
+*/
+static size_t decodeQuotedPrintable(char *value, size_t length)
+{
+    size_t out = 0;
+    bool afterCR = false;
+    for (size_t i = 0; i < length; i++)
+    {
+        int high, low;
+        if (value[i] != '=' || i + 2 >= length || (high = hexValue(value[i + 1])) < 0 ||
+            (low = hexValue(value[i + 2])) < 0)
+        {
+            value[out++] = value[i]; // A lone '=' is kept as it is
+            afterCR = false;
+            continue;
+        }
+
+        char byte = (char)(high * 16 + low);
+        i += 2;
+        // Encoded line breaks (=0D=0A, =0D or =0A) become the \n escape, a 4.0 line has no raw breaks.
+        // The escape is shorter than what it replaces, so the value can still be decoded in place.
+        if (byte == '\r' || (byte == '\n' && !afterCR))
+        {
+            value[out++] = '\\';
+            value[out++] = 'n';
+        }
+        else if (byte != '\n')
+        {
+            value[out++] = byte;
+        }
+        afterCR = byte == '\r';
+    }
+    return out;
+}
+
+// Appends bytes in the given charset as UTF-8
+/*
+@return OK, INV_PROP if the charset is unknown, INV_CARD if the bytes are not valid in it,
+        OTHER_ERROR if an allocation failed
+*/
+static VCardErrorCode appendConverted(StringBuilder *sb, const char *charset, size_t charsetLength,
+                                      const char *bytes, size_t length)
+{
+    if (charset == NULL || spanEquals(charset, charsetLength, "UTF-8") || spanEquals(charset, charsetLength, "US-ASCII"))
+    {
+        return appendChars(sb, bytes, length) ? OK : OTHER_ERROR; // Checked with the rest of the line
+    }
+
+    if (spanEquals(charset, charsetLength, "ISO-8859-1") || spanEquals(charset, charsetLength, "LATIN1"))
+    {
+        // Every byte is the code point of the same value, no need for iconv
+        if (!reserveStringBuilder(sb, length * 2))
+        {
+            return OTHER_ERROR;
+        }
+        for (size_t i = 0; i < length; i++)
+        {
+            unsigned char byte = bytes[i];
+            if (byte < 0x80)
+            {
+                sb->data[sb->length++] = byte;
+            }
+            else
+            {
+                sb->data[sb->length++] = (char)(0xC0 | (byte >> 6));
+                sb->data[sb->length++] = (char)(0x80 | (byte & 0x3F));
+            }
+        }
+        sb->data[sb->length] = '\0';
+        return OK;
+    }
+
+    char name[64];
+    if (charsetLength >= sizeof(name))
+    {
+        return INV_PROP;
+    }
+    memcpy(name, charset, charsetLength);
+    name[charsetLength] = '\0';
+    iconv_t converter = iconv_open("UTF-8", name);
+    if (converter == (iconv_t)-1)
+    {
+        return INV_PROP;
+    }
+
+    // No charset needs more than 4 bytes of UTF-8 for one input byte
+    VCardErrorCode err = OK;
+    if (!reserveStringBuilder(sb, length * 4))
+    {
+        err = OTHER_ERROR;
+    }
+    else
+    {
+        char *in = (char *)bytes;
+        size_t inLeft = length;
+        char *out = sb->data + sb->length;
+        size_t outLeft = length * 4;
+        if (iconv(converter, &in, &inLeft, &out, &outLeft) == (size_t)-1 ||
+            iconv(converter, NULL, NULL, &out, &outLeft) == (size_t)-1)
+        {
+            err = INV_CARD; // Bytes that are not valid in the charset the card gives
+        }
+        sb->length = out - sb->data;
+        sb->data[sb->length] = '\0';
+    }
+    iconv_close(converter);
+    return err;
+}
+
+// Turns ISO 8601 extended dates of 2.1 and 3.0 (1996-04-15, 1953-10-15T23:10:00Z) into the basic
+// format of 4.0 by dropping the separators. Anything else, e.g. text dates, is left alone.
+static size_t compactDate(char *value, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = value[i];
+        if (!((c >= '0' && c <= '9') || c == '-' || c == ':' || c == 'T' || c == 'Z' || c == '+'))
+        {
+            return length;
+        }
+    }
+    size_t out = 0;
+    bool time = false;
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = value[i];
+        time = time || c == 'T';
+        // A '-' stays at the start of truncated dates (--0415) and as the sign of a time zone offset
+        bool separator = c == ':' || (c == '-' && !time && i > 0 && value[i - 1] >= '0' && value[i - 1] <= '9');
+        if (!separator)
+        {
+            value[out++] = c;
+        }
+    }
+    return out;
+}
+
+// Function to convert one logical line of a vCard 2.1 or 3.0 card into its vCard 4.0 form
+/*
+@param line - the unfolded line, quoted-printable soft line breaks already joined
+@param error - receives INV_CARD for bytes that are not valid in the line's charset, INV_PROP for
+               an unknown charset, OTHER_ERROR if an allocation failed
+@return the converted line, or NULL on error. Must be freed with vcFree.
+*/
+char *convertLegacyLine(const char *line, VCardErrorCode *error)
+{
+    size_t lineLength = strlen(line);
+    const char *colon = findValueColon(line, lineLength);
+    if (colon == NULL)
+    {
+        char *copy = copyString(line); // Not a property line, the parser rejects it
+        *error = copy != NULL ? OK : OTHER_ERROR;
+        return copy;
+    }
+
+    const char *nameEnd = memchr(line, ';', colon - line);
+    nameEnd = nameEnd != NULL ? nameEnd : colon;
+    const char *dot = memchr(line, '.', nameEnd - line);
+    const char *name = dot != NULL ? dot + 1 : line; // Without the group
+    size_t nameLength = nameEnd - name;
+
+    StringBuilder sb;
+    if (!initializeStringBuilder(&sb, lineLength + 16))
+    {
+        *error = OTHER_ERROR;
+        return NULL;
+    }
+    bool ok = appendChars(&sb, line, nameEnd - line);
+
+    // Parameters: bare ones get their name, the encoding and charset are applied to the value
+    bool quotedPrintable = false;
+    bool textValue = false;
+    const char *charset = NULL;
+    size_t charsetLength = 0;
+    const char *parameter = nameEnd;
+    while (ok && parameter < colon)
+    {
+        parameter++; // Skip the ';'
+        const char *parameterEnd = memchr(parameter, ';', colon - parameter);
+        parameterEnd = parameterEnd != NULL ? parameterEnd : colon;
+        size_t length = parameterEnd - parameter;
+        const char *equals = memchr(parameter, '=', length);
+
+        if (equals == NULL)
+        {
+            if (spanEquals(parameter, length, "QUOTED-PRINTABLE"))
+            {
+                quotedPrintable = true;
+            }
+            else if (spanEquals(parameter, length, "BASE64") || spanEquals(parameter, length, "B"))
+            {
+                ok = appendString(&sb, ";ENCODING=") && appendChars(&sb, parameter, length);
+            }
+            else if (length > 0 && !spanEquals(parameter, length, "8BIT") && !spanEquals(parameter, length, "7BIT"))
+            {
+                ok = appendString(&sb, ";TYPE=") && appendChars(&sb, parameter, length); // e.g. TEL;HOME;VOICE
+            }
+        }
+        else
+        {
+            size_t keyLength = equals - parameter;
+            const char *value = equals + 1;
+            size_t valueLength = parameterEnd - value;
+            if (spanEquals(parameter, keyLength, "ENCODING") &&
+                (spanEquals(value, valueLength, "QUOTED-PRINTABLE") || spanEquals(value, valueLength, "8BIT") ||
+                 spanEquals(value, valueLength, "7BIT")))
+            {
+                quotedPrintable = quotedPrintable || spanEquals(value, valueLength, "QUOTED-PRINTABLE");
+            }
+            else if (spanEquals(parameter, keyLength, "CHARSET"))
+            {
+                charset = value;
+                charsetLength = valueLength;
+            }
+            else
+            {
+                textValue = textValue || (spanEquals(parameter, keyLength, "VALUE") && spanEquals(value, valueLength, "text"));
+                ok = appendChar(&sb, ';') && appendChars(&sb, parameter, length);
+            }
+        }
+        parameter = parameterEnd;
+    }
+    ok = ok && appendChar(&sb, ':');
+    if (!ok)
+    {
+        freeStringBuilder(&sb);
+        *error = OTHER_ERROR;
+        return NULL;
+    }
+
+    // The value: decode the quoted-printable bytes, then convert them to UTF-8
+    size_t valueLength = line + lineLength - (colon + 1);
+    char *value = vcMalloc(valueLength + 1);
+    if (value == NULL)
+    {
+        freeStringBuilder(&sb);
+        *error = OTHER_ERROR;
+        return NULL;
+    }
+    memcpy(value, colon + 1, valueLength);
+    if (quotedPrintable)
+    {
+        valueLength = decodeQuotedPrintable(value, valueLength);
+    }
+    if (!textValue && (spanEquals(name, nameLength, "BDAY") || spanEquals(name, nameLength, "ANNIVERSARY")))
+    {
+        valueLength = compactDate(value, valueLength);
+    }
+    VCardErrorCode err = appendConverted(&sb, charset, charsetLength, value, valueLength);
+    vcFree(value);
+
+    if (err == OK && !isValidUtf8(sb.data, sb.length))
+    {
+        err = INV_CARD;
+    }
+    if (err != OK)
+    {
+        freeStringBuilder(&sb);
+        *error = err;
+        return NULL;
+    }
+    *error = OK;
+    return detachString(&sb);
+}
+
+// Appends the sub-components of an N component to a formatted name, separated by spaces
+static bool appendNamePart(StringBuilder *sb, const StructuredComponent *component)
+{
+    bool ok = true;
+    for (int i = 0; ok && i < component->count; i++)
+    {
+        if (component->values[i][0] == '\0')
+        {
+            continue;
+        }
+        if (sb->length > 0)
+        {
+            ok = appendChar(sb, ' ');
+        }
+        ok = ok && appendString(sb, component->values[i]);
+    }
+    return ok;
+}
+
+// Function to give a legacy card without FN (FN is optional in 2.1) the formatted name its N stands for
+/*
+@param card - the parsed card, its FN has no value yet
+@return true if an FN value was added, false if the card has no usable N or an allocation failed
+*/
+bool addLegacyFN(Card *card)
+{
+    const StructuredName *name = NULL;
+    for (Node *node = card->optionalProperties->head; node != NULL && name == NULL; node = node->next)
+    {
+        name = getStructuredName(node->data);
+    }
+    if (name == NULL)
+    {
+        return false;
+    }
+
+    // Prefixes, given, additional, family, suffixes: "Mr. John Quinlan Public Esq."
+    StringBuilder sb;
+    if (!initializeStringBuilder(&sb, 64))
+    {
+        return false;
+    }
+    bool ok = appendNamePart(&sb, &name->prefixes) && appendNamePart(&sb, &name->given) &&
+              appendNamePart(&sb, &name->additional) && appendNamePart(&sb, &name->family) &&
+              appendNamePart(&sb, &name->suffixes);
+    if (!ok || sb.length == 0)
+    {
+        freeStringBuilder(&sb);
+        return false;
+    }
+    insertBack(card->fn->values, detachString(&sb));
+    return true;
+}
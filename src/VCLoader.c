@@ -0,0 +1,631 @@
+#define _GNU_SOURCE // syscall, statx, O_CLOEXEC
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "VCLoader.h"
+#include "VCHelpers.h"
+
+#define DEFAULT_BATCH_SIZE 256
+#define MAX_BATCH_SIZE 4096
+
+// The io_uring instance is driven with the raw system calls, so there is no dependency on liburing
+struct vcLoader
+{
+    int batchSize;
+    int ringFd; // -1 when the fallback path is used
+
+    // Submission queue
+    void *sqRing;
+    size_t sqRingSize;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+    unsigned sqEntries;
+
+    // Completion queue, shares sqRing when the kernel supports a single mapping
+    void *cqRing;
+    size_t cqRingSize;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+
+    // Scratch space for one batch
+    int *fds;
+    struct statx *stats;
+
+    const CardProjection *projection; // Used by createCardsFromFiles, NULL reads every property
+};
+
+static void closeRing(VCLoader *loader)
+{
+    if (loader->sqes != NULL)
+    {
+        munmap(loader->sqes, loader->sqesSize);
+    }
+    if (loader->cqRing != NULL && loader->cqRing != loader->sqRing)
+    {
+        munmap(loader->cqRing, loader->cqRingSize);
+    }
+    if (loader->sqRing != NULL)
+    {
+        munmap(loader->sqRing, loader->sqRingSize);
+    }
+    if (loader->ringFd >= 0)
+    {
+        close(loader->ringFd);
+    }
+    loader->sqes = NULL;
+    loader->sqRing = NULL;
+    loader->cqRing = NULL;
+    loader->ringFd = -1;
+}
+
+// Tells whether the kernel supports every opcode a batch uses. io_uring itself is there since 5.1, but
+// OPENAT, STATX, READ and CLOSE came with 5.6 (like the probe), and before that they complete with -EINVAL.
+static bool ringSupportsBatch(int fd)
+{
+    static const unsigned char opcodes[] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE};
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = vcCalloc(1, size);
+    if (probe == NULL)
+    {
+        return false;
+    }
+
+    bool supported = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; supported && i < sizeof(opcodes); i++)
+    {
+        supported = opcodes[i] <= probe->last_op && opcodes[i] < probe->ops_len &&
+                    (probe->ops[opcodes[i]].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+    vcFree(probe);
+    return supported;
+}
+
+// Sets up a ring with room for one batch of opens and stats. Returns false if io_uring can't be used.
+static bool openRing(VCLoader *loader)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int)syscall(__NR_io_uring_setup, (unsigned)(2 * loader->batchSize), &params);
+    if (fd < 0)
+    {
+        return false;
+    }
+    loader->ringFd = fd;
+    if (!ringSupportsBatch(fd))
+    {
+        closeRing(loader);
+        return false;
+    }
+
+    loader->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    loader->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping && loader->cqRingSize > loader->sqRingSize)
+    {
+        loader->sqRingSize = loader->cqRingSize;
+    }
+
+    void *sqRing = mmap(NULL, loader->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+    {
+        closeRing(loader);
+        return false;
+    }
+    loader->sqRing = sqRing;
+
+    void *cqRing = sqRing;
+    if (!singleMapping)
+    {
+        cqRing = mmap(NULL, loader->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED)
+        {
+            closeRing(loader);
+            return false;
+        }
+    }
+    loader->cqRing = cqRing;
+
+    loader->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, loader->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        closeRing(loader);
+        return false;
+    }
+    loader->sqes = sqes;
+
+    char *sq = sqRing;
+    loader->sqHead = (unsigned *)(sq + params.sq_off.head);
+    loader->sqTail = (unsigned *)(sq + params.sq_off.tail);
+    loader->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+    loader->sqArray = (unsigned *)(sq + params.sq_off.array);
+    loader->sqEntries = params.sq_entries;
+
+    char *cq = cqRing;
+    loader->cqHead = (unsigned *)(cq + params.cq_off.head);
+    loader->cqTail = (unsigned *)(cq + params.cq_off.tail);
+    loader->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+    loader->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // The kernel may give fewer entries than asked for
+    if (loader->sqEntries < (unsigned)(2 * loader->batchSize))
+    {
+        loader->batchSize = (int)(loader->sqEntries / 2);
+    }
+    return loader->batchSize > 0;
+}
+
+VCLoader *createLoader(int batchSize, bool useIoUring)
+{
+    if (batchSize <= 0)
+    {
+        batchSize = DEFAULT_BATCH_SIZE;
+    }
+    if (batchSize > MAX_BATCH_SIZE)
+    {
+        batchSize = MAX_BATCH_SIZE;
+    }
+
+    VCLoader *loader = vcCalloc(1, sizeof(VCLoader));
+    if (loader == NULL)
+    {
+        return NULL;
+    }
+    loader->batchSize = batchSize;
+    loader->ringFd = -1;
+
+    if (useIoUring && !openRing(loader))
+    {
+        closeRing(loader);
+        loader->batchSize = batchSize;
+    }
+
+    loader->fds = vcMalloc(loader->batchSize * sizeof(int));
+    loader->stats = vcMalloc(loader->batchSize * sizeof(struct statx));
+    if (loader->fds == NULL || loader->stats == NULL)
+    {
+        deleteLoader(loader);
+        return NULL;
+    }
+    return loader;
+}
+
+void deleteLoader(VCLoader *loader)
+{
+    if (loader == NULL)
+    {
+        return;
+    }
+    closeRing(loader);
+    vcFree(loader->fds);
+    vcFree(loader->stats);
+    vcFree(loader);
+}
+
+bool loaderUsesIoUring(const VCLoader *loader)
+{
+    return loader != NULL && loader->ringFd >= 0;
+}
+
+void setLoaderProjection(VCLoader *loader, const CardProjection *projection)
+{
+    if (loader != NULL)
+    {
+        loader->projection = projection;
+    }
+}
+
+// Returns a cleared submission entry; only valid until the batch is submitted
+static struct io_uring_sqe *nextSqe(VCLoader *loader, unsigned *tail)
+{
+    unsigned index = *tail & *loader->sqMask;
+    struct io_uring_sqe *sqe = &loader->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    loader->sqArray[index] = index;
+    (*tail)++;
+    return sqe;
+}
+
+// Publishes the entries prepared since the last call and waits for all of their completions.
+// handle is called with the user data and result of every completion.
+static bool submitAndWait(VCLoader *loader, unsigned tail, unsigned count,
+                          void (*handle)(VCLoader *loader, LoadedFile *files, unsigned long long userData, int result),
+                          LoadedFile *files)
+{
+    __atomic_store_n(loader->sqTail, tail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0;
+    unsigned completed = 0;
+    while (completed < count)
+    {
+        int ret = (int)syscall(__NR_io_uring_enter, loader->ringFd, count - submitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            {
+                continue;
+            }
+            return false;
+        }
+        submitted += (unsigned)ret;
+
+        unsigned head = *loader->cqHead;
+        unsigned cqTail = __atomic_load_n(loader->cqTail, __ATOMIC_ACQUIRE);
+        while (head != cqTail)
+        {
+            struct io_uring_cqe *cqe = &loader->cqes[head & *loader->cqMask];
+            handle(loader, files, cqe->user_data, cqe->res);
+            head++;
+            completed++;
+        }
+        __atomic_store_n(loader->cqHead, head, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+// Phase 1: user data is index * 2 for the open and index * 2 + 1 for the statx
+static void handleOpen(VCLoader *loader, LoadedFile *files, unsigned long long userData, int result)
+{
+    int i = (int)(userData / 2);
+    if (userData % 2 == 0)
+    {
+        if (result >= 0)
+        {
+            loader->fds[i] = result;
+        }
+        else
+        {
+            files[i].error = -result;
+        }
+    }
+    else if (result < 0 && files[i].error == 0)
+    {
+        files[i].error = -result;
+    }
+}
+
+// Phase 2: user data is the index, the result is the number of bytes read
+static void handleRead(VCLoader *loader, LoadedFile *files, unsigned long long userData, int result)
+{
+    (void)loader;
+    int i = (int)userData;
+    if (result < 0)
+    {
+        files[i].error = -result;
+    }
+    else
+    {
+        files[i].length = (size_t)result;
+    }
+}
+
+static void handleClose(VCLoader *loader, LoadedFile *files, unsigned long long userData, int result)
+{
+    (void)loader;
+    (void)files;
+    (void)userData;
+    (void)result;
+}
+
+// Reads the rest of a file with plain system calls, for short reads and the fallback path
+static int readRemainder(int fd, LoadedFile *file, size_t size)
+{
+    while (file->length < size)
+    {
+        ssize_t got = pread(fd, file->data + file->length, size - file->length, (off_t)file->length);
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno;
+        }
+        if (got == 0)
+        {
+            break; // The file shrank since it was measured
+        }
+        file->length += (size_t)got;
+    }
+    return 0;
+}
+
+static void loadFileDirect(const char *fileName, LoadedFile *file)
+{
+    int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        file->error = errno;
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        file->error = errno;
+        close(fd);
+        return;
+    }
+
+    file->data = vcMalloc((size_t)st.st_size + 1);
+    if (file->data == NULL)
+    {
+        file->error = ENOMEM;
+        close(fd);
+        return;
+    }
+    file->error = readRemainder(fd, file, (size_t)st.st_size);
+    close(fd);
+}
+
+// Frees the contents of the files whose load failed, so data is only set on success
+static void finishBatch(LoadedFile *files, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (files[i].error != 0)
+        {
+            vcFree(files[i].data);
+            files[i].data = NULL;
+            files[i].length = 0;
+        }
+        else
+        {
+            files[i].data[files[i].length] = '\0';
+        }
+    }
+}
+
+// Loads one batch through the ring. Returns false if the ring failed, the batch is then left clean
+// (no open descriptors, no buffers) so it can be loaded again with the fallback path.
+static bool loadBatchRing(VCLoader *loader, char *const *fileNames, int count, LoadedFile *files)
+{
+    unsigned tail = *loader->sqTail;
+
+    // Phase 1: open and measure every file
+    for (int i = 0; i < count; i++)
+    {
+        loader->fds[i] = -1;
+
+        struct io_uring_sqe *sqe = nextSqe(loader, &tail);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long long)(uintptr_t)fileNames[i];
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = (unsigned long long)i * 2;
+
+        sqe = nextSqe(loader, &tail);
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long long)(uintptr_t)fileNames[i];
+        sqe->len = STATX_SIZE;
+        sqe->off = (unsigned long long)(uintptr_t)&loader->stats[i];
+        sqe->user_data = (unsigned long long)i * 2 + 1;
+    }
+    bool ok = submitAndWait(loader, tail, 2 * (unsigned)count, handleOpen, files);
+
+    // Phase 2: read every file that could be opened in one go
+    unsigned reads = 0;
+    for (int i = 0; ok && i < count; i++)
+    {
+        if (loader->fds[i] < 0 || files[i].error != 0)
+        {
+            continue;
+        }
+        size_t size = (size_t)loader->stats[i].stx_size;
+        files[i].data = vcMalloc(size + 1);
+        if (files[i].data == NULL)
+        {
+            files[i].error = ENOMEM;
+            continue;
+        }
+        if (size == 0)
+        {
+            continue;
+        }
+
+        struct io_uring_sqe *sqe = nextSqe(loader, &tail);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = loader->fds[i];
+        sqe->addr = (unsigned long long)(uintptr_t)files[i].data;
+        sqe->len = size > 0x7fffffff ? 0x7fffffff : (unsigned)size;
+        sqe->off = 0;
+        sqe->user_data = (unsigned long long)i;
+        reads++;
+    }
+    if (ok && reads > 0)
+    {
+        ok = submitAndWait(loader, tail, reads, handleRead, files);
+    }
+
+    // Short reads are rare (a file that grew, or one larger than a single read), finish them directly
+    for (int i = 0; ok && i < count; i++)
+    {
+        size_t size = (size_t)loader->stats[i].stx_size;
+        if (files[i].error == 0 && files[i].data != NULL && files[i].length < size)
+        {
+            files[i].error = readRemainder(loader->fds[i], &files[i], size);
+        }
+    }
+
+    // Phase 3: close everything that was opened
+    unsigned closes = 0;
+    for (int i = 0; ok && i < count; i++)
+    {
+        if (loader->fds[i] >= 0)
+        {
+            struct io_uring_sqe *sqe = nextSqe(loader, &tail);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = loader->fds[i];
+            sqe->user_data = (unsigned long long)i;
+            closes++;
+        }
+    }
+    if (ok && closes > 0 && !submitAndWait(loader, tail, closes, handleClose, files))
+    {
+        // Some descriptors may be closed already and their numbers reused, leaking the rest is safer
+        for (int i = 0; i < count; i++)
+        {
+            loader->fds[i] = -1;
+        }
+        ok = false;
+    }
+    if (ok)
+    {
+        return true;
+    }
+
+    // The ring failed part of the way through: undo the batch
+    for (int i = 0; i < count; i++)
+    {
+        if (loader->fds[i] >= 0)
+        {
+            close(loader->fds[i]);
+        }
+        vcFree(files[i].data);
+        files[i].data = NULL;
+        files[i].length = 0;
+        files[i].error = 0;
+    }
+    return false;
+}
+
+void loadFiles(VCLoader *loader, char *const *fileNames, int count, LoadedFile *files)
+{
+    if (loader == NULL || fileNames == NULL || files == NULL)
+    {
+        return;
+    }
+
+    for (int start = 0; start < count; start += loader->batchSize)
+    {
+        int batch = count - start < loader->batchSize ? count - start : loader->batchSize;
+        memset(files + start, 0, batch * sizeof(LoadedFile));
+
+        if (loader->ringFd >= 0 && loadBatchRing(loader, fileNames + start, batch, files + start))
+        {
+            finishBatch(files + start, batch);
+            continue;
+        }
+        if (loader->ringFd >= 0)
+        {
+            closeRing(loader); // Don't try the ring again after it failed once
+        }
+
+        for (int i = 0; i < batch; i++)
+        {
+            loadFileDirect(fileNames[start + i], &files[start + i]);
+        }
+        finishBatch(files + start, batch);
+    }
+}
+
+// Function to load and parse card files batch by batch, parsing only those that match a filter
+/*
+@param filter - the filter, NULL parses every file
+@return the number of cards that were parsed successfully
+*/
+static int parseCardFiles(VCLoader *loader, char *const *fileNames, int count, const CardFilter *filter, Card **cards,
+                          VCardErrorCode *errors)
+{
+    if (loader == NULL || fileNames == NULL || cards == NULL || errors == NULL)
+    {
+        return 0;
+    }
+
+    LoadedFile *files = vcMalloc(loader->batchSize * sizeof(LoadedFile));
+    char **names = vcMalloc(loader->batchSize * sizeof(char *));
+    int *positions = vcMalloc(loader->batchSize * sizeof(int));
+    if (files == NULL || names == NULL || positions == NULL)
+    {
+        vcFree(files);
+        vcFree(names);
+        vcFree(positions);
+        for (int i = 0; i < count; i++)
+        {
+            cards[i] = NULL;
+            errors[i] = OTHER_ERROR;
+        }
+        return 0;
+    }
+
+    int parsed = 0;
+    int i = 0;
+    while (i < count)
+    {
+        // Collect a batch of names with a card extension, the others fail like they do in createCard
+        int batch = 0;
+        for (; i < count && batch < loader->batchSize; i++)
+        {
+            cards[i] = NULL;
+            if (fileNames[i] == NULL || !hasCardExtension(fileNames[i]))
+            {
+                errors[i] = INV_FILE;
+                continue;
+            }
+            names[batch] = fileNames[i];
+            positions[batch] = i;
+            batch++;
+        }
+
+        unsigned long long start = statsNow();
+        loadFiles(loader, names, batch, files);
+        threadStats.readNs += statsNow() - start;
+
+        for (int b = 0; b < batch; b++)
+        {
+            int index = positions[b];
+            if (files[b].data == NULL)
+            {
+                errors[index] = files[b].error == ENOMEM ? OTHER_ERROR : INV_FILE;
+                continue;
+            }
+            if (filter != NULL && !cardMatchesFilter(files[b].data, files[b].length, filter))
+            {
+                vcFree(files[b].data);
+                files[b].data = NULL;
+                errors[index] = OK;
+                continue;
+            }
+            // The card takes the buffer over, so large PHOTO, KEY and LOGO values are not copied out of it
+            errors[index] = parseCardBuffer(files[b].data, files[b].length, true, loader->projection, &cards[index]);
+            files[b].data = NULL;
+            if (errors[index] == OK)
+            {
+                parsed++;
+            }
+            else
+            {
+                cards[index] = NULL;
+            }
+        }
+    }
+
+    vcFree(files);
+    vcFree(names);
+    vcFree(positions);
+    return parsed;
+}
+
+int createCardsFromFiles(VCLoader *loader, char *const *fileNames, int count, Card **cards, VCardErrorCode *errors)
+{
+    return parseCardFiles(loader, fileNames, count, NULL, cards, errors);
+}
+
+int scanCardFiles(VCLoader *loader, char *const *fileNames, int count, const CardFilter *filter, Card **cards,
+                  VCardErrorCode *errors)
+{
+    return parseCardFiles(loader, fileNames, count, filter, cards, errors);
+}
@@ -3,73 +3,35 @@
 #include "VCHelpers.h"
 
 // ************* Card parser functions - MUST be implemented ***************
-VCardErrorCode createCard(char *fileName, Card **obj)
+// Does the work of createCard and createCardFromBuffer, the public functions add the timing.
+// With a source (see VCSource.h) the span each part of the card came from is recorded as well.
+static VCardErrorCode parseCard(LineReader *reader, Card **obj, CardSource *source)
 {
-    if (fileName == NULL || obj == NULL)
-    {
-        return INV_FILE; // Invalid input
-    }
-
-    // Check file extension
-    const char *dot = strrchr(fileName, '.'); // Find last occurrence of '.'
-    if (!dot || (strcmp(dot, ".vcf") != 0 && strcmp(dot, ".vcard") != 0))
-    {
-        *obj = NULL;
-        return INV_FILE; // Reject if extension is not .vcf or .vcard
-    }
-
-    FILE *file = fopen(fileName, "r");
-    if (file == NULL)
-    {
-        return INV_FILE; // File could not be opened
-    }
-
     // Allocate memory for the Card structure
-    *obj = malloc(sizeof(Card));
+    *obj = vcMalloc(sizeof(Card));
 
-    // Allocate memory for the FN property
-    (*obj)->fn = malloc(sizeof(Property));
+    // Allocate the FN property, its name, group and lists come in the same block
+    (*obj)->fn = createProperty("FN", "");
     if ((*obj)->fn == NULL)
     {
-        free(*obj);
-        fclose(file);
-        deleteCard(*obj);
+        vcFree(*obj);
         return OTHER_ERROR;
     }
 
-    // Initialize the FN property
-    (*obj)->fn->name = NULL;
-    (*obj)->fn->group = NULL;
-    (*obj)->fn->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
-    (*obj)->fn->values = initializeList(&valueToString, &deleteValue, &compareValues);
-
     // Initialize space for other properties
     (*obj)->optionalProperties = initializeList(&propertyToString, &deleteProperty, &compareProperties);
     (*obj)->birthday = NULL;
     (*obj)->anniversary = NULL;
 
-    // Check if memory allocation failed
-    if ((*obj)->fn->values == NULL)
-    {
-        free((*obj)->fn);
-        free(*obj);
-        fclose(file);
-        deleteCard(*obj);
-        return OTHER_ERROR;
-    }
-
-    // Initialize values and memory for line size, the current property, and the fn name
+    // Initialize values and memory for line size and the current property
     // char line[256];
-    Property *currentProperty = malloc(sizeof(Property));
-    (*obj)->fn->name = malloc(30);  // Allocate memory for the FN property
-    (*obj)->fn->group = malloc(30); // Allocate memory for the group
+    Property *currentProperty = vcMalloc(sizeof(Property));
 
     // Check if memory allocation failed
-    if (currentProperty == NULL || (*obj)->fn->name == NULL)
+    if (currentProperty == NULL)
     {
-        free(currentProperty);
+        vcFree(currentProperty);
         deleteCard(*obj);
-        fclose(file);
         return OTHER_ERROR;
     }
     currentProperty->name = NULL;  // Initialize the name of the current property to NULL
@@ -81,18 +43,17 @@ VCardErrorCode createCard(char *fileName, Card **obj)
     bool versionTag = false;
     bool fnTag = false;
 
-    // Read the file line by line
+    // Read the card line by line
     char *line = NULL;
     VCardErrorCode error = OK;
 
-    // Loop to read each line from the file
-    while ((line = readAndCombineLines(file, &error)) != NULL)
+    // Loop to read each logical line of the card
+    while ((line = readAndCombineLines(reader, &error)) != NULL)
     {
 
         if (error == INV_CARD)
         {
-            free(line);
-            fclose(file);
+            vcFree(line);
             deleteCard(*obj);
             *obj = NULL;
             return INV_CARD;
@@ -102,47 +63,69 @@ VCardErrorCode createCard(char *fileName, Card **obj)
         if (strcmp(line, "BEGIN:VCARD") == 0)
         { // Skip these lines
             beginTag = true;
-            free(line);
+            vcFree(line);
             continue;
         }
         // Make sure the version is 4.0
         if (strcmp(line, "VERSION:4.0") == 0)
         { // Skip these lines
             versionTag = true;
-            free(line);
+            vcFree(line);
+            continue;
+        }
+        // 2.1 and 3.0 cards are read as well, every line after this one is converted to 4.0 (see VCLegacy.c)
+        if (strcmp(line, "VERSION:3.0") == 0 || strcmp(line, "VERSION:2.1") == 0)
+        {
+            versionTag = true;
+            reader->legacy = true;
+            vcFree(line);
             continue;
         }
         // Make sure we have an end property
         if (strcmp(line, "END:VCARD") == 0)
         { // Skip this line
             endTag = true;
-            free(line);
+            vcFree(line);
             continue;
         }
-        else if (strchr(line, ':') == NULL)
+        if (reader->legacy)
+        {
+            char *converted = convertLegacyLine(line, &error);
+            vcFree(line);
+            if (converted == NULL)
+            {
+                vcFree(currentProperty->name);
+                vcFree(currentProperty->group);
+                vcFree(currentProperty);
+                deleteCard(*obj);
+                *obj = NULL;
+                return error;
+            }
+            line = converted;
+        }
+        if (strchr(line, ':') == NULL)
         {
-            free(line);
-            fclose(file);
+            vcFree(line);
             deleteCard(*obj);
             *obj = NULL;
             return INV_PROP;
         }
+        VC_TRACE_BEGIN("tokenize");
         // Make sure the line has a value before the colon
         if (line[0] == ':' || line[0] == ';')
         {
-            free(line);
-            fclose(file);
-            free(currentProperty->name);
-            free(currentProperty);
+            vcFree(line);
+            vcFree(currentProperty->name);
+            vcFree(currentProperty);
             deleteCard(*obj);
             *obj = NULL;
             return INV_PROP; // Missing property name
         }
         if (currentProperty->name != NULL)
         { // Free the name of the current property if it is not NULL
-            free(currentProperty->name);
+            vcFree(currentProperty->name);
         }
-        currentProperty->name = calloc(10000, sizeof(char)); // Allocate memory for the property name
+        currentProperty->name = vcCalloc(strlen(line) + 1, sizeof(char)); // The name can never be longer than the line
         // Remove newline characters
         line[strcspn(line, "\r\n")] = 0;
 
@@ -153,46 +136,47 @@ VCardErrorCode createCard(char *fileName, Card **obj)
             { // If we hit a colon, then we want to stop copying the name and start copying into the value
                 if (currentProperty->name == NULL)
                 {
-                    free(currentProperty->name);
+                    vcFree(currentProperty->name);
                     deleteCard(*obj);
-                    fclose(file);
                     return INV_PROP;
                 }
                 if (strcmp(currentProperty->name, "FN") == 0)
                 { // If the property is FN
                     fnTag = true;
-                    strcpy((*obj)->fn->name, currentProperty->name); // Set the name of the FN property
                     i++;                                             // Skip the colon
-                    int j = 0;
-                    char *fnValue = calloc(strlen(line) + 1, sizeof(char)); // Allocate memory for FN value
+                    size_t rawLength = strlen(line + i);
+                    size_t fnLength = 0;
+                    char *fnValue = vcMalloc(rawLength + 1); // Allocate memory for FN value, escapes only make it shorter
 
                     // Check if memory allocation failed
                     if (fnValue == NULL)
                     {
-                        free(fnValue);
+                        vcFree(fnValue);
                         deleteCard(*obj);
                         return OTHER_ERROR;
                     }
-                    while (line[i] != '\0')
-                    { // Copy the value into the value string
-                        fnValue[j] = line[i];
-                        i++;
-                        j++;
-                    }
+                    // Copy the value into the value string, decoding its escapes. FN is a single value, so ';' does not split it
+                    unescapeValue(line + i, line + i + rawLength, fnValue, &fnLength, false, false);
+                    fnValue[fnLength] = '\0';
                     // **Check if no value was copied:**
-                    if (j == 0)
+                    if (rawLength == 0)
                     {
-                        free(fnValue);
+                        vcFree(fnValue);
                         deleteCard(*obj);
-                        fclose(file);
                         *obj = NULL;
                         return INV_PROP; // Missing property value
                     }
                     insertBack((*obj)->fn->values, fnValue); // Insert the value into the values list
+                    if (source != NULL)
+                    {
+                        recordSourceSpan(source, (*obj)->fn, reader);
+                    }
+                    threadStats.properties++;
+                    threadStats.values++;
                     // Check if insertion failed
                     if ((*obj)->fn->values == NULL)
                     {
-                        free(fnValue);
+                        vcFree(fnValue);
                         deleteCard(*obj);
                         return INV_PROP;
                     }
@@ -209,48 +193,14 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                     // Allocate memory for new properties
                     // Key is to do this in here and initialize! Narrowest scope, and we need to initialize them if we want to free them,
                     // even if we don't use them. We need to do it so we can properly free them later.
-                    Property *newProperty = malloc(sizeof(Property)); // Allocate memory for the new property
+                    // createProperty copies the name and group (NULL group becomes an empty string) and sets up both lists.
+                    Property *newProperty = createProperty(currentProperty->name, currentProperty->group);
                     if (newProperty == NULL)
                     {
                         deleteCard(*obj);
-                        fclose(file);
                         return OTHER_ERROR;
                     }
-                    // We need to initialize the new property, and all of its values, even if we don't use them yet
-                    newProperty->group = NULL; // Initialize the group of the new property to NULL
-                    // Check if currentProperty->group is not NULL before copying
-                    if (currentProperty->group != NULL)
-                    {
-                        newProperty->group = malloc(strlen(currentProperty->group) + 1); // +1 for null terminator
-                        if (newProperty->group == NULL)
-                        {
-                            deleteCard(*obj);
-                            fclose(file);
-                            return OTHER_ERROR;
-                        }
-                        strcpy(newProperty->group, currentProperty->group);
-                    }
-                    else
-                    {
-                        // If the current property group is null, then we just put an empty string in the new property group
-                        newProperty->group = calloc(1, sizeof(char));
-                        if (newProperty->group == NULL)
-                        {
-                            deleteCard(*obj);
-                            fclose(file);
-                            return OTHER_ERROR;
-                        }
-                        strcpy(newProperty->group, "");
-                    }
-
-                    newProperty->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters); // Initialize the parameters list
-
-                    // Initialize the new property lists and values
-                    newProperty->name = calloc(30, sizeof(char));                                       // Allocate memory for the name
-                    newProperty->values = initializeList(&valueToString, &deleteValue, &compareValues); // Initialize the values list
-
-                    // Copy the name of the current property into the new property
-                    strcpy(newProperty->name, currentProperty->name);
+                    threadStats.properties++;
 
                     // If we hit a semicolon, we want to start parsing the parameters
                     if (line[i] == ';')
@@ -258,24 +208,24 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                         i++; // Skip the semicolon
                         while (line[i] != ':' && line[i] != '\0')
                         { // Continue until ':' or end of line
-                            Parameter *newParameter = malloc(sizeof(Parameter));
+                            Parameter *newParameter = vcMalloc(sizeof(Parameter));
                             if (newParameter == NULL)
                             {
                                 deleteCard(*obj);
-                                fclose(file);
                                 return OTHER_ERROR;
                             }
 
-                            // Allocate memory for parameter name and value
-                            newParameter->name = calloc(30, sizeof(char));
-                            newParameter->value = calloc(30, sizeof(char));
+                            // Allocate memory for parameter name and value, sized to the spans they take up on the line
+                            size_t nameLength = strcspn(line + i, "=:");
+                            size_t valueLength = line[i + nameLength] == '=' ? strcspn(line + i + nameLength + 1, ";:") : 0;
+                            newParameter->name = vcMalloc(nameLength + 1);
+                            newParameter->value = vcMalloc(valueLength + 1);
                             if (newParameter->name == NULL || newParameter->value == NULL)
                             {
-                                free(newParameter->name);
-                                free(newParameter->value);
-                                free(newParameter);
+                                vcFree(newParameter->name);
+                                vcFree(newParameter->value);
+                                vcFree(newParameter);
                                 deleteCard(*obj);
-                                fclose(file);
                                 return OTHER_ERROR; // Memory allocation failed
                             }
 
@@ -290,11 +240,10 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                             // Validate parameter name
                             if (j == 0 || line[i] != '=')
                             { // No name or missing '='
-                                free(newParameter->name);
-                                free(newParameter->value);
-                                free(newParameter);
+                                vcFree(newParameter->name);
+                                vcFree(newParameter->value);
+                                vcFree(newParameter);
                                 deleteCard(*obj);
-                                fclose(file);
                                 return INV_PROP;
                             }
 
@@ -316,11 +265,10 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                             }
                             // **Add check for empty parameter value:**
                             if (strlen(newParameter->value) == 0) {
-                                free(newParameter->name);
-                                free(newParameter->value);
-                                free(newParameter);
+                                vcFree(newParameter->name);
+                                vcFree(newParameter->value);
+                                vcFree(newParameter);
                                 deleteCard(*obj);
-                                fclose(file);
                                 *obj = NULL;
                                 return INV_PROP;  // Parameter value is missing/empty
                             }
@@ -333,6 +281,7 @@ VCardErrorCode createCard(char *fileName, Card **obj)
 
                             // Add the parameter to the parameters list
                             insertBack(newProperty->parameters, newParameter);
+                            threadStats.parameters++;
 
                             if (line[i] == ';')
                             {
@@ -343,33 +292,34 @@ VCardErrorCode createCard(char *fileName, Card **obj)
 
                     if (strcmp(currentProperty->name, "BDAY") == 0 || strcmp(currentProperty->name, "ANNIVERSARY") == 0)
                     {
+                        VC_TRACE_BEGIN("dateTime");
                         // Allocate memory for DateTime structure
-                        DateTime *dateTime = malloc(sizeof(DateTime));
+                        DateTime *dateTime = vcMalloc(sizeof(DateTime));
                         if (dateTime == NULL)
                         {
-                            free(currentProperty->name);
+                            vcFree(currentProperty->name);
                             deleteCard(*obj);
-                            fclose(file);
                             return OTHER_ERROR;
                         }
 
                         // Initialize DateTime fields
                         dateTime->UTC = false;
                         dateTime->isText = false;
-                        dateTime->date = calloc(11, sizeof(char)); // +2 extra space
-                        dateTime->time = calloc(9, sizeof(char));  // +2 extra space
-                        dateTime->text = calloc(strlen(line) + 2, sizeof(char));
+                        // The date part of a date-time can be as long as the line, a date-only value gets 8 characters
+                        size_t dateSize = strlen(line) + 2 > 11 ? strlen(line) + 2 : 11;
+                        dateTime->date = vcCalloc(dateSize, sizeof(char));
+                        dateTime->time = vcCalloc(9, sizeof(char));  // +2 extra space
+                        dateTime->text = vcCalloc(strlen(line) + 2, sizeof(char));
 
                         // Check if memory allocation failed
                         if (dateTime->date == NULL || dateTime->time == NULL || dateTime->text == NULL)
                         {
-                            free(dateTime->date);
-                            free(dateTime->time);
-                            free(dateTime->text);
-                            free(dateTime);
-                            free(currentProperty->name);
+                            vcFree(dateTime->date);
+                            vcFree(dateTime->time);
+                            vcFree(dateTime->text);
+                            vcFree(dateTime);
+                            vcFree(currentProperty->name);
                             deleteCard(*obj);
-                            fclose(file);
                             return OTHER_ERROR;
                         }
 
@@ -377,13 +327,12 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                         char *value = strchr(line, ':') + 1;
                         if (value == NULL)
                         {
-                            free(dateTime->date);
-                            free(dateTime->time);
-                            free(dateTime->text);
-                            free(dateTime);
-                            free(currentProperty->name);
+                            vcFree(dateTime->date);
+                            vcFree(dateTime->time);
+                            vcFree(dateTime->text);
+                            vcFree(dateTime);
+                            vcFree(currentProperty->name);
                             deleteCard(*obj);
-                            fclose(file);
                             return INV_PROP;
                         }
 
@@ -451,86 +400,89 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                         {
                             if ((*obj)->birthday != NULL)
                             { // Prevent duplicate BDAY
-                                free(dateTime->date);
-                                free(dateTime->time);
-                                free(dateTime->text);
-                                free(dateTime);
-                                free(currentProperty->name);
+                                vcFree(dateTime->date);
+                                vcFree(dateTime->time);
+                                vcFree(dateTime->text);
+                                vcFree(dateTime);
+                                vcFree(currentProperty->name);
                                 deleteCard(*obj);
-                                fclose(file);
                                 return INV_PROP;
                             }
                             (*obj)->birthday = dateTime;
+                            if (source != NULL)
+                            {
+                                recordSourceSpan(source, dateTime, reader);
+                            }
                         }
                         else if (strcmp(currentProperty->name, "ANNIVERSARY") == 0)
                         {
                             if ((*obj)->anniversary != NULL)
                             { // Prevent duplicate ANNIVERSARY
-                                free(dateTime->date);
-                                free(dateTime->time);
-                                free(dateTime->text);
-                                free(dateTime);
-                                free(currentProperty->name);
+                                vcFree(dateTime->date);
+                                vcFree(dateTime->time);
+                                vcFree(dateTime->text);
+                                vcFree(dateTime);
+                                vcFree(currentProperty->name);
                                 deleteCard(*obj);
-                                fclose(file);
                                 return INV_PROP;
                             }
                             (*obj)->anniversary = dateTime;
+                            if (source != NULL)
+                            {
+                                recordSourceSpan(source, dateTime, reader);
+                            }
                         }
+                        VC_TRACE_END();
                     }
 
                     // Get values of the property otherwise
-                    char *propValue = calloc(strlen(line) + 1, sizeof(char)); // Allocate memory for the property value
-                    // Check if memory allocation failed
-                    if (propValue == NULL)
+                    i++; // Skip the colon
+                    const char *rawValue = line + i; // Kept for the typed N and ADR view
+                    char *blobOut = NULL; // Base64 PHOTO, KEY and LOGO values stay in the card file, see VCBlob.h
+                    if (reader->blobValue != NULL)
                     {
-                        free(propValue);
-                        deleteCard(*obj);
-                        return OTHER_ERROR;
+                        useBlobSource(newProperty, reader->blobSource);
+                        rawValue = blobOut = reader->blobValue;
                     }
-
-                    int j = 0;
-                    i++; // Skip the colon
-                    char *currentValue = NULL;
-                    while (line[i] != '\0')
+                    const char *rawEnd = rawValue + strlen(rawValue);
+                    bool structured = structuredComponentCount(newProperty->name) > 0;
+                    bool keepCommas = keepsCommaEscapes(newProperty->name);
+                    const char *position = rawValue;
+                    while (position < rawEnd || (structured && position > rawValue && position[-1] == ';'))
                     {
-                        // Get the values for our new properties
+                        // Split values on unescaped semicolons and decode the escapes in the same pass.
+                        // For structured values a trailing separator means the last component is empty, e.g. "N:Doe;John;;;"
+                        // The rest of the line is the most it can take. Base64 blob values have no escapes, they are only
+                        // split on ';' and terminated in place (unescapeValue can't write over the text it reads).
+                        char *currentValue = blobOut != NULL ? blobOut : vcMalloc(rawEnd - position + 1);
                         if (currentValue == NULL)
                         {
-                            currentValue = calloc(strlen(line) + 1, sizeof(char)); // Allocate memory for the value
-                            if (currentValue == NULL)
-                            {
-                                deleteCard(*obj);
-                                return OTHER_ERROR;
-                            }
-                        }
-                        if (line[i] == '\\' && line[i + 1] == ';')
-                        {                            // Handle escaped semicolon
-                            currentValue[j++] = ';'; // Add literal semicolon
-                            i += 2;                  // Skip over "\;"
+                            deleteProperty(newProperty);
+                            deleteCard(*obj);
+                            return OTHER_ERROR;
                         }
-                        else if (line[i] == ';')
-                        {                                                  // Split values on semicolon
-                            currentValue[j] = '\0';                        // Null-terminate the current value
-                            insertBack(newProperty->values, currentValue); // Add to values list
-                            currentValue = NULL;                           // Reset for the next value
-                            j = 0;                                         // Reset index
-                            i++;
+                        size_t length = 0;
+                        if (blobOut != NULL)
+                        {
+                            const char *semicolon = memchr(position, ';', rawEnd - position);
+                            length = (semicolon != NULL ? semicolon : rawEnd) - position;
+                            position += length;
+                            blobOut = currentValue + length + 1;
                         }
                         else
                         {
-                            currentValue[j++] = line[i++]; // Add character to the current value
+                            position = unescapeValue(position, rawEnd, currentValue, &length, true, keepCommas);
                         }
+                        currentValue[length] = '\0';
+                        insertBack(newProperty->values, currentValue); // Add to values list
+                        threadStats.values++;
+                        if (position == rawEnd)
+                        {
+                            break;
+                        }
+                        position++; // Skip the semicolon, another value follows
                     }
-                    // Add the last value (after the final semicolon or end of line)
-                    if (currentValue != NULL)
-                    {
-                        currentValue[j] = '\0'; // Null-terminate
-                        insertBack(newProperty->values, currentValue);
-                        currentValue = NULL;
-                    }
-                    free(currentValue); // Free the current value
-                    free(propValue);    // Free the property value
+                    i = reader->blobValue != NULL ? i : position - line;
                     if (newProperty->values == NULL)
                     {
                         deleteCard(*obj);
@@ -541,10 +493,27 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                         deleteCard(*obj);
                         return INV_PROP;
                     }
+                    if (structured)
+                    {
+                        // Split N and ADR into their components while the raw line, escapes and all, is at hand
+                        propertyBlock(newProperty)->structured = parseStructuredValue(newProperty->name, rawValue);
+                        if (propertyBlock(newProperty)->structured == NULL)
+                        {
+                            deleteProperty(newProperty);
+                            deleteCard(*obj);
+                            return OTHER_ERROR;
+                        }
+                    }
 
                     if (strcmp(newProperty->name, "BDAY") != 0 && strcmp(newProperty->name, "ANNIVERSARY") != 0)
                     {
+                        VC_TRACE_BEGIN("insert");
                         insertBack((*obj)->optionalProperties, newProperty); // Insert the new property into the optional properties list
+                        if (source != NULL)
+                        {
+                            recordSourceSpan(source, newProperty, reader);
+                        }
+                        VC_TRACE_END();
                     }
                     else
                     {
@@ -560,13 +529,13 @@ VCardErrorCode createCard(char *fileName, Card **obj)
 
                 // Extract the group (everything before the dot)
                 size_t groupLen = dotPos - line;
+                vcFree(currentProperty->group); // Drop the group of the previous line
                 if (groupLen > 0)
                 {
-                    currentProperty->group = calloc(groupLen + 1, sizeof(char));
+                    currentProperty->group = vcCalloc(groupLen + 1, sizeof(char));
                     if (currentProperty->group == NULL)
                     {
                         deleteCard(*obj);
-                        fclose(file);
                         return OTHER_ERROR;
                     }
                     strncpy(currentProperty->group, line, groupLen);
@@ -575,7 +544,7 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                 else
                 {
                     // No group found
-                    currentProperty->group = calloc(1, sizeof(char));
+                    currentProperty->group = vcCalloc(1, sizeof(char));
                 }
 
                 // Extract property name (everything after dot but before `;` or `:`)
@@ -589,7 +558,6 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                     if (currentProperty->name == NULL)
                     {
                         deleteCard(*obj);
-                        fclose(file);
                         return OTHER_ERROR;
                     }
                     strncpy(currentProperty->name, nameStart, nameLen);
@@ -598,7 +566,6 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                 else
                 {
                     deleteCard(*obj);
-                    fclose(file);
                     return INV_PROP;
                 }
             }
@@ -607,41 +574,181 @@ VCardErrorCode createCard(char *fileName, Card **obj)
                 currentProperty->name[i] = line[i]; // Copy the character into the name
             }
         }
-        free(line);
+        vcFree(line);
+        VC_TRACE_END();
     }
-    fclose(file);
 
-    // If FN was not found, return an error
-    if ((*obj)->fn == NULL)
+    // The line reader stopped early, e.g. on bytes that are not UTF-8
+    if (error != OK)
     {
+        vcFree(currentProperty->name);
+        vcFree(currentProperty->group);
+        vcFree(currentProperty);
         deleteCard(*obj);
-        return INV_CARD;
+        *obj = NULL;
+        return error;
     }
 
-    if ((*obj)->fn->group == NULL)
+    // FN is optional in 2.1, such cards get the name their N stands for
+    if (!fnTag && reader->legacy)
     {
-        (*obj)->fn->group = calloc(1, sizeof(char)); // Allocates one char (initialized to '\0')
-        if ((*obj)->fn->group == NULL)
-        {
-            deleteCard(*obj);
-            return OTHER_ERROR;
-        }
+        fnTag = addLegacyFN(*obj);
     }
-    if (!fnTag)
+
+    vcFree(currentProperty->name);
+    vcFree(currentProperty->group);
+    vcFree(currentProperty);
+
+    // If FN was not found, or a BEGIN, END or VERSION line is missing, return an error
+    if ((*obj)->fn == NULL || !fnTag || beginTag == false || endTag == false || versionTag == false)
     {
         deleteCard(*obj);
+        *obj = NULL;
         return INV_CARD;
     }
-    if (beginTag == false || endTag == false || versionTag == false)
+
+    return OK;
+}
+
+VCardErrorCode createCard(char *fileName, Card **obj)
+{
+    return loadCard(fileName, obj, NULL, NULL);
+}
+
+// createCard, optionally recording where each part of the card is in the file, or reading only
+// the properties of a projection (see VCProjection.h)
+VCardErrorCode loadCard(const char *fileName, Card **obj, CardSource *source, const CardProjection *projection)
+{
+    if (fileName == NULL || obj == NULL)
+    {
+        return INV_FILE; // Invalid input
+    }
+    if (!hasCardExtension(fileName))
     {
-        deleteCard(*obj);
         *obj = NULL;
+        return INV_FILE; // Reject if extension is not .vcf or .vcard
+    }
+
+    // Everything that is not spent reading counts as tokenizing
+    unsigned long long start = statsNow();
+    unsigned long long readBefore = threadStats.readNs;
+    int traceDepth = VC_TRACE_DEPTH();
+    VC_TRACE_BEGIN_DETAIL("createCard", fileName);
+
+    // The whole file is read at once, then parsed from memory
+    VC_TRACE_BEGIN("open");
+    size_t length = 0;
+    VCardErrorCode err = OK;
+    char *data = readCardFile(fileName, &length, &err);
+    VC_TRACE_END();
+    threadStats.readNs += statsNow() - start;
+
+    if (data != NULL)
+    {
+        LineReader reader;
+        initializeOwningLineReader(&reader, data, length);
+        reader.projection = projection;
+        err = parseCard(&reader, obj, source);
+        if (source != NULL && reader.legacy)
+        {
+            // The file says VERSION:2.1 or 3.0 and its lines have another syntax, so 4.0 lines can't be spliced in
+            markSourceBroken(source);
+        }
+        finishLineReader(&reader); // Frees the file, unless blob values point into it
+    }
+
+    VC_TRACE_UNWIND(traceDepth); // Also closes the spans left open by an early return
+    threadStats.tokenizeNs += statsNow() - start - (threadStats.readNs - readBefore);
+    return err;
+}
+
+// Parses a card that is already in memory. With owned set the buffer was allocated with vcMalloc and
+// the parser takes it over: it is freed, or kept for the blob values that point into it, so they need
+// no copy (see VCBlob.h). A projection limits the properties that are read (see VCProjection.h).
+VCardErrorCode parseCardBuffer(const char *data, size_t length, bool owned, const CardProjection *projection, Card **obj)
+{
+    if (data == NULL || obj == NULL)
+    {
+        if (owned)
+        {
+            vcFree((char *)data);
+        }
+        return INV_FILE; // Invalid input
+    }
+
+    unsigned long long start = statsNow();
+    unsigned long long readBefore = threadStats.readNs;
+    int traceDepth = VC_TRACE_DEPTH();
+    VC_TRACE_BEGIN("createCard");
+
+    LineReader reader;
+    if (owned)
+    {
+        initializeOwningLineReader(&reader, (char *)data, length);
+    }
+    else
+    {
+        initializeLineReader(&reader, data, length);
+    }
+    reader.projection = projection;
+    VCardErrorCode err = parseCard(&reader, obj, NULL);
+    finishLineReader(&reader);
+
+    VC_TRACE_UNWIND(traceDepth);
+    threadStats.tokenizeNs += statsNow() - start - (threadStats.readNs - readBefore);
+    return err;
+}
+
+VCardErrorCode createCardFromBuffer(const char *data, size_t length, Card **obj)
+{
+    return parseCardBuffer(data, length, false, NULL, obj);
+}
+
+VCardErrorCode cloneCard(const Card *obj, Card **copy)
+{
+    if (obj == NULL || obj->fn == NULL || obj->optionalProperties == NULL || copy == NULL)
+    {
         return INV_CARD;
     }
 
-    free(currentProperty->name);
-    free(currentProperty);
+    Card *card = vcCalloc(1, sizeof(Card));
+    if (card == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    // Every part gets its own allocation of exactly its size, so the copy can be edited with the
+    // update functions and freed with deleteCard like any parsed card
+    card->optionalProperties = initializeList(&propertyToString, &deleteProperty, &compareProperties);
+    card->fn = copyProperty(obj->fn);
+    bool ok = card->optionalProperties != NULL && card->fn != NULL;
+    if (ok && obj->birthday != NULL)
+    {
+        card->birthday = copyDate(obj->birthday);
+        ok = card->birthday != NULL;
+    }
+    if (ok && obj->anniversary != NULL)
+    {
+        card->anniversary = copyDate(obj->anniversary);
+        ok = card->anniversary != NULL;
+    }
+    for (Node *node = obj->optionalProperties->head; ok && node != NULL; node = node->next)
+    {
+        Property *property = copyProperty(node->data);
+        if (property != NULL)
+        {
+            insertBack(card->optionalProperties, property);
+        }
+        ok = property != NULL;
+    }
 
+    if (!ok)
+    {
+        deleteCard(card);
+        return OTHER_ERROR;
+    }
+
+    *copy = card;
     return OK;
 }
 
@@ -671,68 +778,77 @@ void deleteCard(Card *obj)
         deleteDate(obj->anniversary);
     }
 
-    free(obj); // Free the Card object itself
+    vcFree(obj); // Free the Card object itself
     obj = NULL;
 }
 
-char *cardToString(const Card *obj)
+static char *buildCardString(const Card *obj)
 {
     if (obj == NULL)
     {
         return NULL;
     }
 
-    // Allocate a large enough buffer for the vCard string
-    size_t bufferSize = 4096;
-    char *string = calloc(bufferSize, sizeof(char));
-    if (string == NULL)
+    // Start with room for a typical card, the builder doubles if it needs more
+    StringBuilder sb;
+    if (!initializeStringBuilder(&sb, 512))
     {
         return NULL;
     }
 
+    if (!appendCard(&sb, obj))
+    {
+        freeStringBuilder(&sb);
+        return NULL;
+    }
+
+    return detachString(&sb);
+}
+
+// Returns the card in vCard format as a new string, timed as serialization in the stats
+char *cardToString(const Card *obj)
+{
+    unsigned long long start = statsNow();
+    VC_TRACE_BEGIN("cardToString");
+    char *str = buildCardString(obj);
+    VC_TRACE_END();
+    threadStats.serializeNs += statsNow() - start;
+    return str;
+}
+
+// Appends the whole card in vCard format, every line terminated by CRLF
+bool appendCard(StringBuilder *sb, const Card *obj)
+{
     // Append required headers
-    strcat(string, "BEGIN:VCARD\r\n");
-    strcat(string, "VERSION:4.0\r\n");
+    bool ok = appendString(sb, "BEGIN:VCARD\r\n");
+    ok = ok && appendString(sb, "VERSION:4.0\r\n");
+
+    // Every other line is folded to 75 octets by endLine as soon as it is complete
+    size_t lineStart = sb->length;
 
     // Add FN (Full Name)
     if (obj->fn != NULL)
     {
-        char *fnString = propertyToString(obj->fn);
-        if (fnString != NULL)
-        {
-            strcat(string, fnString);
-            strcat(string, "\r\n");
-            //printf("Length of fnString in cardToString: %ld\r\n", strlen(fnString));
-            free(fnString);
-        }
+        ok = ok && appendProperty(sb, obj->fn);
+        ok = ok && endLine(sb, lineStart);
     }
 
-    // Add Birthday
+    // Add Birthday, the DateTime string starts with the ':' or the VALUE parameter
     if (obj->birthday != NULL)
     {
-        char *bdayString = dateToString(obj->birthday);
-        if (bdayString != NULL)
-        {
-            strcat(string, "BDAY:");
-            strcat(string, bdayString);
-            strcat(string, "\r\n");
-            //("Length of bdayString in cardToString: %ld\r\n", strlen(bdayString));
-            free(bdayString);
-        }
+        lineStart = sb->length;
+        ok = ok && appendString(sb, "BDAY");
+        ok = ok && appendDateTime(sb, obj->birthday);
+        ok = ok && endLine(sb, lineStart);
     }
 
     // Add Anniversary
     if (obj->anniversary != NULL)
     {
-        char *annString = dateToString(obj->anniversary);
-        if (annString != NULL)
-        {
-            strcat(string, "ANNIVERSARY:");
-            strcat(string, annString);
-            strcat(string, "\r\n");
-            //printf("Length of annString in cardToString: %ld\r\n", strlen(annString));
-            free(annString);
-        }
+        lineStart = sb->length;
+        ok = ok && appendString(sb, "ANNIVERSARY");
+        ok = ok && appendDateTime(sb, obj->anniversary);
+        ok = ok && endLine(sb, lineStart);
     }
 
     // Check if optionalProperties is NULL before iterating
@@ -741,23 +857,18 @@ char *cardToString(const Card *obj)
         ListIterator iter = createIterator(obj->optionalProperties);
         Property *prop;
 
-        while ((prop = nextElement(&iter)) != NULL)
+        while (ok && (prop = nextElement(&iter)) != NULL)
         {
-            char *propString = propertyToString(prop);
-            if (propString != NULL)
-            {
-                strcat(string, propString);
-                strcat(string, "\r\n");
-                //printf("Length of propString in cardToString: %ld\r\n", strlen(propString));
-                free(propString);
-            }
+            lineStart = sb->length;
+            ok = appendProperty(sb, prop);
+            ok = ok && endLine(sb, lineStart);
         }
     }
 
     // Append required footer
-    strcat(string, "END:VCARD\r\n");
+    ok = ok && appendString(sb, "END:VCARD\r\n");
 
-    return string;
+    return ok;
 }
 
 char *errorToString(VCardErrorCode err)
@@ -779,7 +890,7 @@ char *errorToString(VCardErrorCode err)
     }
 }
 // ************* Assignment 2 functions - MUST be implemented ***************
-VCardErrorCode writeCard(const char *fileName, const Card *obj)
+static VCardErrorCode writeCardFile(const char *fileName, const Card *obj)
 {
     if (fileName == NULL || obj == NULL)
     {
@@ -793,84 +904,50 @@ VCardErrorCode writeCard(const char *fileName, const Card *obj)
         return WRITE_ERROR;
     }
 
-    // Open file for writing
-    FILE *file = fopen(fileName, "w");
-    if (file == NULL)
+    // Serialize the whole card first, so a failed allocation never leaves a half-written file
+    StringBuilder sb;
+    if (!initializeStringBuilder(&sb, 512))
     {
-        return WRITE_ERROR;
-    }
-
-
-    
-    //Declare everything before, it's weird, i don't know why
-    char *fnString = propertyToString(obj->fn);
-    if (fnString != NULL){
-        strcat(fnString, "\r\n");
-    }
-    char *bdayString = dateToString(obj->birthday);
-    if (bdayString != NULL){
-        strcat(bdayString, "\r\n");
-    }
-    char *annString = dateToString(obj->anniversary);
-    if (annString != NULL){
-        strcat(annString, "\r\n");
+        return OTHER_ERROR;
     }
-    ListIterator iter = createIterator(obj->optionalProperties);
-    Property *prop;
-
-    // Write vCard header
-    fprintf(file, "BEGIN:VCARD\r\n");
-    fprintf(file, "VERSION:4.0\r\n");
-
-    // Write FN (Full Name)
-    if (obj->fn != NULL && obj->fn->values != NULL)
+    if (!appendCard(&sb, obj))
     {
-        fprintf(file, "%s", fnString);
-
-        //printf("%s", fnString);
-        //printf("REEEESULLTTTTT of strcmp: %d\n", strcmp(fnString, "FN:Simon Perreault\r\n"));
-
-        free(fnString);
+        freeStringBuilder(&sb);
+        return OTHER_ERROR;
     }
 
-    // Write BDAY
-    if (obj->birthday != NULL)
+    // Open file for writing
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL)
     {
-
-        fprintf(file, "BDAY%s", bdayString);
-        // printAscii(bdayString);
-        free(bdayString);
+        freeStringBuilder(&sb);
+        return WRITE_ERROR;
     }
 
-    // Write ANNIVERSARY
-    if (obj->anniversary != NULL)
-    {
-        fprintf(file, "ANNIVERSARY%s", annString);
-        // printAscii(annString);
-        free(annString);
-    } 
+    size_t length = sb.length;
+    size_t written = fwrite(sb.data, sizeof(char), length, file);
+    freeStringBuilder(&sb);
 
-    // Write optional properties
-    //ListIterator iter = createIterator(obj->optionalProperties);
-    //Property *prop;
-    while ((prop = nextElement(&iter)) != NULL)
+    // Close file
+    if (fclose(file) != 0 || written != length)
     {
-        char *propString = propertyToString(prop);
-        strcat(propString, "\r\n");
-        fprintf(file, "%s", propString);
-        free(propString);
+        return WRITE_ERROR;
     }
 
-    // Write vCard footer
-    fprintf(file, "END:VCARD\r\n");
-
-    // Close file
-    fclose(file);
-
     return OK;
 }
 
-VCardErrorCode validateCard(const Card *obj)
+VCardErrorCode writeCard(const char *fileName, const Card *obj)
+{
+    unsigned long long start = statsNow();
+    VC_TRACE_BEGIN_DETAIL("write", fileName);
+    VCardErrorCode err = writeCardFile(fileName, obj);
+    VC_TRACE_END();
+    threadStats.serializeNs += statsNow() - start;
+    return err;
+}
+
+static VCardErrorCode checkCard(const Card *obj)
 {
 
     if (obj == NULL)
@@ -992,6 +1069,16 @@ VCardErrorCode validateCard(const Card *obj)
     return OK; // Everything is valid
 }
 
+VCardErrorCode validateCard(const Card *obj)
+{
+    unsigned long long start = statsNow();
+    VC_TRACE_BEGIN("validate");
+    VCardErrorCode err = checkCard(obj);
+    VC_TRACE_END();
+    threadStats.validateNs += statsNow() - start;
+    return err;
+}
+
 // *************************************************************************
 
 // ************* List helper functions - MUST be implemented ***************
@@ -1006,28 +1093,28 @@ void deleteProperty(void *toBeDeleted)
 
     // printf("[DEBUG] Deleting property: %s\n", property->name ? property->name : "(null)");
 
-    if (property->name != NULL)
-    {
-        free(property->name);
-        property->name = NULL;
-    }
-    if (property->group != NULL)
-    {
-        free(property->group);
-        property->group = NULL;
-    }
-    if (property->parameters != NULL)
+    PropertyBlock *block = propertyBlock(property);
+    if (block == NULL)
     {
+        // Built by hand, field by field: every part was allocated on its own
+        vcFree(property->name);
+        vcFree(property->group);
         freeList(property->parameters);
-        property->parameters = NULL;
-    }
-    if (property->values != NULL)
-    {
         freeList(property->values);
-        property->values = NULL;
+        vcFree(property);
+        return;
     }
 
-    free(property);
+    // The list heads, and the name and group unless they were replaced, are part of the property's
+    // block (see createProperty), so only the list contents and the typed view are released separately
+    clearList(property->parameters);
+    clearList(property->values);
+    freePropertyString(property, property->name);
+    freePropertyString(property, property->group);
+    vcFree(block->structured);
+    releaseBlobSource(block->blob);
+
+    vcFree(block);
 }
 
 int compareProperties(const void *first, const void *second)
@@ -1052,37 +1139,52 @@ char *propertyToString(void *prop)
         return NULL;
     }
 
-    char *string = malloc(1000*sizeof(char)); // Allocate memory
-    if (string == NULL)
+    StringBuilder sb;
+    if (!initializeStringBuilder(&sb, 0))
+    {
+        return NULL;
+    }
+
+    if (!appendProperty(&sb, property))
     {
+        freeStringBuilder(&sb);
         return NULL;
     }
 
+    //printf("[DEBUG] Final property string: '%s'\n", sb.data);
+    return detachString(&sb);
+}
+
+// Appends a single property line (without the line ending)
+bool appendProperty(StringBuilder *sb, const Property *property)
+{
+    if (property->name == NULL)
+    {
+        return true; // Nothing to write
+    }
+
     // Start with the property name
-    strcpy(string, property->name);
-    //printf("Name: %s\n",string);
+    bool ok = appendString(sb, property->name);
 
     // Ensure parameters list is not NULL before using it
     if (property->parameters != NULL)
     {
         ListIterator paramIter = createIterator(property->parameters);
         Parameter *param;
-        while ((param = nextElement(&paramIter)) != NULL)
+        while (ok && (param = nextElement(&paramIter)) != NULL)
         {
             if (param->name != NULL && param->value != NULL) // Ensure parameter fields are not NULL
             {
-                strcat(string, ";");
-                strcat(string, param->name);
-                strcat(string, "=");
-                strcat(string, param->value);
-                //printf("%s\n",string);
+                ok = appendChar(sb, ';');
+                ok = ok && appendString(sb, param->name);
+                ok = ok && appendChar(sb, '=');
+                ok = ok && appendString(sb, param->value);
             }
         }
     }
 
     // Add values
-    strcat(string, ":");
-    //printf("Add colon%s\n",string);
+    ok = ok && appendChar(sb, ':');
 
     // Ensure values list is not NULL before iterating
     if (property->values != NULL)
@@ -1091,51 +1193,36 @@ char *propertyToString(void *prop)
         char *value;
         bool firstValue = true;
 
-        // Detect if this property should use semicolons (structured values)
-        bool isStructured = (strcmp(property->name, "N") == 0 || strcmp(property->name, "ADR") == 0);
+        // Detect if this property should use semicolons (structured values), and how many components it has
+        int componentCount = structuredComponentCount(property->name);
+        bool isStructured = componentCount > 0;
+        bool keepCommas = keepsCommaEscapes(property->name);
+        bool escapeCommas = !keepCommas && !isUriValue(property);
 
         int valueCount = 0;
-        while ((value = nextElement(&valueIter)) != NULL)
+        while (ok && (value = nextElement(&valueIter)) != NULL)
         {
             valueCount++;
 
             // If not the first value, insert the correct separator
             if (!firstValue)
             {
-                strcat(string, isStructured ? ";" : ","); // Use ';' for structured props, ',' for normal
-                //printf("Adding value: %s\n",string);
+                ok = appendChar(sb, isStructured ? ';' : ','); // Use ';' for structured props, ',' for normal
             }
 
-            // Ensure value is not NULL before copying
-            if (value != NULL)
-            {
-                // printf("value: %s\n", value);
-                strcat(string, value);
-                //printf("Adding value: %s\n",string);
-            }
+            ok = ok && appendEscapedValue(sb, value, keepCommas, escapeCommas); // N, ADR and comma lists still hold their \, and \\ escapes
             firstValue = false;
         }
 
-        // If structured, ensure at least 5 values (for N, ADR)
-        if (isStructured && valueCount < 5)
+        // If structured, ensure all components are there (5 for N, 7 for ADR)
+        while (ok && isStructured && valueCount < componentCount)
         {
-            while (valueCount < 5)
-            {
-                strcat(string, ";");
-                //printf("%s\n",string);
-                valueCount++;
-            }
+            ok = appendChar(sb, ';');
+            valueCount++;
         }
     }
 
-    // strcat(string,"\r\n");
-
-    /* // Make string the exact size needed
-    int strLength = strlen(string);
-    string = realloc(string, strLength + 1); */
-
-    //printf("[DEBUG] Final property string: '%s'\n", string);
-    return string;
+    return ok;
 }
 
 void deleteParameter(void *toBeDeleted)
@@ -1147,13 +1234,13 @@ void deleteParameter(void *toBeDeleted)
     Parameter *param = (Parameter *)toBeDeleted; // Cast the void pointer to a Parameter pointer
     if (param->name != NULL)
     {
-        free(param->name); // Free the name string
+        vcFree(param->name); // Free the name string
     }
     if (param->value != NULL)
     {
-        free(param->value); // Free the value string
+        vcFree(param->value); // Free the value string
     }
-    free(param); // Free the Parameter object
+    vcFree(param); // Free the Parameter object
 }
 int compareParameters(const void *first, const void *second)
 {
@@ -1167,19 +1254,21 @@ char *parameterToString(void *param)
         return NULL;
     }
     Parameter *parameter = (Parameter *)param; // Cast the void pointer to a Parameter pointer
-    char *string = malloc(1000);
-    if (string == NULL)
+    StringBuilder sb;
+    if (!initializeStringBuilder(&sb, 0))
     {
-        free(string);
         return NULL; // Allocation failed
     }
-    strcpy(string, "Parameter: ");
-    strcat(string, parameter->name);
-    strcat(string, "=");
-    strcat(string, parameter->value);
-    return string;
-
-    return NULL; // Placeholder
+    bool ok = appendString(&sb, "Parameter: ");
+    ok = ok && appendString(&sb, parameter->name);
+    ok = ok && appendChar(&sb, '=');
+    ok = ok && appendString(&sb, parameter->value);
+    if (!ok)
+    {
+        freeStringBuilder(&sb);
+        return NULL;
+    }
+    return detachString(&sb);
 }
 
 void deleteValue(void *toBeDeleted)
@@ -1189,7 +1278,7 @@ void deleteValue(void *toBeDeleted)
         return;
     }
     char *value = (char *)toBeDeleted; // Cast the void pointer to a char pointer
-    free(value);                       // Free the value string
+    vcFree(value);                       // Free the value string
 }
 int compareValues(const void *first, const void *second)
 {
@@ -1198,13 +1287,17 @@ int compareValues(const void *first, const void *second)
 }
 char *valueToString(void *val)
 {
-    char *string = malloc(1000);
+    if (val == NULL)
+    {
+        return NULL;
+    }
+    size_t length = strlen((char *)val) + 1; // +1 for null terminator
+    char *string = vcMalloc(length);
     if (string == NULL)
     {
-        free(string);
         return NULL; // Allocation failed
     }
-    strcpy(string, (char *)val);
+    memcpy(string, val, length);
     return string;
 }
 
@@ -1218,18 +1311,18 @@ void deleteDate(void *toBeDeleted)
 
     if (date->date != NULL)
     {
-        free(date->date); // Free the date string
+        vcFree(date->date); // Free the date string
     }
     if (date->time != NULL)
     {
-        free(date->time); // Free the time string
+        vcFree(date->time); // Free the time string
     }
     if (date->text != NULL)
     {
-        free(date->text); // Free the text string
+        vcFree(date->text); // Free the text string
     }
 
-    free(date); // Free the DateTime object
+    vcFree(date); // Free the DateTime object
 }
 int compareDates(const void *first, const void *second)
 {
@@ -1244,41 +1337,45 @@ char *dateToString(void *date)
         return NULL;
     }
 
-    DateTime *dateTime = (DateTime *)date;
-    char *string = calloc(100, sizeof(char));
-    if (string == NULL)
+    StringBuilder sb;
+    if (!initializeStringBuilder(&sb, 0))
+    {
+        return NULL;
+    }
+
+    if (!appendDateTime(&sb, (DateTime *)date))
     {
+        freeStringBuilder(&sb);
         return NULL;
     }
 
+    return detachString(&sb);
+}
+
+// Appends a DateTime the way it follows the property name: ";VALUE=text:<text>" or ":<date>T<time>Z"
+bool appendDateTime(StringBuilder *sb, const DateTime *dateTime)
+{
     if (dateTime->isText)
     {
-        strcat(string,";VALUE=text:");
-        strcat(string, dateTime->text);
+        return appendString(sb, ";VALUE=text:") && appendString(sb, dateTime->text);
     }
-    else
+
+    bool ok = appendChar(sb, ':');
+    ok = ok && appendString(sb, dateTime->date);
+    if (strlen(dateTime->time) > 0)
     {
-        strcat(string,":");
-        if (strlen(dateTime->date) > 0)
-        {
-            strcat(string, dateTime->date);
-        }
-        if (strlen(dateTime->time) > 0)
-        {
-            strcat(string, "T");
-            strcat(string, dateTime->time);
-        }
+        ok = ok && appendChar(sb, 'T');
+        ok = ok && appendString(sb, dateTime->time);
+    }
 
-        if (dateTime->UTC)
-        {
-            strcat(string, "Z");
-        }
+    if (dateTime->UTC)
+    {
+        ok = ok && appendChar(sb, 'Z');
     }
 
-    return string;
+    return ok;
 }
 
-
 // ************* ASSIGNMENT 3 FUNCTIONS HERE *************** //
 
 // Returns a copy of the FN property value from the card.
@@ -1298,7 +1395,7 @@ char* getBirthday(const Card* card) {
         return NULL;
     }
     DateTime* bday = card->birthday;
-    char* result = malloc(100);
+    char* result = vcMalloc(100);
     if (result == NULL) {
         return NULL;
     }
@@ -1316,7 +1413,7 @@ char* getAnniversary(const Card* card) {
         return NULL;
     }
     DateTime* anniv = card->anniversary;
-    char* result = malloc(100);
+    char* result = vcMalloc(100);
     if (result == NULL) {
         return NULL;
     }
@@ -1344,30 +1441,29 @@ VCardErrorCode updateFN(Card* card, const char* newFN) {
     if (card == NULL || card->fn == NULL || newFN == NULL || strlen(newFN) == 0) {
         return INV_PROP;
     }
-    // Ensure the FN property’s name is set to "FN".
-    if (card->fn->name == NULL) {
-        card->fn->name = malloc(3);  // 2 characters for "FN" + 1 for null terminator.
-        if (card->fn->name == NULL) {
+    // Ensure the FN property’s name is set to "FN". A missing or empty name has no room for it,
+    // so it gets a string of its own (deleteProperty frees it, see freePropertyString).
+    if (card->fn->name == NULL || strlen(card->fn->name) == 0) {
+        char* name = copyString("FN");
+        if (name == NULL) {
             return OTHER_ERROR;
         }
-        strcpy(card->fn->name, "FN");
-    } else {
-        // In case it already exists but is empty:
-        if (strlen(card->fn->name) == 0) {
-            strcpy(card->fn->name, "FN");
+        if (card->fn->name != NULL) {
+            freePropertyString(card->fn, card->fn->name);
         }
+        card->fn->name = name;
     }
     // Now update the value.
     if (card->fn->values && card->fn->values->head) {
-        free(card->fn->values->head->data);
-        char* updated = malloc(strlen(newFN) + 1);
+        vcFree(card->fn->values->head->data);
+        char* updated = vcMalloc(strlen(newFN) + 1);
         if (updated == NULL) {
             return OTHER_ERROR;
         }
         strcpy(updated, newFN);
         card->fn->values->head->data = updated;
     } else {
-        char* new_value = malloc(strlen(newFN) + 1);
+        char* new_value = vcMalloc(strlen(newFN) + 1);
         if (new_value == NULL) {
             return OTHER_ERROR;
         }
@@ -1386,18 +1482,23 @@ VCardErrorCode updateBirthday(Card* card, const char* newBirthday) {
         return INV_PROP;
     }
     if (card->birthday == NULL) {
-        card->birthday = malloc(sizeof(DateTime));
+        card->birthday = vcMalloc(sizeof(DateTime));
         if (card->birthday == NULL) return OTHER_ERROR;
-        card->birthday->date = calloc(9, sizeof(char));  // 8 digits + null
-        card->birthday->time = calloc(7, sizeof(char));  // 6 digits + null
-        card->birthday->text = calloc(strlen(newBirthday) + 1, sizeof(char));
+        card->birthday->date = vcCalloc(9, sizeof(char));  // 8 digits + null
+        card->birthday->time = vcCalloc(7, sizeof(char));  // 6 digits + null
+        card->birthday->text = vcCalloc(strlen(newBirthday) + 1, sizeof(char));
         if (!card->birthday->date || !card->birthday->time || !card->birthday->text) {
-            free(card->birthday->date);
-            free(card->birthday->time);
-            free(card->birthday->text);
-            free(card->birthday);
+            vcFree(card->birthday->date);
+            vcFree(card->birthday->time);
+            vcFree(card->birthday->text);
+            vcFree(card->birthday);
             return OTHER_ERROR;
         }
+    } else if (strlen(card->birthday->text) < strlen(newBirthday)) {
+        // The old text is too short for the new one
+        char* text = vcRealloc(card->birthday->text, strlen(newBirthday) + 1);
+        if (text == NULL) return OTHER_ERROR;
+        card->birthday->text = text;
     }
     card->birthday->isText = true;
     card->birthday->UTC = false;
@@ -1414,18 +1515,23 @@ VCardErrorCode updateAnniversary(Card* card, const char* newAnniv) {
         return INV_PROP;
     }
     if (card->anniversary == NULL) {
-        card->anniversary = malloc(sizeof(DateTime));
+        card->anniversary = vcMalloc(sizeof(DateTime));
         if (card->anniversary == NULL) return OTHER_ERROR;
-        card->anniversary->date = calloc(9, sizeof(char));
-        card->anniversary->time = calloc(7, sizeof(char));
-        card->anniversary->text = calloc(strlen(newAnniv) + 1, sizeof(char));
+        card->anniversary->date = vcCalloc(9, sizeof(char));
+        card->anniversary->time = vcCalloc(7, sizeof(char));
+        card->anniversary->text = vcCalloc(strlen(newAnniv) + 1, sizeof(char));
         if (!card->anniversary->date || !card->anniversary->time || !card->anniversary->text) {
-            free(card->anniversary->date);
-            free(card->anniversary->time);
-            free(card->anniversary->text);
-            free(card->anniversary);
+            vcFree(card->anniversary->date);
+            vcFree(card->anniversary->time);
+            vcFree(card->anniversary->text);
+            vcFree(card->anniversary);
             return OTHER_ERROR;
         }
+    } else if (strlen(card->anniversary->text) < strlen(newAnniv)) {
+        // The old text is too short for the new one
+        char* text = vcRealloc(card->anniversary->text, strlen(newAnniv) + 1);
+        if (text == NULL) return OTHER_ERROR;
+        card->anniversary->text = text;
     }
     card->anniversary->isText = true;
     card->anniversary->UTC = false;
@@ -1438,20 +1544,15 @@ VCardErrorCode updateAnniversary(Card* card, const char* newAnniv) {
 // Allocates and returns a new vCard with a minimal structure.
 // We need this so that we can “create” a new card on disk when the user presses OK in the Create view
 Card* newCard() {
-    Card* card = malloc(sizeof(Card));
+    Card* card = vcMalloc(sizeof(Card));
     if (!card) return NULL;
 
     // Allocate and initialize FN property.
-    card->fn = malloc(sizeof(Property));
+    card->fn = createProperty("FN", "");
     if (!card->fn) {
-        free(card);
+        vcFree(card);
         return NULL;
     }
-    card->fn->name = calloc(30, sizeof(char));  
-    strcpy(card->fn->name, "FN");
-    card->fn->group = calloc(30, sizeof(char));
-    card->fn->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
-    card->fn->values = initializeList(&valueToString, &deleteValue, &compareValues);
     
     // Initialize optional properties list.
     card->optionalProperties = initializeList(&propertyToString, &deleteProperty, &compareProperties);
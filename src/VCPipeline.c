@@ -0,0 +1,466 @@
+#define _GNU_SOURCE // sysconf, sched_yield, nanosleep
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "VCPipeline.h"
+#include "VCLoader.h"
+#include "VCHelpers.h"
+
+#define DEFAULT_QUEUE_SIZE 1024
+#define MAX_WORKERS 256
+#define CACHE_LINE 64
+
+// ************* Bounded MPMC ring (Dmitry Vyukov's design) ***************
+// Every cell has a sequence number: a producer may fill the cell when sequence == position,
+// a consumer may empty it when sequence == position + 1. Positions only grow, so there is no ABA problem.
+
+typedef struct
+{
+    atomic_size_t sequence;
+    size_t value;
+} RingCell;
+
+typedef struct
+{
+    RingCell *cells;
+    size_t mask;
+    alignas(CACHE_LINE) atomic_size_t enqueuePosition;
+    alignas(CACHE_LINE) atomic_size_t dequeuePosition;
+} Ring;
+
+static bool initializeRing(Ring *ring, size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    ring->cells = vcMalloc(size * sizeof(RingCell));
+    if (ring->cells == NULL)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        atomic_init(&ring->cells[i].sequence, i);
+    }
+    ring->mask = size - 1;
+    atomic_init(&ring->enqueuePosition, 0);
+    atomic_init(&ring->dequeuePosition, 0);
+    return true;
+}
+
+static bool tryPush(Ring *ring, size_t value)
+{
+    size_t position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+    RingCell *cell;
+    for (;;)
+    {
+        cell = &ring->cells[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueuePosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false; // Full
+        }
+        else
+        {
+            position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+        }
+    }
+    cell->value = value;
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+    return true;
+}
+
+static bool tryPop(Ring *ring, size_t *value)
+{
+    size_t position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+    RingCell *cell;
+    for (;;)
+    {
+        cell = &ring->cells[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeuePosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false; // Empty
+        }
+        else
+        {
+            position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+        }
+    }
+    *value = cell->value;
+    atomic_store_explicit(&cell->sequence, position + ring->mask + 1, memory_order_release);
+    return true;
+}
+
+// Waiting between attempts: spin a little, then give the CPU away, then sleep
+static void backOff(int *attempts)
+{
+    (*attempts)++;
+    if (*attempts < 64)
+    {
+        return;
+    }
+    if (*attempts < 128)
+    {
+        sched_yield();
+        return;
+    }
+    struct timespec pause = {0, 50000};
+    nanosleep(&pause, NULL);
+}
+
+// Blocking push, this is where back-pressure happens
+static void push(Ring *ring, size_t value)
+{
+    int attempts = 0;
+    while (!tryPush(ring, value))
+    {
+        backOff(&attempts);
+    }
+}
+
+static size_t pop(Ring *ring)
+{
+    size_t value;
+    int attempts = 0;
+    while (!tryPop(ring, &value))
+    {
+        backOff(&attempts);
+    }
+    return value;
+}
+
+// ************* Pipeline ***************
+
+// State of one file as it moves through the stages
+typedef struct
+{
+    char *data;
+    size_t length;
+    VCardErrorCode loadError;
+    PipelineResult result;
+    bool ready; // Only touched by the consumer
+} PipelineJob;
+
+typedef struct
+{
+    char *const *fileNames;
+    int count;
+    PipelineOptions options;
+    PipelineJob *jobs;
+
+    Ring parseQueue;  // Reader -> workers, values are job index + 1, 0 tells a worker to stop
+    Ring resultQueue; // Workers -> consumer, values are job index
+
+    // Back-pressure for the ordered mode: the reader stays at most window files ahead of the consumer,
+    // otherwise one slow file would let every later card pile up in memory
+    alignas(CACHE_LINE) atomic_int delivered;
+    int window;
+
+    VCStats *workerStats; // One per worker plus the reader's at the end
+} Pipeline;
+
+void initializePipelineOptions(PipelineOptions *options)
+{
+    if (options == NULL)
+    {
+        return;
+    }
+    options->workers = 0;
+    options->queueSize = DEFAULT_QUEUE_SIZE;
+    options->ordered = true;
+    options->validate = true;
+    options->projection = NULL;
+}
+
+static void *readerStage(void *argument)
+{
+    Pipeline *pipeline = argument;
+    int batchSize = pipeline->options.queueSize < 256 ? pipeline->options.queueSize : 256;
+    VCLoader *loader = createLoader(batchSize, true);
+    LoadedFile *files = vcMalloc(batchSize * sizeof(LoadedFile));
+    char **names = vcMalloc(batchSize * sizeof(char *));
+    int *positions = vcMalloc(batchSize * sizeof(int));
+    bool ready = loader != NULL && files != NULL && names != NULL && positions != NULL;
+
+    int i = 0;
+    while (i < pipeline->count)
+    {
+        // Collect a batch of loadable names, anything else is an error right away
+        int batch = 0;
+        for (; i < pipeline->count && batch < batchSize; i++)
+        {
+            PipelineJob *job = &pipeline->jobs[i];
+            if (pipeline->fileNames[i] == NULL || !hasCardExtension(pipeline->fileNames[i]))
+            {
+                job->loadError = INV_FILE;
+                push(&pipeline->parseQueue, (size_t)i + 1);
+            }
+            else if (!ready)
+            {
+                job->loadError = OTHER_ERROR;
+                push(&pipeline->parseQueue, (size_t)i + 1);
+            }
+            else
+            {
+                names[batch] = pipeline->fileNames[i];
+                positions[batch] = i;
+                batch++;
+            }
+        }
+        if (batch == 0)
+        {
+            continue;
+        }
+
+        if (pipeline->options.ordered)
+        {
+            int attempts = 0;
+            // Waiting on the first file of the batch: the later ones can't be delivered before it is pushed
+            while (positions[0] - atomic_load_explicit(&pipeline->delivered, memory_order_acquire) >= pipeline->window)
+            {
+                backOff(&attempts);
+            }
+        }
+
+        loadFiles(loader, names, batch, files);
+        for (int b = 0; b < batch; b++)
+        {
+            PipelineJob *job = &pipeline->jobs[positions[b]];
+            job->data = files[b].data;
+            job->length = files[b].length;
+            job->loadError = files[b].data != NULL ? OK : (files[b].error == ENOMEM ? OTHER_ERROR : INV_FILE);
+            push(&pipeline->parseQueue, (size_t)positions[b] + 1);
+        }
+    }
+
+    // One stop signal per worker
+    for (int w = 0; w < pipeline->options.workers; w++)
+    {
+        push(&pipeline->parseQueue, 0);
+    }
+
+    deleteLoader(loader);
+    vcFree(files);
+    vcFree(names);
+    vcFree(positions);
+    vcGetStats(&pipeline->workerStats[pipeline->options.workers]);
+    return NULL;
+}
+
+typedef struct
+{
+    Pipeline *pipeline;
+    int number;
+} WorkerArgument;
+
+static void *workerStage(void *argument)
+{
+    WorkerArgument *worker = argument;
+    Pipeline *pipeline = worker->pipeline;
+
+    for (;;)
+    {
+        size_t value = pop(&pipeline->parseQueue);
+        if (value == 0)
+        {
+            break;
+        }
+
+        int index = (int)(value - 1);
+        PipelineJob *job = &pipeline->jobs[index];
+        Card *card = NULL;
+        VCardErrorCode err = job->loadError;
+        if (err == OK)
+        {
+            // Frees the buffer or keeps it for blob values
+            err = parseCardBuffer(job->data, job->length, true, pipeline->options.projection, &card);
+            job->data = NULL;
+            if (err != OK)
+            {
+                card = NULL;
+            }
+        }
+        if (err == OK && pipeline->options.validate)
+        {
+            err = validateCard(card);
+            if (err != OK)
+            {
+                deleteCard(card);
+                card = NULL;
+            }
+        }
+
+        job->result.card = card;
+        job->result.error = err;
+        push(&pipeline->resultQueue, (size_t)index);
+    }
+
+    // The counters of this thread would be lost when it exits, the caller adds them to its own
+    vcGetStats(&pipeline->workerStats[worker->number]);
+    return NULL;
+}
+
+int runPipeline(char *const *fileNames, int count, const PipelineOptions *options, PipelineConsumer consumer, void *context)
+{
+    if (fileNames == NULL || consumer == NULL || count < 0)
+    {
+        return -1;
+    }
+
+    Pipeline *pipeline = vcCalloc(1, sizeof(Pipeline));
+    if (pipeline == NULL)
+    {
+        return -1;
+    }
+    if (options != NULL)
+    {
+        pipeline->options = *options;
+    }
+    else
+    {
+        initializePipelineOptions(&pipeline->options);
+    }
+    if (pipeline->options.workers <= 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        pipeline->options.workers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (pipeline->options.workers > MAX_WORKERS)
+    {
+        pipeline->options.workers = MAX_WORKERS;
+    }
+    if (pipeline->options.queueSize <= 0)
+    {
+        pipeline->options.queueSize = DEFAULT_QUEUE_SIZE;
+    }
+
+    int workers = pipeline->options.workers;
+    pipeline->fileNames = fileNames;
+    pipeline->count = count;
+    pipeline->window = 2 * pipeline->options.queueSize;
+    atomic_init(&pipeline->delivered, 0);
+    pipeline->jobs = vcCalloc(count > 0 ? count : 1, sizeof(PipelineJob));
+    pipeline->workerStats = vcCalloc(workers + 1, sizeof(VCStats));
+    WorkerArgument *arguments = vcMalloc(workers * sizeof(WorkerArgument));
+    pthread_t *threads = vcMalloc((workers + 1) * sizeof(pthread_t));
+
+    // The result queue can hold every file that is between the reader and the consumer,
+    // so workers never wait on it in the ordered mode
+    bool ready = pipeline->jobs != NULL && pipeline->workerStats != NULL && arguments != NULL && threads != NULL &&
+                 initializeRing(&pipeline->parseQueue, pipeline->options.queueSize);
+    if (ready && !initializeRing(&pipeline->resultQueue, pipeline->window + pipeline->options.queueSize))
+    {
+        vcFree(pipeline->parseQueue.cells);
+        ready = false;
+    }
+    if (!ready)
+    {
+        vcFree(pipeline->jobs);
+        vcFree(pipeline->workerStats);
+        vcFree(arguments);
+        vcFree(threads);
+        vcFree(pipeline);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        pipeline->jobs[i].result.fileName = fileNames[i];
+        pipeline->jobs[i].result.index = i;
+    }
+
+    // Workers first, the reader is only started once they can all take work
+    int started = 0;
+    for (; started < workers; started++)
+    {
+        arguments[started].pipeline = pipeline;
+        arguments[started].number = started;
+        if (pthread_create(&threads[started], NULL, workerStage, &arguments[started]) != 0)
+        {
+            break;
+        }
+    }
+    bool readerStarted = started == workers && pthread_create(&threads[workers], NULL, readerStage, pipeline) == 0;
+    if (!readerStarted)
+    {
+        for (int w = 0; w < started; w++)
+        {
+            push(&pipeline->parseQueue, 0);
+        }
+        for (int w = 0; w < started; w++)
+        {
+            pthread_join(threads[w], NULL);
+        }
+    }
+
+    int parsed = 0;
+    int next = 0; // Next index to deliver in the ordered mode
+    for (int received = 0; readerStarted && received < count; received++)
+    {
+        int index = (int)pop(&pipeline->resultQueue);
+        if (!pipeline->options.ordered)
+        {
+            parsed += pipeline->jobs[index].result.error == OK;
+            consumer(&pipeline->jobs[index].result, context);
+            atomic_store_explicit(&pipeline->delivered, received + 1, memory_order_release);
+            continue;
+        }
+
+        pipeline->jobs[index].ready = true;
+        while (next < count && pipeline->jobs[next].ready)
+        {
+            parsed += pipeline->jobs[next].result.error == OK;
+            consumer(&pipeline->jobs[next].result, context);
+            next++;
+        }
+        atomic_store_explicit(&pipeline->delivered, next, memory_order_release);
+    }
+
+    if (readerStarted)
+    {
+        for (int t = 0; t <= workers; t++)
+        {
+            pthread_join(threads[t], NULL);
+        }
+    }
+
+    for (int w = 0; w <= workers; w++)
+    {
+        addStats(&threadStats, &pipeline->workerStats[w]); // Threads that never ran left zeros
+    }
+
+    vcFree(pipeline->parseQueue.cells);
+    vcFree(pipeline->resultQueue.cells);
+    vcFree(pipeline->jobs);
+    vcFree(pipeline->workerStats);
+    vcFree(arguments);
+    vcFree(threads);
+    vcFree(pipeline);
+    return readerStarted ? parsed : -1;
+}
@@ -0,0 +1,108 @@
+#include "VCProjection.h"
+#include "VCHelpers.h"
+
+// One selected property name
+typedef struct
+{
+    const char *name;
+    size_t length;
+} ProjectedName;
+
+// The names and their strings in one allocation
+struct cardProjection
+{
+    int count;
+    ProjectedName names[];
+};
+
+static bool spanIs(const char *span, size_t length, const char *name)
+{
+    return strlen(name) == length && memcmp(span, name, length) == 0;
+}
+
+// Function to tell whether the line reader has to return a line or can skip it
+/*
+@param projection - the projection
+@param line - the first physical line of the logical line, without its CRLF
+@param length - its length
+@param legacy - the card is a vCard 2.1 or 3.0 card
+@return false if the line belongs to a property the projection leaves out
+*/
+bool projectionKeepsLine(const CardProjection *projection, const char *line, size_t length, bool legacy)
+{
+    // The name ends at the first ';' or ':', a line with neither is left to the parser to reject
+    size_t nameEnd = 0;
+    while (nameEnd < length && line[nameEnd] != ';' && line[nameEnd] != ':')
+    {
+        nameEnd++;
+    }
+    if (nameEnd == length)
+    {
+        return true;
+    }
+    const char *dot = memchr(line, '.', nameEnd);
+    const char *name = dot != NULL ? dot + 1 : line; // Without the group
+    size_t nameLength = line + nameEnd - name;
+
+    for (int i = 0; i < projection->count; i++)
+    {
+        if (projection->names[i].length == nameLength && memcmp(projection->names[i].name, name, nameLength) == 0)
+        {
+            return true;
+        }
+    }
+
+    // The lines every card is checked for, and N for a 2.1 card that may need an FN built from it
+    return spanIs(name, nameLength, "BEGIN") || spanIs(name, nameLength, "VERSION") ||
+           spanIs(name, nameLength, "END") || spanIs(name, nameLength, "FN") ||
+           (legacy && spanIs(name, nameLength, "N"));
+}
+
+CardProjection *createProjection(char *const *names, int count)
+{
+    if (names == NULL || count < 0)
+    {
+        return NULL;
+    }
+    size_t stringBytes = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (names[i] == NULL || names[i][0] == '\0')
+        {
+            return NULL;
+        }
+        stringBytes += strlen(names[i]) + 1;
+    }
+
+    CardProjection *projection = vcMalloc(sizeof(CardProjection) + count * sizeof(ProjectedName) + stringBytes);
+    if (projection == NULL)
+    {
+        return NULL;
+    }
+    projection->count = count;
+    char *strings = (char *)(projection->names + count);
+    for (int i = 0; i < count; i++)
+    {
+        size_t length = strlen(names[i]);
+        memcpy(strings, names[i], length + 1);
+        projection->names[i].name = strings;
+        projection->names[i].length = length;
+        strings += length + 1;
+    }
+    return projection;
+}
+
+void deleteProjection(CardProjection *projection)
+{
+    vcFree(projection);
+}
+
+VCardErrorCode createCardWithProjection(const char *fileName, const CardProjection *projection, Card **obj)
+{
+    return loadCard(fileName, obj, NULL, projection);
+}
+
+VCardErrorCode createCardFromBufferWithProjection(const char *data, size_t length, const CardProjection *projection, Card **obj)
+{
+    return parseCardBuffer(data, length, false, projection, obj);
+}
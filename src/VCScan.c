@@ -0,0 +1,376 @@
+#include "VCScan.h"
+#include "VCProjection.h"
+#include "VCHelpers.h"
+
+// A card is matched on the lines the line reader returns for the filter's projection, so it costs one
+// pass over the buffer that skips every other property without unfolding it. Each line is split into
+// name, parameters and value in place; the predicates that hold are kept in a bit mask, and reading
+// stops as soon as every one of them holds.
+
+#define MAX_PREDICATES 64
+
+typedef enum
+{
+    BIRTHDAY_MONTH,
+    EMAIL_DOMAIN,
+    HAS_PARAMETER
+} PredicateKind;
+
+// One predicate, the strings are owned by the filter
+typedef struct
+{
+    PredicateKind kind;
+    int month;       // BIRTHDAY_MONTH
+    char *property;  // The property the predicate looks at
+    char *parameter; // HAS_PARAMETER
+    char *value;     // The domain of EMAIL_DOMAIN, the parameter value of HAS_PARAMETER
+} CardPredicate;
+
+struct cardFilter
+{
+    int count;
+    CardPredicate predicates[MAX_PREDICATES];
+    CardProjection *projection; // The properties of the predicates, NULL while there are none
+};
+
+// A logical line split in place
+typedef struct
+{
+    const char *name;
+    size_t nameLength;
+    const char *parameters; // From the first ';' to the value colon, empty if there are none
+    size_t parametersLength;
+    const char *value;
+} LineTokens;
+
+// Compares a span of text with a string, ignoring ASCII case
+static bool spanEqualsIgnoringCase(const char *span, size_t length, const char *str)
+{
+    if (strlen(str) != length)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        char a = span[i] >= 'a' && span[i] <= 'z' ? span[i] - 'a' + 'A' : span[i];
+        char b = str[i] >= 'a' && str[i] <= 'z' ? str[i] - 'a' + 'A' : str[i];
+        if (a != b)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to split a logical line into its name, parameters and value
+/*
+@param line - the logical line, converted to 4.0 for a legacy card
+@param tokens - receives the spans
+@return false if the line has no value colon
+*/
+static bool splitLine(const char *line, LineTokens *tokens)
+{
+    size_t nameEnd = strcspn(line, ";:");
+    if (line[nameEnd] == '\0')
+    {
+        return false;
+    }
+    const char *dot = memchr(line, '.', nameEnd);
+    tokens->name = dot != NULL ? dot + 1 : line; // Without the group
+    tokens->nameLength = line + nameEnd - tokens->name;
+
+    // The value starts after the first ':' that is not in a quoted parameter value
+    bool quoted = false;
+    const char *c = line + nameEnd;
+    for (; *c != '\0' && (quoted || *c != ':'); c++)
+    {
+        if (*c == '"')
+        {
+            quoted = !quoted;
+        }
+    }
+    if (*c == '\0')
+    {
+        return false;
+    }
+    tokens->parameters = line + nameEnd;
+    tokens->parametersLength = c - tokens->parameters;
+    tokens->value = c + 1;
+    return true;
+}
+
+// Function to find a parameter and tell whether one of the items of its value is the one asked for
+/*
+@param tokens - the split line
+@param name - the parameter name, compared without case
+@param value - the item to look for, compared without case; NULL for any item
+@return true if the line has the parameter with that item
+*/
+static bool hasParameterValue(const LineTokens *tokens, const char *name, const char *value)
+{
+    const char *c = tokens->parameters;
+    const char *end = c + tokens->parametersLength;
+    while (c < end)
+    {
+        // c is on the ';' that starts a parameter
+        const char *parameterName = ++c;
+        while (c < end && *c != '=' && *c != ';')
+        {
+            c++;
+        }
+        bool wanted = c < end && *c == '=' && spanEqualsIgnoringCase(parameterName, c - parameterName, name);
+        if (c < end && *c == '=')
+        {
+            c++;
+        }
+
+        // Items are separated by ',', a quoted value is one list as well
+        bool quoted = false;
+        const char *item = c;
+        for (; c <= end; c++)
+        {
+            if (c < end && *c == '"')
+            {
+                quoted = !quoted;
+                continue;
+            }
+            if (c == end || (*c == ';' && !quoted) || *c == ',')
+            {
+                const char *itemStart = item;
+                const char *itemEnd = c;
+                if (itemStart < itemEnd && *itemStart == '"')
+                {
+                    itemStart++;
+                }
+                if (itemStart < itemEnd && itemEnd[-1] == '"')
+                {
+                    itemEnd--;
+                }
+                if (wanted && (value == NULL || spanEqualsIgnoringCase(itemStart, itemEnd - itemStart, value)))
+                {
+                    return true;
+                }
+                item = c + 1;
+                if (c == end || *c == ';')
+                {
+                    break;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Function to get the month of a date or date-time value
+/*
+@param value - the value, e.g. 19850612, 1985-06-12, --0612 or 19850612T102200Z
+@return the month, or 0 if the value has none
+*/
+static int valueMonth(const char *value)
+{
+    const char *month = NULL;
+    if (value[0] == '-' && value[1] == '-')
+    {
+        month = value + 2; // --MMDD or --MM
+    }
+    else if (value[0] >= '0' && value[0] <= '9' && strspn(value, "0123456789") >= 4)
+    {
+        month = value[4] == '-' ? value + 5 : value + 4; // YYYYMM... or YYYY-MM...
+    }
+    if (month == NULL || month[0] < '0' || month[0] > '1' || month[1] < '0' || month[1] > '9')
+    {
+        return 0;
+    }
+    int number = (month[0] - '0') * 10 + month[1] - '0';
+    return number >= 1 && number <= 12 ? number : 0;
+}
+
+// Function to tell whether an email address is in a domain
+static bool emailHasDomain(const char *value, const char *domain)
+{
+    const char *at = strrchr(value, '@');
+    return at != NULL && spanEqualsIgnoringCase(at + 1, strlen(at + 1), domain);
+}
+
+// Function to tell whether a predicate holds for one line of a card
+static bool predicateHolds(const CardPredicate *predicate, const LineTokens *tokens)
+{
+    if (strlen(predicate->property) != tokens->nameLength ||
+        memcmp(predicate->property, tokens->name, tokens->nameLength) != 0)
+    {
+        return false;
+    }
+    switch (predicate->kind)
+    {
+    case BIRTHDAY_MONTH:
+        return !hasParameterValue(tokens, "VALUE", "text") && valueMonth(tokens->value) == predicate->month;
+    case EMAIL_DOMAIN:
+        return emailHasDomain(tokens->value, predicate->value);
+    case HAS_PARAMETER:
+        return hasParameterValue(tokens, predicate->parameter, predicate->value);
+    }
+    return false;
+}
+
+// Function to add a predicate and read its property from then on
+/*
+@param filter - the filter
+@param predicate - the predicate, its strings are taken over by the filter
+@return false if the filter is full or the allocation failed, the strings are freed then
+*/
+static bool addPredicate(CardFilter *filter, CardPredicate predicate)
+{
+    if (filter->count == MAX_PREDICATES || predicate.property == NULL ||
+        (predicate.kind != BIRTHDAY_MONTH && predicate.value == NULL) ||
+        (predicate.kind == HAS_PARAMETER && predicate.parameter == NULL))
+    {
+        vcFree(predicate.property);
+        vcFree(predicate.parameter);
+        vcFree(predicate.value);
+        return false;
+    }
+
+    char *names[MAX_PREDICATES];
+    for (int i = 0; i < filter->count; i++)
+    {
+        names[i] = filter->predicates[i].property;
+    }
+    names[filter->count] = predicate.property;
+    CardProjection *projection = createProjection(names, filter->count + 1);
+    if (projection == NULL)
+    {
+        vcFree(predicate.property);
+        vcFree(predicate.parameter);
+        vcFree(predicate.value);
+        return false;
+    }
+    deleteProjection(filter->projection);
+    filter->projection = projection;
+    filter->predicates[filter->count++] = predicate;
+    return true;
+}
+
+CardFilter *createCardFilter(void)
+{
+    return vcCalloc(1, sizeof(CardFilter));
+}
+
+void deleteCardFilter(CardFilter *filter)
+{
+    if (filter == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < filter->count; i++)
+    {
+        vcFree(filter->predicates[i].property);
+        vcFree(filter->predicates[i].parameter);
+        vcFree(filter->predicates[i].value);
+    }
+    deleteProjection(filter->projection);
+    vcFree(filter);
+}
+
+bool addBirthdayMonthFilter(CardFilter *filter, int month)
+{
+    if (filter == NULL || month < 1 || month > 12)
+    {
+        return false;
+    }
+    CardPredicate predicate = {.kind = BIRTHDAY_MONTH, .month = month, .property = copyString("BDAY")};
+    return addPredicate(filter, predicate);
+}
+
+bool addEmailDomainFilter(CardFilter *filter, const char *domain)
+{
+    if (filter == NULL || domain == NULL || domain[0] == '\0')
+    {
+        return false;
+    }
+    CardPredicate predicate = {.kind = EMAIL_DOMAIN, .property = copyString("EMAIL"), .value = copyString(domain)};
+    return addPredicate(filter, predicate);
+}
+
+bool addParameterFilter(CardFilter *filter, const char *property, const char *parameter, const char *value)
+{
+    if (filter == NULL || property == NULL || property[0] == '\0' || parameter == NULL || parameter[0] == '\0' ||
+        value == NULL || value[0] == '\0')
+    {
+        return false;
+    }
+    CardPredicate predicate = {.kind = HAS_PARAMETER,
+                               .property = copyString(property),
+                               .parameter = copyString(parameter),
+                               .value = copyString(value)};
+    return addPredicate(filter, predicate);
+}
+
+bool cardMatchesFilter(const char *data, size_t length, const CardFilter *filter)
+{
+    if (filter == NULL || filter->count == 0)
+    {
+        return true;
+    }
+    if (data == NULL)
+    {
+        return false;
+    }
+
+    LineReader reader;
+    initializeLineReader(&reader, data, length);
+    reader.projection = filter->projection;
+
+    unsigned long long all = filter->count == MAX_PREDICATES ? ~0ULL : (1ULL << filter->count) - 1;
+    unsigned long long holding = 0;
+    VCardErrorCode error = OK;
+    char *line;
+    while (holding != all && (line = readAndCombineLines(&reader, &error)) != NULL)
+    {
+        // The same version handling as the parser, so legacy lines are matched as the 4.0 lines they stand for
+        if (strcmp(line, "VERSION:3.0") == 0 || strcmp(line, "VERSION:2.1") == 0)
+        {
+            reader.legacy = true;
+            vcFree(line);
+            continue;
+        }
+        if (reader.legacy && strcmp(line, "BEGIN:VCARD") != 0 && strcmp(line, "END:VCARD") != 0)
+        {
+            char *converted = convertLegacyLine(line, &error);
+            vcFree(line);
+            if (converted == NULL)
+            {
+                break;
+            }
+            line = converted;
+        }
+
+        LineTokens tokens;
+        if (splitLine(line, &tokens))
+        {
+            for (int i = 0; i < filter->count; i++)
+            {
+                if (!(holding & 1ULL << i) && predicateHolds(&filter->predicates[i], &tokens))
+                {
+                    holding |= 1ULL << i;
+                }
+            }
+        }
+        vcFree(line);
+    }
+    finishLineReader(&reader);
+    return holding == all && error == OK;
+}
+
+VCardErrorCode scanCardBuffer(const char *data, size_t length, const CardFilter *filter, Card **obj)
+{
+    if (data == NULL || obj == NULL)
+    {
+        return INV_FILE; // Invalid input, like createCardFromBuffer
+    }
+    *obj = NULL;
+    if (!cardMatchesFilter(data, length, filter))
+    {
+        return OK;
+    }
+    return parseCardBuffer(data, length, false, NULL, obj);
+}
@@ -0,0 +1,333 @@
+#include <stdatomic.h>
+#include "VCShared.h"
+#include "VCHelpers.h"
+
+// One part of a card (a Property or a DateTime) that can be used by several versions
+typedef struct
+{
+    atomic_int references;
+    void *data;
+    void (*deleteData)(void *data);
+} SharedBox;
+
+struct sharedCard
+{
+    atomic_int references;
+
+    // What readers see. The list holds the same Property pointers as the boxes and never frees them.
+    Card view;
+
+    SharedBox *fn;
+    SharedBox *birthday;    // NULL when the card has no birthday
+    SharedBox *anniversary; // NULL when the card has no anniversary
+    SharedBox **properties; // Same order as view.optionalProperties
+    int propertyCount;
+};
+
+// List delete function for the views: the boxes own the properties
+static void keepData(void *data)
+{
+    (void)data;
+}
+
+static SharedBox *createBox(void *data, void (*deleteData)(void *data))
+{
+    SharedBox *box = vcMalloc(sizeof(SharedBox));
+    if (box == NULL)
+    {
+        return NULL;
+    }
+    atomic_init(&box->references, 1);
+    box->data = data;
+    box->deleteData = deleteData;
+    return box;
+}
+
+static SharedBox *retainBox(SharedBox *box)
+{
+    if (box != NULL)
+    {
+        atomic_fetch_add_explicit(&box->references, 1, memory_order_relaxed);
+    }
+    return box;
+}
+
+static void releaseBox(SharedBox *box)
+{
+    if (box == NULL)
+    {
+        return;
+    }
+    if (atomic_fetch_sub_explicit(&box->references, 1, memory_order_acq_rel) == 1)
+    {
+        box->deleteData(box->data);
+        vcFree(box);
+    }
+}
+
+// Frees a version whose reference count reached 0, or one that was never finished
+static void destroySharedCard(SharedCard *card)
+{
+    releaseBox(card->fn);
+    releaseBox(card->birthday);
+    releaseBox(card->anniversary);
+    for (int i = 0; i < card->propertyCount; i++)
+    {
+        releaseBox(card->properties[i]);
+    }
+    if (card->view.optionalProperties != NULL)
+    {
+        freeList(card->view.optionalProperties);
+    }
+    vcFree(card->properties);
+    vcFree(card);
+}
+
+SharedCard *shareCard(Card *card)
+{
+    if (card == NULL || card->fn == NULL || card->optionalProperties == NULL)
+    {
+        return NULL;
+    }
+
+    SharedCard *shared = vcCalloc(1, sizeof(SharedCard));
+    int count = getLength(card->optionalProperties);
+    SharedBox **properties = vcCalloc(count > 0 ? count : 1, sizeof(SharedBox *));
+    SharedBox *fn = createBox(card->fn, deleteProperty);
+    SharedBox *birthday = card->birthday != NULL ? createBox(card->birthday, deleteDate) : NULL;
+    SharedBox *anniversary = card->anniversary != NULL ? createBox(card->anniversary, deleteDate) : NULL;
+    bool ok = shared != NULL && properties != NULL && fn != NULL &&
+              (card->birthday == NULL || birthday != NULL) && (card->anniversary == NULL || anniversary != NULL);
+
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *property;
+    for (int i = 0; ok && (property = nextElement(&iter)) != NULL; i++)
+    {
+        properties[i] = createBox(property, deleteProperty);
+        ok = properties[i] != NULL;
+    }
+
+    if (!ok)
+    {
+        // Only the boxes are freed, the card itself is left to the caller
+        for (int i = 0; properties != NULL && i < count; i++)
+        {
+            vcFree(properties[i]);
+        }
+        vcFree(properties);
+        vcFree(fn);
+        vcFree(birthday);
+        vcFree(anniversary);
+        vcFree(shared);
+        return NULL;
+    }
+
+    atomic_init(&shared->references, 1);
+    shared->fn = fn;
+    shared->birthday = birthday;
+    shared->anniversary = anniversary;
+    shared->properties = properties;
+    shared->propertyCount = count;
+
+    // The card's own list becomes the view of the first version, it just stops deleting its elements
+    shared->view = *card;
+    shared->view.optionalProperties->deleteData = keepData;
+    vcFree(card);
+    return shared;
+}
+
+SharedCard *retainSharedCard(SharedCard *card)
+{
+    if (card != NULL)
+    {
+        atomic_fetch_add_explicit(&card->references, 1, memory_order_relaxed);
+    }
+    return card;
+}
+
+void releaseSharedCard(SharedCard *card)
+{
+    if (card == NULL)
+    {
+        return;
+    }
+    if (atomic_fetch_sub_explicit(&card->references, 1, memory_order_acq_rel) == 1)
+    {
+        destroySharedCard(card);
+    }
+}
+
+const Card *sharedCardView(const SharedCard *card)
+{
+    return card != NULL ? &card->view : NULL;
+}
+
+int sharedCardReferences(const SharedCard *card)
+{
+    return card != NULL ? atomic_load_explicit(&((SharedCard *)card)->references, memory_order_relaxed) : 0;
+}
+
+// Starts a new version that shares every part of card. The caller then swaps the part that changes.
+static SharedCard *copyVersion(const SharedCard *card)
+{
+    SharedCard *copy = vcCalloc(1, sizeof(SharedCard));
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    atomic_init(&copy->references, 1);
+    copy->properties = vcCalloc(card->propertyCount > 0 ? card->propertyCount : 1, sizeof(SharedBox *));
+    copy->view.optionalProperties = initializeList(&propertyToString, &keepData, &compareProperties);
+    if (copy->properties == NULL || copy->view.optionalProperties == NULL)
+    {
+        destroySharedCard(copy);
+        return NULL;
+    }
+
+    copy->fn = retainBox(card->fn);
+    copy->birthday = retainBox(card->birthday);
+    copy->anniversary = retainBox(card->anniversary);
+    copy->view.fn = card->view.fn;
+    copy->view.birthday = card->view.birthday;
+    copy->view.anniversary = card->view.anniversary;
+    for (int i = 0; i < card->propertyCount; i++)
+    {
+        copy->properties[i] = retainBox(card->properties[i]);
+        copy->propertyCount++;
+        insertBack(copy->view.optionalProperties, card->properties[i]->data);
+    }
+    return copy;
+}
+
+// A new FN property with the group and parameters of the old one and a single value
+static Property *createFN(const Property *old, const char *value)
+{
+    Property *fn = createProperty("FN", old->group);
+    if (fn == NULL)
+    {
+        return NULL;
+    }
+
+    ListIterator iter = createIterator(old->parameters);
+    Parameter *parameter;
+    while ((parameter = nextElement(&iter)) != NULL)
+    {
+        Parameter *copy = copyParameter(parameter);
+        if (copy == NULL)
+        {
+            deleteProperty(fn);
+            return NULL;
+        }
+        insertBack(fn->parameters, copy);
+    }
+
+    char *copy = copyString(value);
+    if (copy == NULL)
+    {
+        deleteProperty(fn);
+        return NULL;
+    }
+    insertBack(fn->values, copy);
+    return fn;
+}
+
+// A text DateTime, the same shape updateBirthday and updateAnniversary produce
+static DateTime *createTextDate(const char *text)
+{
+    DateTime *dateTime = vcMalloc(sizeof(DateTime));
+    if (dateTime == NULL)
+    {
+        return NULL;
+    }
+    dateTime->UTC = false;
+    dateTime->isText = true;
+    dateTime->date = vcCalloc(9, sizeof(char));
+    dateTime->time = vcCalloc(7, sizeof(char));
+    dateTime->text = copyString(text);
+    if (dateTime->date == NULL || dateTime->time == NULL || dateTime->text == NULL)
+    {
+        deleteDate(dateTime);
+        return NULL;
+    }
+    return dateTime;
+}
+
+VCardErrorCode updateSharedFN(const SharedCard *card, const char *newFN, SharedCard **updated)
+{
+    if (card == NULL || newFN == NULL || strlen(newFN) == 0 || updated == NULL)
+    {
+        return INV_PROP;
+    }
+
+    Property *fn = createFN(card->view.fn, newFN);
+    SharedBox *box = fn != NULL ? createBox(fn, deleteProperty) : NULL;
+    SharedCard *copy = box != NULL ? copyVersion(card) : NULL;
+    if (copy == NULL)
+    {
+        if (box != NULL)
+        {
+            releaseBox(box);
+        }
+        else if (fn != NULL)
+        {
+            deleteProperty(fn);
+        }
+        return OTHER_ERROR;
+    }
+
+    releaseBox(copy->fn);
+    copy->fn = box;
+    copy->view.fn = fn;
+    *updated = copy;
+    return OK;
+}
+
+// Shared part of updateSharedBirthday and updateSharedAnniversary
+static VCardErrorCode updateSharedDate(const SharedCard *card, const char *text, bool birthday, SharedCard **updated)
+{
+    if (card == NULL || text == NULL || updated == NULL)
+    {
+        return INV_PROP;
+    }
+
+    DateTime *dateTime = createTextDate(text);
+    SharedBox *box = dateTime != NULL ? createBox(dateTime, deleteDate) : NULL;
+    SharedCard *copy = box != NULL ? copyVersion(card) : NULL;
+    if (copy == NULL)
+    {
+        if (box != NULL)
+        {
+            releaseBox(box);
+        }
+        else if (dateTime != NULL)
+        {
+            deleteDate(dateTime);
+        }
+        return OTHER_ERROR;
+    }
+
+    if (birthday)
+    {
+        releaseBox(copy->birthday);
+        copy->birthday = box;
+        copy->view.birthday = dateTime;
+    }
+    else
+    {
+        releaseBox(copy->anniversary);
+        copy->anniversary = box;
+        copy->view.anniversary = dateTime;
+    }
+    *updated = copy;
+    return OK;
+}
+
+VCardErrorCode updateSharedBirthday(const SharedCard *card, const char *newBirthday, SharedCard **updated)
+{
+    return updateSharedDate(card, newBirthday, true, updated);
+}
+
+VCardErrorCode updateSharedAnniversary(const SharedCard *card, const char *newAnniv, SharedCard **updated)
+{
+    return updateSharedDate(card, newAnniv, false, updated);
+}
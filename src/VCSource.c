@@ -0,0 +1,605 @@
+#define _POSIX_C_SOURCE 200809L // pread, pwrite, ftruncate, st_mtim
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "VCSource.h"
+#include "VCHelpers.h"
+
+// Where one part of the card is in the file
+typedef struct
+{
+    const void *part; // The FN property, a DateTime or an optional property
+    size_t start;
+    size_t end;    // Just past the CRLF of the part's last physical line
+    uint64_t hash; // Of the line writeCard would write for the part, to see whether it changed
+} SourceSpan;
+
+struct cardSource
+{
+    char *fileName;
+    off_t size; // Size and modification time of the file when the spans were recorded
+    struct timespec modified;
+    SourceSpan *spans; // In file order
+    int count;
+    int capacity;
+    bool broken; // A span could not be recorded, the next write rewrites the whole card
+};
+
+// One part of a card as the serializer writes it
+typedef struct
+{
+    const void *part;
+    size_t offset; // In the serialized card
+    size_t length;
+    uint64_t hash;
+} CardPart;
+
+// A change to the file: replace removeLength bytes at offset with length bytes of text
+typedef struct
+{
+    size_t offset;
+    size_t removeLength;
+    const char *text;
+    size_t length;
+    int part;         // Index of the part the text belongs to, -1 for a removal
+    size_t newOffset; // Where the text ends up in the new file
+} FileEdit;
+
+// FNV-1a, only used to compare a part with itself
+static uint64_t hashBytes(const char *data, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void recordSourceSpan(CardSource *source, const void *part, const LineReader *reader)
+{
+    if (source->broken)
+    {
+        return;
+    }
+    if (source->count == source->capacity)
+    {
+        int capacity = source->capacity == 0 ? 16 : source->capacity * 2;
+        SourceSpan *spans = vcRealloc(source->spans, capacity * sizeof(SourceSpan));
+        if (spans == NULL)
+        {
+            source->broken = true;
+            return;
+        }
+        source->spans = spans;
+        source->capacity = capacity;
+    }
+
+    SourceSpan *span = &source->spans[source->count++];
+    span->part = part;
+    span->start = reader->lineOffset;
+    span->end = reader->position;
+    span->hash = 0;
+}
+
+void markSourceBroken(CardSource *source)
+{
+    source->broken = true;
+}
+
+// Serializes the card the same way as writeCard and notes where each part's line is.
+// parts needs room for 3 + the number of optional properties.
+static bool serializeCard(const Card *obj, StringBuilder *sb, CardPart *parts, int *count)
+{
+    bool ok = appendString(sb, "BEGIN:VCARD\r\n") && appendString(sb, "VERSION:4.0\r\n");
+    *count = 0;
+
+    for (int i = 0; ok && i < 3; i++)
+    {
+        const void *part = i == 0 ? (const void *)obj->fn : i == 1 ? (const void *)obj->birthday : (const void *)obj->anniversary;
+        if (part == NULL)
+        {
+            continue;
+        }
+        size_t offset = sb->length;
+        if (i == 0)
+        {
+            ok = appendProperty(sb, obj->fn);
+        }
+        else
+        {
+            ok = appendString(sb, i == 1 ? "BDAY" : "ANNIVERSARY") && appendDateTime(sb, part);
+        }
+        ok = ok && endLine(sb, offset);
+        parts[(*count)++] = (CardPart){part, offset, sb->length - offset, 0};
+    }
+
+    for (Node *node = obj->optionalProperties->head; ok && node != NULL; node = node->next)
+    {
+        size_t offset = sb->length;
+        ok = appendProperty(sb, node->data) && endLine(sb, offset);
+        parts[(*count)++] = (CardPart){node->data, offset, sb->length - offset, 0};
+    }
+
+    ok = ok && appendString(sb, "END:VCARD\r\n");
+    for (int i = 0; ok && i < *count; i++)
+    {
+        parts[i].hash = hashBytes(sb->data + parts[i].offset, parts[i].length);
+    }
+    return ok;
+}
+
+static int compareSpanParts(const void *first, const void *second)
+{
+    uintptr_t partA = (uintptr_t)(*(const SourceSpan *const *)first)->part;
+    uintptr_t partB = (uintptr_t)(*(const SourceSpan *const *)second)->part;
+    return partA < partB ? -1 : partA > partB;
+}
+
+// Finds the recorded span of every part, NULL for parts that are new. Returns false if a part
+// has two spans (e.g. a card with two FN lines) or an allocation failed.
+static bool matchParts(const CardSource *source, const CardPart *parts, int count, SourceSpan **matches)
+{
+    SourceSpan **sorted = vcMalloc((source->count > 0 ? source->count : 1) * sizeof(SourceSpan *));
+    if (sorted == NULL)
+    {
+        return false;
+    }
+    for (int i = 0; i < source->count; i++)
+    {
+        sorted[i] = &source->spans[i];
+    }
+    qsort(sorted, source->count, sizeof(SourceSpan *), compareSpanParts);
+
+    bool ok = true;
+    for (int i = 1; ok && i < source->count; i++)
+    {
+        ok = sorted[i - 1]->part != sorted[i]->part;
+    }
+    for (int i = 0; ok && i < count; i++)
+    {
+        SourceSpan key = {.part = parts[i].part};
+        SourceSpan *keyPointer = &key;
+        SourceSpan **found = bsearch(&keyPointer, sorted, source->count, sizeof(SourceSpan *), compareSpanParts);
+        matches[i] = found != NULL ? *found : NULL;
+    }
+    vcFree(sorted);
+    return ok;
+}
+
+// Records the size and modification time of the file the spans describe
+static bool statSource(CardSource *source, int fd)
+{
+    struct stat info;
+    if ((fd >= 0 ? fstat(fd, &info) : stat(source->fileName, &info)) != 0)
+    {
+        return false;
+    }
+    source->size = info.st_size;
+    source->modified = info.st_mtim;
+    return true;
+}
+
+static bool sourceIsCurrent(const CardSource *source)
+{
+    struct stat info;
+    return stat(source->fileName, &info) == 0 && info.st_size == source->size &&
+           info.st_mtim.tv_sec == source->modified.tv_sec && info.st_mtim.tv_nsec == source->modified.tv_nsec;
+}
+
+VCardErrorCode createCardWithSource(const char *fileName, Card **obj, CardSource **source)
+{
+    if (fileName == NULL || obj == NULL || source == NULL)
+    {
+        return INV_FILE;
+    }
+
+    CardSource *recorded = vcCalloc(1, sizeof(CardSource));
+    if (recorded == NULL)
+    {
+        return OTHER_ERROR;
+    }
+    recorded->fileName = copyString(fileName);
+    if (recorded->fileName == NULL)
+    {
+        vcFree(recorded);
+        return OTHER_ERROR;
+    }
+
+    // The file is checked before it is read, so a change while it is being read is seen by the next write
+    recorded->broken = !statSource(recorded, -1);
+    VCardErrorCode err = loadCard(fileName, obj, recorded, NULL);
+    if (err != OK)
+    {
+        deleteCardSource(recorded);
+        *source = NULL;
+        return err;
+    }
+
+    // Hash every part the way it would be written now, later writes compare against that
+    StringBuilder sb;
+    int partCount = 0;
+    CardPart *parts = vcMalloc((3 + getLength((*obj)->optionalProperties)) * sizeof(CardPart));
+    SourceSpan **matches = vcMalloc((3 + getLength((*obj)->optionalProperties)) * sizeof(SourceSpan *));
+    if (parts == NULL || matches == NULL || !initializeStringBuilder(&sb, 512))
+    {
+        recorded->broken = true;
+    }
+    else
+    {
+        if (!serializeCard(*obj, &sb, parts, &partCount) || !matchParts(recorded, parts, partCount, matches))
+        {
+            recorded->broken = true;
+        }
+        for (int i = 0; !recorded->broken && i < partCount; i++)
+        {
+            if (matches[i] != NULL)
+            {
+                matches[i]->hash = parts[i].hash;
+            }
+        }
+        freeStringBuilder(&sb);
+    }
+    vcFree(parts);
+    vcFree(matches);
+
+    *source = recorded;
+    return OK;
+}
+
+void deleteCardSource(CardSource *source)
+{
+    if (source == NULL)
+    {
+        return;
+    }
+    vcFree(source->fileName);
+    vcFree(source->spans);
+    vcFree(source);
+}
+
+// How far an edit moved the bytes that were at start: the size change of every edit in front of it.
+// The edits are sorted, and an insertion at start belongs to the part in front of it, so they count as well.
+static long long shiftOf(const FileEdit *edits, int editCount, size_t start)
+{
+    long long delta = 0;
+    for (int i = 0; i < editCount; i++)
+    {
+        if (edits[i].offset > start || (edits[i].offset == start && edits[i].removeLength != 0))
+        {
+            break;
+        }
+        delta += (long long)edits[i].length - (long long)edits[i].removeLength;
+    }
+    return delta;
+}
+
+static int compareSpanStarts(const void *first, const void *second)
+{
+    size_t startA = ((const SourceSpan *)first)->start;
+    size_t startB = ((const SourceSpan *)second)->start;
+    return startA < startB ? -1 : startA > startB;
+}
+
+// Replaces the spans with the parts of a card that was just written
+static bool setSpans(CardSource *source, const CardPart *parts, int count, const FileEdit *edits, int editCount,
+                     SourceSpan *const *matches)
+{
+    SourceSpan *spans = vcMalloc((count > 0 ? count : 1) * sizeof(SourceSpan));
+    if (spans == NULL)
+    {
+        return false;
+    }
+
+    // Without edits the whole card was written and the parts are where the serializer put them.
+    // Otherwise an edited part is where its edit put it, and an unchanged part moved by the size
+    // change of all the edits in front of it in the file.
+    int *editOfPart = NULL;
+    if (edits != NULL)
+    {
+        editOfPart = vcMalloc((count > 0 ? count : 1) * sizeof(int));
+        if (editOfPart == NULL)
+        {
+            vcFree(spans);
+            return false;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            editOfPart[i] = -1;
+        }
+        for (int i = 0; i < editCount; i++)
+        {
+            if (edits[i].part >= 0)
+            {
+                editOfPart[edits[i].part] = i;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        spans[i].part = parts[i].part;
+        spans[i].hash = parts[i].hash;
+        spans[i].end = parts[i].length; // Length for now, the unchanged parts keep their own
+        if (edits == NULL)
+        {
+            spans[i].start = parts[i].offset;
+        }
+        else if (editOfPart[i] >= 0)
+        {
+            spans[i].start = edits[editOfPart[i]].newOffset;
+        }
+        else
+        {
+            const SourceSpan *old = matches[i];
+            spans[i].start = old->start + shiftOf(edits, editCount, old->start);
+            spans[i].end = old->end - old->start;
+        }
+        spans[i].end += spans[i].start;
+    }
+    // The card's order need not be the file's (e.g. N in front of FN), the spans are kept in file order
+    qsort(spans, count, sizeof(SourceSpan), compareSpanStarts);
+
+    vcFree(editOfPart);
+    vcFree(source->spans);
+    source->spans = spans;
+    source->count = count;
+    source->capacity = count;
+    return true;
+}
+
+// Writes the whole serialized card, like writeCard, and records where the parts are
+static VCardErrorCode writeWholeCard(const char *fileName, const StringBuilder *sb, const CardPart *parts, int count,
+                                     CardSource *source)
+{
+    bool renamed = strcmp(fileName, source->fileName) != 0;
+    char *name = renamed ? copyString(fileName) : NULL;
+    if (renamed && name == NULL)
+    {
+        return OTHER_ERROR;
+    }
+
+    int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+    {
+        vcFree(name);
+        return WRITE_ERROR;
+    }
+    size_t written = 0;
+    while (written < sb->length)
+    {
+        ssize_t result = write(fd, sb->data + written, sb->length - written);
+        if (result <= 0)
+        {
+            break;
+        }
+        written += result;
+    }
+
+    if (name != NULL)
+    {
+        vcFree(source->fileName);
+        source->fileName = name;
+    }
+    source->broken = written != sb->length || !statSource(source, fd) || !setSpans(source, parts, count, NULL, 0, NULL);
+    if (close(fd) != 0 || written != sb->length)
+    {
+        return WRITE_ERROR;
+    }
+    return OK;
+}
+
+static int compareEdits(const void *first, const void *second)
+{
+    const FileEdit *editA = first;
+    const FileEdit *editB = second;
+    if (editA->offset != editB->offset)
+    {
+        return editA->offset < editB->offset ? -1 : 1;
+    }
+    // At the same offset an insertion belongs to the part in front of what starts there
+    bool insertA = editA->removeLength == 0;
+    bool insertB = editB->removeLength == 0;
+    if (insertA != insertB)
+    {
+        return insertA ? -1 : 1;
+    }
+    return editA->part < editB->part ? -1 : editA->part > editB->part;
+}
+
+// Writes the edits to the file. Same-length edits are written in place; otherwise the file is
+// rewritten from the first edit on, the bytes in front of it are never touched.
+static VCardErrorCode applyEdits(CardSource *source, FileEdit *edits, int editCount)
+{
+    bool sameLength = true;
+    for (int i = 0; i < editCount; i++)
+    {
+        sameLength = sameLength && edits[i].length == edits[i].removeLength;
+    }
+
+    int fd = open(source->fileName, O_RDWR);
+    if (fd < 0)
+    {
+        return WRITE_ERROR;
+    }
+
+    VCardErrorCode err = OK;
+    long long delta = 0;
+    if (sameLength)
+    {
+        for (int i = 0; err == OK && i < editCount; i++)
+        {
+            edits[i].newOffset = edits[i].offset;
+            if (pwrite(fd, edits[i].text, edits[i].length, edits[i].offset) != (ssize_t)edits[i].length)
+            {
+                err = WRITE_ERROR;
+            }
+        }
+    }
+    else
+    {
+        size_t first = edits[0].offset;
+        size_t tailLength = source->size - first;
+        char *tail = vcMalloc(tailLength > 0 ? tailLength : 1);
+        StringBuilder sb;
+        if (tail == NULL || !initializeStringBuilder(&sb, tailLength + 64))
+        {
+            vcFree(tail);
+            close(fd);
+            return OTHER_ERROR;
+        }
+
+        size_t done = 0;
+        while (done < tailLength)
+        {
+            ssize_t result = pread(fd, tail + done, tailLength - done, first + done);
+            if (result <= 0)
+            {
+                break;
+            }
+            done += result;
+        }
+
+        bool ok = done == tailLength;
+        size_t position = first;
+        for (int i = 0; ok && i < editCount; i++)
+        {
+            ok = appendChars(&sb, tail + (position - first), edits[i].offset - position);
+            edits[i].newOffset = edits[i].offset + delta;
+            ok = ok && appendChars(&sb, edits[i].text, edits[i].length);
+            delta += (long long)edits[i].length - (long long)edits[i].removeLength;
+            position = edits[i].offset + edits[i].removeLength;
+        }
+        ok = ok && appendChars(&sb, tail + (position - first), source->size - position);
+        vcFree(tail);
+
+        if (!ok)
+        {
+            err = done == tailLength ? OTHER_ERROR : WRITE_ERROR;
+        }
+        else if (pwrite(fd, sb.data, sb.length, first) != (ssize_t)sb.length || ftruncate(fd, first + sb.length) != 0)
+        {
+            err = WRITE_ERROR;
+        }
+        freeStringBuilder(&sb);
+    }
+
+    if (err == OK && !statSource(source, fd))
+    {
+        source->broken = true;
+    }
+    if (close(fd) != 0 && err == OK)
+    {
+        err = WRITE_ERROR;
+    }
+    return err;
+}
+
+static VCardErrorCode writeSource(const char *fileName, const Card *obj, CardSource *source)
+{
+    int maxParts = 3 + getLength(obj->optionalProperties);
+    StringBuilder sb;
+    CardPart *parts = vcMalloc(maxParts * sizeof(CardPart));
+    SourceSpan **matches = vcMalloc(maxParts * sizeof(SourceSpan *));
+    FileEdit *edits = vcMalloc((maxParts + source->count) * sizeof(FileEdit));
+    bool *used = vcCalloc(source->count > 0 ? source->count : 1, sizeof(bool));
+    int partCount = 0;
+    int editCount = 0;
+    VCardErrorCode err = OK;
+
+    if (parts == NULL || matches == NULL || edits == NULL || used == NULL || !initializeStringBuilder(&sb, 512))
+    {
+        vcFree(parts);
+        vcFree(matches);
+        vcFree(edits);
+        vcFree(used);
+        return OTHER_ERROR;
+    }
+    if (!serializeCard(obj, &sb, parts, &partCount))
+    {
+        err = OTHER_ERROR;
+        goto cleanup;
+    }
+
+    // The spans can be used if they describe this file as it is now. The parts need not be in the order
+    // writeCard puts them in (FN, BDAY, ANNIVERSARY, then the rest): each one is matched to its own span.
+    bool whole = source->broken || source->count == 0 || strcmp(fileName, source->fileName) != 0 ||
+                 !matchParts(source, parts, partCount, matches) || !sourceIsCurrent(source);
+    for (int i = 0; !whole && i < partCount; i++)
+    {
+        if (matches[i] != NULL)
+        {
+            used[matches[i] - source->spans] = true;
+        }
+    }
+    if (whole)
+    {
+        err = writeWholeCard(fileName, &sb, parts, partCount, source);
+        goto cleanup;
+    }
+
+    // A changed part replaces its own bytes wherever it is in the file, a new one goes right after the span
+    // of the part in front of it in the card (in front of the first span if there is none), and the spans
+    // of parts that are gone are cut out
+    size_t insertAt = source->spans[0].start;
+    for (int i = 0; i < partCount; i++)
+    {
+        const SourceSpan *span = matches[i];
+        if (span == NULL || span->hash != parts[i].hash)
+        {
+            edits[editCount++] = (FileEdit){span != NULL ? span->start : insertAt, span != NULL ? span->end - span->start : 0,
+                                            sb.data + parts[i].offset, parts[i].length, i, 0};
+        }
+        if (span != NULL)
+        {
+            insertAt = span->end;
+        }
+    }
+    for (int i = 0; i < source->count; i++)
+    {
+        if (!used[i])
+        {
+            edits[editCount++] = (FileEdit){source->spans[i].start, source->spans[i].end - source->spans[i].start, NULL, 0, -1, 0};
+        }
+    }
+
+    if (editCount > 0)
+    {
+        qsort(edits, editCount, sizeof(FileEdit), compareEdits);
+        // After a failed write the file may be half updated, so the next write starts over
+        err = applyEdits(source, edits, editCount);
+        if (err != OK || !setSpans(source, parts, partCount, edits, editCount, matches))
+        {
+            source->broken = true;
+        }
+    }
+
+cleanup:
+    freeStringBuilder(&sb);
+    vcFree(parts);
+    vcFree(matches);
+    vcFree(edits);
+    vcFree(used);
+    return err;
+}
+
+VCardErrorCode writeCardIncremental(const char *fileName, const Card *obj, CardSource *source)
+{
+    if (source == NULL)
+    {
+        return writeCard(fileName, obj);
+    }
+    if (fileName == NULL || obj == NULL || obj->optionalProperties == NULL || !hasCardExtension(fileName))
+    {
+        return WRITE_ERROR;
+    }
+
+    unsigned long long start = statsNow();
+    VC_TRACE_BEGIN_DETAIL("write", fileName);
+    VCardErrorCode err = writeSource(fileName, obj, source);
+    VC_TRACE_END();
+    threadStats.serializeNs += statsNow() - start;
+    return err;
+}
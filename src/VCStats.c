@@ -0,0 +1,45 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+#include <time.h>
+#include "VCHelpers.h"
+
+// Counters of the current thread, updated directly by the parser
+_Thread_local VCStats threadStats;
+
+void vcGetStats(VCStats *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+    *stats = threadStats;
+}
+
+void vcResetStats(void)
+{
+    memset(&threadStats, 0, sizeof(threadStats));
+}
+
+// Adds the counters of another thread, e.g. a worker that is about to exit
+void addStats(VCStats *into, const VCStats *from)
+{
+    into->bytesRead += from->bytesRead;
+    into->physicalLines += from->physicalLines;
+    into->logicalLines += from->logicalLines;
+    into->foldedLines += from->foldedLines;
+    into->properties += from->properties;
+    into->parameters += from->parameters;
+    into->values += from->values;
+    into->allocations += from->allocations;
+    into->readNs += from->readNs;
+    into->tokenizeNs += from->tokenizeNs;
+    into->validateNs += from->validateNs;
+    into->serializeNs += from->serializeNs;
+}
+
+// Monotonic clock in nanoseconds, used to time the parser phases
+unsigned long long statsNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
@@ -0,0 +1,259 @@
+#include "VCStructured.h"
+#include "VCHelpers.h"
+
+#define NAME_COMPONENTS 5
+#define ADDRESS_COMPONENTS 7
+
+// A typed view in one allocation: the header, then the sub-component pointers, then their strings
+struct structuredValue
+{
+    size_t size;    // Bytes in the allocation, so a copy is one memcpy
+    int components; // NAME_COMPONENTS or ADDRESS_COMPONENTS
+    union
+    {
+        StructuredName name;
+        StructuredAddress address;
+        StructuredComponent component[ADDRESS_COMPONENTS];
+    } view;
+};
+
+_Static_assert(sizeof(StructuredName) == NAME_COMPONENTS * sizeof(StructuredComponent), "N components must be packed");
+_Static_assert(sizeof(StructuredAddress) == ADDRESS_COMPONENTS * sizeof(StructuredComponent), "ADR components must be packed");
+
+// Where the next sub-component pointer and string go while a view is filled in
+typedef struct
+{
+    StructuredValue *value;
+    char **items;
+    char *strings;
+} ViewBuilder;
+
+// ************* Building the views ***************
+
+// Function to get the number of components of a structured property
+/*
+@param name - the property name
+@return 5 for N, 7 for ADR, 0 for every other property
+*/
+int structuredComponentCount(const char *name)
+{
+    if (strcmp(name, "N") == 0)
+    {
+        return NAME_COMPONENTS;
+    }
+    if (strcmp(name, "ADR") == 0)
+    {
+        return ADDRESS_COMPONENTS;
+    }
+    return 0;
+}
+
+// Allocates a view for at most itemCount sub-components holding at most stringBytes bytes
+static bool startView(ViewBuilder *builder, int components, size_t itemCount, size_t stringBytes)
+{
+    size_t size = sizeof(StructuredValue) + itemCount * sizeof(char *) + stringBytes;
+    StructuredValue *value = vcCalloc(1, size);
+    if (value == NULL)
+    {
+        return false;
+    }
+    value->size = size;
+    value->components = components;
+    builder->value = value;
+    builder->items = (char **)(value + 1);
+    builder->strings = (char *)(builder->items + itemCount);
+    return true;
+}
+
+// Decodes one component into its sub-components. The component ends at the end of the string,
+// or at the first unescaped ';' if stopAtSemicolon is set; unescaped commas separate the sub-components.
+/*
+@return the position of the character that ended the component
+*/
+static const char *addComponent(ViewBuilder *builder, StructuredComponent *component, const char *raw, bool stopAtSemicolon)
+{
+    component->values = builder->items;
+    component->count = 0;
+
+    while (true)
+    {
+        char *out = builder->strings;
+        *builder->items++ = out;
+        component->count++;
+
+        while (*raw != '\0' && *raw != ',' && !(stopAtSemicolon && *raw == ';'))
+        {
+            if (*raw == '\\' && raw[1] != '\0')
+            {
+                raw++; // \; \, \\ stand for the character itself, \n and \N for a line break
+                *out++ = (*raw == 'n' || *raw == 'N') ? '\n' : *raw;
+                raw++;
+            }
+            else
+            {
+                *out++ = *raw++;
+            }
+        }
+        *out++ = '\0';
+        builder->strings = out;
+
+        if (*raw != ',')
+        {
+            break;
+        }
+        raw++; // Skip the comma, another sub-component follows
+    }
+
+    // A component with nothing in it has no sub-components
+    if (component->count == 1 && component->values[0][0] == '\0')
+    {
+        component->count = 0;
+        component->values = NULL;
+        builder->items--;
+    }
+    return raw;
+}
+
+static size_t countCommas(const char *str)
+{
+    size_t count = 0;
+    for (; *str != '\0'; str++)
+    {
+        count += *str == ',';
+    }
+    return count;
+}
+
+// Function to split the raw text of an N or ADR value into its typed view
+/*
+@param name - the property name, N or ADR
+@param raw - the value as it is in the card, everything after the ':' with the escapes still in it
+@return the view, or NULL if the property is not structured or the allocation failed. Freed with vcFree.
+*/
+StructuredValue *parseStructuredValue(const char *name, const char *raw)
+{
+    int components = structuredComponentCount(name);
+    if (components == 0 || raw == NULL)
+    {
+        return NULL;
+    }
+
+    // Every comma may start a sub-component, and every sub-component needs a terminator
+    size_t commas = countCommas(raw);
+    ViewBuilder builder;
+    if (!startView(&builder, components, commas + components, strlen(raw) + commas + components))
+    {
+        return NULL;
+    }
+
+    bool more = true; // Components missing at the end of the value are left empty
+    for (int c = 0; c < components && more; c++)
+    {
+        raw = addComponent(&builder, &builder.value->view.component[c], raw, true);
+        if (*raw == ';')
+        {
+            raw++;
+        }
+        else
+        {
+            more = false;
+        }
+    }
+    return builder.value;
+}
+
+// Function to copy a view
+/*
+@param value - the view to copy
+@return the copy, or NULL if the allocation failed. Freed with vcFree.
+*/
+StructuredValue *copyStructuredValue(const StructuredValue *value)
+{
+    StructuredValue *copy = vcMalloc(value->size);
+    if (copy == NULL)
+    {
+        return NULL;
+    }
+    memcpy(copy, value, value->size);
+
+    // Point the copied pointers at the same offsets in the new allocation
+    const char *oldBase = (const char *)value;
+    char *newBase = (char *)copy;
+    for (int c = 0; c < copy->components; c++)
+    {
+        StructuredComponent *component = &copy->view.component[c];
+        if (component->values == NULL)
+        {
+            continue;
+        }
+        component->values = (char **)(newBase + ((const char *)component->values - oldBase));
+        for (int i = 0; i < component->count; i++)
+        {
+            component->values[i] = newBase + (component->values[i] - oldBase);
+        }
+    }
+    return copy;
+}
+
+// ************* Public functions ***************
+
+const StructuredName *getStructuredName(const Property *property)
+{
+    if (property == NULL)
+    {
+        return NULL;
+    }
+    const PropertyBlock *block = propertyBlock(property);
+    const StructuredValue *value = block != NULL ? block->structured : NULL;
+    return value != NULL && value->components == NAME_COMPONENTS ? &value->view.name : NULL;
+}
+
+const StructuredAddress *getStructuredAddress(const Property *property)
+{
+    if (property == NULL)
+    {
+        return NULL;
+    }
+    const PropertyBlock *block = propertyBlock(property);
+    const StructuredValue *value = block != NULL ? block->structured : NULL;
+    return value != NULL && value->components == ADDRESS_COMPONENTS ? &value->view.address : NULL;
+}
+
+VCardErrorCode refreshStructuredValue(Property *property)
+{
+    if (property == NULL || property->name == NULL || property->values == NULL)
+    {
+        return INV_PROP;
+    }
+    int components = structuredComponentCount(property->name);
+    PropertyBlock *block = propertyBlock(property);
+    if (components == 0 || block == NULL)
+    {
+        return INV_PROP; // Not N or ADR, or built by hand and without room for a view
+    }
+
+    size_t commas = 0;
+    size_t length = 0;
+    for (Node *node = property->values->head; node != NULL; node = node->next)
+    {
+        commas += countCommas(node->data);
+        length += strlen(node->data);
+    }
+
+    ViewBuilder builder;
+    if (!startView(&builder, components, commas + components, length + commas + components))
+    {
+        return OTHER_ERROR;
+    }
+
+    // One value per component, values past the last component are not part of the view
+    Node *node = property->values->head;
+    for (int c = 0; c < components && node != NULL; c++, node = node->next)
+    {
+        addComponent(&builder, &builder.value->view.component[c], node->data, false);
+    }
+
+    vcFree(block->structured);
+    block->structured = builder.value;
+    return OK;
+}
@@ -0,0 +1,226 @@
+#define _POSIX_C_SOURCE 200809L // getpid
+#include <unistd.h>
+#include "VCTrace.h"
+#include "VCHelpers.h"
+
+#ifdef VC_TRACE
+
+#include <stdatomic.h>
+
+#define DEFAULT_TRACE_CAPACITY 262144
+#define MAX_TRACE_DEPTH 32
+#define TRACE_DETAIL_LENGTH 48
+
+// One finished span ("complete" event in the Chrome format)
+typedef struct
+{
+    const char *name; // Always a string literal
+    unsigned long long start;
+    unsigned long long duration;
+    int thread;
+    char detail[TRACE_DETAIL_LENGTH];
+} TraceEvent;
+
+// Spans that are still open on one thread
+typedef struct
+{
+    const char *name;
+    const char *detail;
+    unsigned long long start;
+} OpenSpan;
+
+static TraceEvent *events = NULL;
+static size_t eventCapacity = 0;
+static atomic_size_t nextEvent;
+static atomic_int nextThread;
+
+static _Thread_local OpenSpan openSpans[MAX_TRACE_DEPTH];
+static _Thread_local int openDepth = 0;
+static _Thread_local int threadNumber = 0;
+
+bool vcTraceStart(size_t capacity)
+{
+    vcTraceStop();
+    if (capacity == 0)
+    {
+        capacity = DEFAULT_TRACE_CAPACITY;
+    }
+    // Plain malloc: the trace buffer is not library data and must not land in a caller's arena
+    events = malloc(capacity * sizeof(TraceEvent));
+    if (events == NULL)
+    {
+        return false;
+    }
+    eventCapacity = capacity;
+    atomic_store(&nextEvent, 0);
+    return true;
+}
+
+void vcTraceStop(void)
+{
+    free(events);
+    events = NULL;
+    eventCapacity = 0;
+}
+
+void vcTraceBegin(const char *name, const char *detail)
+{
+    // Spans deeper than the stack are still counted so that End and Unwind stay balanced
+    if (openDepth < MAX_TRACE_DEPTH)
+    {
+        openSpans[openDepth].name = name;
+        openSpans[openDepth].detail = detail;
+        openSpans[openDepth].start = statsNow();
+    }
+    openDepth++;
+}
+
+void vcTraceEnd(void)
+{
+    if (openDepth == 0)
+    {
+        return;
+    }
+    openDepth--;
+    if (openDepth >= MAX_TRACE_DEPTH || events == NULL)
+    {
+        return;
+    }
+
+    size_t slot = atomic_fetch_add(&nextEvent, 1);
+    if (slot >= eventCapacity)
+    {
+        return; // Buffer is full
+    }
+
+    if (threadNumber == 0)
+    {
+        threadNumber = atomic_fetch_add(&nextThread, 1) + 1;
+    }
+
+    OpenSpan *span = &openSpans[openDepth];
+    TraceEvent *event = &events[slot];
+    event->name = span->name;
+    event->start = span->start;
+    event->duration = statsNow() - span->start;
+    event->thread = threadNumber;
+    event->detail[0] = '\0';
+    if (span->detail != NULL)
+    {
+        // Keep the end of long details, for file names that is the part that matters
+        size_t length = strlen(span->detail);
+        const char *from = length < TRACE_DETAIL_LENGTH ? span->detail : span->detail + length - (TRACE_DETAIL_LENGTH - 1);
+        strcpy(event->detail, from);
+    }
+}
+
+int vcTraceDepth(void)
+{
+    return openDepth;
+}
+
+void vcTraceUnwind(int depth)
+{
+    while (openDepth > depth)
+    {
+        vcTraceEnd();
+    }
+}
+
+// Writes a string as JSON, escaping quotes, backslashes and control characters
+static void writeJsonString(FILE *file, const char *str)
+{
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fprintf(file, "\\%c", *c);
+        }
+        else if (*c < 0x20)
+        {
+            fprintf(file, "\\u%04x", *c);
+        }
+        else
+        {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+bool vcTraceDump(const char *fileName)
+{
+    if (events == NULL || fileName == NULL)
+    {
+        return false;
+    }
+
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    size_t count = atomic_load(&nextEvent);
+    if (count > eventCapacity)
+    {
+        count = eventCapacity;
+    }
+
+    // Timestamps are in microseconds, relative to the first span so the numbers stay readable
+    unsigned long long origin = count > 0 ? events[0].start : 0;
+    for (size_t i = 1; i < count; i++)
+    {
+        if (events[i].start < origin)
+        {
+            origin = events[i].start;
+        }
+    }
+
+    int pid = (int)getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < count; i++)
+    {
+        TraceEvent *event = &events[i];
+        fprintf(file, "{\"name\":");
+        writeJsonString(file, event->name);
+        fprintf(file, ",\"cat\":\"vcparser\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+                (event->start - origin) / 1000.0, event->duration / 1000.0, pid, event->thread);
+        if (event->detail[0] != '\0')
+        {
+            fprintf(file, ",\"args\":{\"detail\":");
+            writeJsonString(file, event->detail);
+            fputc('}', file);
+        }
+        fprintf(file, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "]}\n");
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0)
+    {
+        ok = false;
+    }
+    return ok;
+}
+
+#else
+
+bool vcTraceStart(size_t capacity)
+{
+    (void)capacity;
+    return false;
+}
+
+bool vcTraceDump(const char *fileName)
+{
+    (void)fileName;
+    return false;
+}
+
+void vcTraceStop(void)
+{
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include "VCHelpers.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Checks one multi-byte sequence that starts at data[0] (a byte >= 0x80), following the table of
+// well-formed sequences in RFC 3629: no overlong forms, no surrogates, nothing above U+10FFFF.
+/*
+@return the length of the sequence, or 0 if it is not valid UTF-8
+*/
+static size_t sequenceLength(const unsigned char *data, size_t available)
+{
+    unsigned char lead = data[0];
+    size_t length;
+    unsigned char low = 0x80; // Allowed range of the second byte, narrower for some lead bytes
+    unsigned char high = 0xBF;
+
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        length = 2;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        length = 3;
+        if (lead == 0xE0)
+        {
+            low = 0xA0; // Overlong below U+0800
+        }
+        else if (lead == 0xED)
+        {
+            high = 0x9F; // Surrogates U+D800 to U+DFFF
+        }
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        length = 4;
+        if (lead == 0xF0)
+        {
+            low = 0x90; // Overlong below U+10000
+        }
+        else if (lead == 0xF4)
+        {
+            high = 0x8F; // Above U+10FFFF
+        }
+    }
+    else
+    {
+        return 0; // Continuation byte without a lead, or 0xC0, 0xC1, 0xF5 and up
+    }
+
+    if (available < length || data[1] < low || data[1] > high)
+    {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++)
+    {
+        if ((data[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// Function to check that a line is valid UTF-8, as RFC 6350 requires of the whole card
+/*
+@param data - the bytes to check, they do not need to be null-terminated
+@param length - the number of bytes
+@return true if every byte belongs to a well-formed UTF-8 sequence
+*/
+bool isValidUtf8(const char *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t i = 0;
+    while (i < length)
+    {
+#ifdef __SSE2__
+        // Cards are mostly ASCII: skip 16 bytes at a time while none of them has the high bit set
+        while (length - i >= 16)
+        {
+            int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(bytes + i)));
+            if (mask != 0)
+            {
+                i += __builtin_ctz(mask);
+                break;
+            }
+            i += 16;
+        }
+#endif
+        while (i < length && bytes[i] < 0x80)
+        {
+            i++;
+        }
+        if (i == length)
+        {
+            break;
+        }
+
+        size_t sequence = sequenceLength(bytes + i, length - i);
+        if (sequence == 0)
+        {
+            return false;
+        }
+        i += sequence;
+    }
+    return true;
+}
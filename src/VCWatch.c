@@ -0,0 +1,387 @@
+#define _GNU_SOURCE // inotify_init1, IN_CLOEXEC
+#include <errno.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "VCWatch.h"
+#include "VCLoader.h"
+#include "VectorAPI.h"
+#include "VCHelpers.h"
+
+// What the watcher knows about one file of the directory
+typedef struct
+{
+    char *name;
+    char *path;    // directory/name, what the card is loaded from
+    Card *card;    // NULL while the file is invalid
+    bool reported; // An event was sent for the file, so its removal is reported as well
+    bool dirty;    // Waiting in the dirty vector to be parsed again
+} WatchedFile;
+
+struct cardWatcher
+{
+    int fd; // inotify instance
+    char *directory;
+    WatchCallback callback;
+    void *context;
+    List *files;      // WatchedFile, with a hash index on the name
+    Vector *dirty;    // Files to look at in the next round, in the order their changes came in
+    VCLoader *loader; // Parses the dirty files in batches, NULL if it could not be created
+    bool gone;        // The directory was deleted or moved away
+};
+
+// The inotify events that can change the set of cards. A file that is still being written
+// only shows up with its IN_CLOSE_WRITE, so half-written files are not parsed.
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+// ************* List and vector helper functions ***************
+
+static void deleteWatchedFile(void *toBeDeleted)
+{
+    WatchedFile *file = toBeDeleted;
+    vcFree(file->name);
+    vcFree(file->path);
+    deleteCard(file->card);
+    vcFree(file);
+}
+
+static int compareWatchedFiles(const void *first, const void *second)
+{
+    return strcmp(((const WatchedFile *)first)->name, ((const WatchedFile *)second)->name);
+}
+
+static char *watchedFileToString(void *file)
+{
+    return copyString(((WatchedFile *)file)->name);
+}
+
+// djb2 over the file name
+static unsigned long hashWatchedFile(const void *file)
+{
+    unsigned long hash = 5381;
+    for (const unsigned char *c = (const unsigned char *)((const WatchedFile *)file)->name; *c != '\0'; c++)
+    {
+        hash = hash * 33 + *c;
+    }
+    return hash;
+}
+
+// The dirty vector only points at files in the list
+static void keepFile(void *file)
+{
+    (void)file;
+}
+
+// ************* Tracking changes ***************
+
+static WatchedFile *findFile(CardWatcher *watcher, const char *name)
+{
+    WatchedFile key = {.name = (char *)name};
+    return findIndexedElement(watcher->files, &key);
+}
+
+// Queues a file to be looked at again, adding it to the list the first time it is seen
+static bool markDirty(CardWatcher *watcher, const char *name)
+{
+    if (!hasCardExtension(name))
+    {
+        return true; // Not a card file, nothing to do
+    }
+
+    WatchedFile *file = findFile(watcher, name);
+    if (file == NULL)
+    {
+        file = vcCalloc(1, sizeof(WatchedFile));
+        if (file == NULL)
+        {
+            return false;
+        }
+        file->name = copyString(name);
+        file->path = vcMalloc(strlen(watcher->directory) + strlen(name) + 2);
+        if (file->name == NULL || file->path == NULL)
+        {
+            deleteWatchedFile(file);
+            return false;
+        }
+        sprintf(file->path, "%s/%s", watcher->directory, name);
+        insertBack(watcher->files, file);
+    }
+
+    if (!file->dirty)
+    {
+        if (!pushBack(watcher->dirty, file))
+        {
+            return false;
+        }
+        file->dirty = true;
+    }
+    return true;
+}
+
+// Queues every file in the directory, and every file the watcher knows of so the ones that
+// are gone get reported. Used at the start and after the inotify queue overflowed.
+static bool scanDirectory(CardWatcher *watcher)
+{
+    DIR *dir = opendir(watcher->directory);
+    if (dir == NULL)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL)
+    {
+        ok = markDirty(watcher, entry->d_name);
+    }
+    closedir(dir);
+
+    for (Node *node = watcher->files->head; ok && node != NULL; node = node->next)
+    {
+        ok = markDirty(watcher, ((WatchedFile *)node->data)->name);
+    }
+    return ok;
+}
+
+// Reads everything inotify has queued. Returns false if the events could not be read.
+static bool readEvents(CardWatcher *watcher)
+{
+    char buffer[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool rescan = false;
+    bool ok = true;
+
+    while (ok)
+    {
+        ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+        if (length < 0)
+        {
+            ok = errno == EAGAIN || errno == EINTR;
+            if (errno != EINTR)
+            {
+                break;
+            }
+            continue;
+        }
+
+        for (char *position = buffer; ok && position < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)position;
+            position += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                rescan = true; // Some changes were lost, look at everything
+            }
+            else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                watcher->gone = true;
+            }
+            else if (event->len > 0 && !(event->mask & IN_ISDIR))
+            {
+                ok = markDirty(watcher, event->name);
+            }
+        }
+    }
+
+    if (watcher->gone)
+    {
+        // Every file is reported as removed once its path can't be found any more
+        for (Node *node = watcher->files->head; ok && node != NULL; node = node->next)
+        {
+            ok = markDirty(watcher, ((WatchedFile *)node->data)->name);
+        }
+    }
+    else if (ok && rescan)
+    {
+        ok = scanDirectory(watcher);
+    }
+    return ok;
+}
+
+static void report(CardWatcher *watcher, WatchEventType type, WatchedFile *file, VCardErrorCode error)
+{
+    WatchEvent event = {type, file->name, file->card, error};
+    file->reported = true;
+    watcher->callback(&event, watcher->context);
+}
+
+// Looks at every dirty file: files that are gone are reported and dropped, the others are
+// parsed (in batches through the loader) and validated. Returns the number of events sent.
+static int processDirty(CardWatcher *watcher)
+{
+    int count = watcher->dirty->length;
+    int events = 0;
+    int parseCount = 0;
+    WatchedFile **parse = vcMalloc((count > 0 ? count : 1) * sizeof(WatchedFile *));
+    char **paths = vcMalloc((count > 0 ? count : 1) * sizeof(char *));
+    Card **cards = vcMalloc((count > 0 ? count : 1) * sizeof(Card *));
+    VCardErrorCode *errors = vcMalloc((count > 0 ? count : 1) * sizeof(VCardErrorCode));
+    if (parse == NULL || paths == NULL || cards == NULL || errors == NULL)
+    {
+        vcFree(parse);
+        vcFree(paths);
+        vcFree(cards);
+        vcFree(errors);
+        return -1; // The files stay dirty and are looked at next time
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        WatchedFile *file = getAt(watcher->dirty, i);
+        struct stat info;
+        file->dirty = false;
+        if (stat(file->path, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            if (file->reported)
+            {
+                deleteCard(file->card);
+                file->card = NULL;
+                report(watcher, WATCH_REMOVED, file, OK);
+                events++;
+            }
+            deleteWatchedFile(deleteDataFromList(watcher->files, file));
+            continue;
+        }
+        parse[parseCount] = file;
+        paths[parseCount++] = file->path;
+    }
+    clearVector(watcher->dirty);
+
+    if (watcher->loader != NULL)
+    {
+        createCardsFromFiles(watcher->loader, paths, parseCount, cards, errors);
+    }
+    else
+    {
+        for (int i = 0; i < parseCount; i++)
+        {
+            errors[i] = createCard(paths[i], &cards[i]);
+        }
+    }
+
+    for (int i = 0; i < parseCount; i++)
+    {
+        WatchedFile *file = parse[i];
+        VCardErrorCode err = errors[i];
+        if (err == OK && (err = validateCard(cards[i])) != OK)
+        {
+            deleteCard(cards[i]);
+        }
+        Card *card = err == OK ? cards[i] : NULL;
+
+        // An invalid file is reported when it turns up or stops being valid, not on every write
+        bool wasValid = file->card != NULL;
+        deleteCard(file->card);
+        file->card = card;
+        if (card != NULL)
+        {
+            report(watcher, wasValid ? WATCH_CHANGED : WATCH_ADDED, file, OK);
+            events++;
+        }
+        else if (wasValid || !file->reported)
+        {
+            report(watcher, WATCH_INVALID, file, err);
+            events++;
+        }
+    }
+
+    vcFree(parse);
+    vcFree(paths);
+    vcFree(cards);
+    vcFree(errors);
+    return events;
+}
+
+// ************* Public functions ***************
+
+CardWatcher *vcWatchDirectory(const char *directory, WatchCallback callback, void *context)
+{
+    if (directory == NULL || callback == NULL)
+    {
+        return NULL;
+    }
+
+    CardWatcher *watcher = vcCalloc(1, sizeof(CardWatcher));
+    if (watcher == NULL)
+    {
+        return NULL;
+    }
+    watcher->callback = callback;
+    watcher->context = context;
+    watcher->directory = copyString(directory);
+    watcher->files = initializeList(&watchedFileToString, &deleteWatchedFile, &compareWatchedFiles);
+    watcher->dirty = initializeVector(&watchedFileToString, &keepFile, &compareWatchedFiles);
+    watcher->loader = createLoader(0, true);
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    // The watch is added before the scan, so nothing written in between is missed
+    if (watcher->directory == NULL || watcher->files == NULL || watcher->dirty == NULL || watcher->fd < 0 ||
+        !createListIndex(watcher->files, &hashWatchedFile) || inotify_add_watch(watcher->fd, directory, WATCH_MASK) < 0 ||
+        !scanDirectory(watcher) || processDirty(watcher) < 0)
+    {
+        vcStopWatching(watcher);
+        return NULL;
+    }
+    return watcher;
+}
+
+int vcProcessWatchEvents(CardWatcher *watcher, int timeout)
+{
+    if (watcher == NULL || watcher->gone)
+    {
+        return -1;
+    }
+
+    struct pollfd pfd = {watcher->fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout);
+    if (ready < 0 && errno != EINTR)
+    {
+        return -1;
+    }
+    if (ready > 0 && !readEvents(watcher))
+    {
+        return -1;
+    }
+    int events = watcher->dirty->length > 0 ? processDirty(watcher) : 0;
+    return watcher->gone && events == 0 ? -1 : events;
+}
+
+int vcWatchFd(const CardWatcher *watcher)
+{
+    return watcher != NULL ? watcher->fd : -1;
+}
+
+const Card *vcGetWatchedCard(CardWatcher *watcher, const char *fileName)
+{
+    if (watcher == NULL || fileName == NULL)
+    {
+        return NULL;
+    }
+    WatchedFile *file = findFile(watcher, fileName);
+    return file != NULL ? file->card : NULL;
+}
+
+void vcStopWatching(CardWatcher *watcher)
+{
+    if (watcher == NULL)
+    {
+        return;
+    }
+    if (watcher->fd >= 0)
+    {
+        close(watcher->fd); // Also removes the watch
+    }
+    if (watcher->dirty != NULL)
+    {
+        freeVector(watcher->dirty);
+    }
+    if (watcher->files != NULL)
+    {
+        freeList(watcher->files);
+    }
+    deleteLoader(watcher->loader);
+    vcFree(watcher->directory);
+    vcFree(watcher);
+}
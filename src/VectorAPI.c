@@ -0,0 +1,276 @@
+#include "VectorAPI.h"
+#include "StringBuilder.h"
+#include "VCAlloc.h"
+
+#define INITIAL_CAPACITY 8
+
+Vector* initializeVector(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second)){
+	//Asserts create a partial function, same as initializeList
+	assert(printFunction != NULL);
+	assert(deleteFunction != NULL);
+	assert(compareFunction != NULL);
+
+	Vector* tmpVector = vcMalloc(sizeof(Vector));
+	if (tmpVector == NULL){
+		return NULL;
+	}
+
+	tmpVector->data = NULL;
+	tmpVector->length = 0;
+	tmpVector->capacity = 0;
+
+	tmpVector->deleteData = deleteFunction;
+	tmpVector->compare = compareFunction;
+	tmpVector->printData = printFunction;
+
+	return tmpVector;
+}
+
+void freeVector(Vector* vector){
+	if (vector == NULL){
+		return;
+	}
+
+	clearVector(vector);
+	vcFree(vector->data);
+	vcFree(vector);
+}
+
+void clearVector(Vector* vector){
+	if (vector == NULL){
+		return;
+	}
+
+	for (int i = 0; i < vector->length; i++){
+		vector->deleteData(vector->data[i]);
+	}
+
+	vector->length = 0;
+}
+
+bool reserveVector(Vector* vector, int capacity){
+	if (vector == NULL || capacity < 0){
+		return false;
+	}
+
+	if (capacity <= vector->capacity){
+		return true;
+	}
+
+	void** tmp = vcRealloc(vector->data, sizeof(void*) * capacity);
+	if (tmp == NULL){
+		return false;
+	}
+
+	vector->data = tmp;
+	vector->capacity = capacity;
+
+	return true;
+}
+
+bool pushBack(Vector* vector, void* toBeAdded){
+	if (vector == NULL || toBeAdded == NULL){
+		return false;
+	}
+
+	if (vector->length == vector->capacity){
+		int newCapacity = vector->capacity == 0 ? INITIAL_CAPACITY : vector->capacity * 2;
+		if (!reserveVector(vector, newCapacity)){
+			return false;
+		}
+	}
+
+	vector->data[vector->length] = toBeAdded;
+	(vector->length)++;
+
+	return true;
+}
+
+bool insertAt(Vector* vector, int index, void* toBeAdded){
+	if (vector == NULL || toBeAdded == NULL || index < 0 || index > vector->length){
+		return false;
+	}
+
+	if (!pushBack(vector, toBeAdded)){
+		return false;
+	}
+
+	memmove(&vector->data[index + 1], &vector->data[index], sizeof(void*) * (vector->length - index - 1));
+	vector->data[index] = toBeAdded;
+
+	return true;
+}
+
+void* popBack(Vector* vector){
+	if (vector == NULL || vector->length == 0){
+		return NULL;
+	}
+
+	(vector->length)--;
+	return vector->data[vector->length];
+}
+
+void* getAt(Vector* vector, int index){
+	if (vector == NULL || index < 0 || index >= vector->length){
+		return NULL;
+	}
+
+	return vector->data[index];
+}
+
+void* removeAt(Vector* vector, int index){
+	if (vector == NULL || index < 0 || index >= vector->length){
+		return NULL;
+	}
+
+	void* data = vector->data[index];
+	memmove(&vector->data[index], &vector->data[index + 1], sizeof(void*) * (vector->length - index - 1));
+	(vector->length)--;
+
+	return data;
+}
+
+int getVectorLength(Vector* vector){
+	if (vector == NULL){
+		return -1;
+	}
+
+	return vector->length;
+}
+
+//Bottom-up merge sort. qsort can't be used because it has no way to pass the vector's compare
+//through to the element pointers, and merge sort keeps equal elements in insertion order.
+bool sortVector(Vector* vector){
+	if (vector == NULL){
+		return false;
+	}
+
+	int n = vector->length;
+	if (n < 2){
+		return true;
+	}
+
+	void** tmp = vcMalloc(sizeof(void*) * n);
+	if (tmp == NULL){
+		return false;
+	}
+
+	void** src = vector->data;
+	void** dst = tmp;
+
+	for (int width = 1; width < n; width *= 2){
+		for (int lo = 0; lo < n; lo += 2 * width){
+			int mid = lo + width < n ? lo + width : n;
+			int hi = lo + 2 * width < n ? lo + 2 * width : n;
+			int i = lo;
+			int j = mid;
+			int k = lo;
+
+			while (i < mid && j < hi){
+				if (vector->compare(src[j], src[i]) < 0){
+					dst[k++] = src[j++];
+				}else{
+					dst[k++] = src[i++];
+				}
+			}
+			while (i < mid){
+				dst[k++] = src[i++];
+			}
+			while (j < hi){
+				dst[k++] = src[j++];
+			}
+		}
+
+		void** swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	//After the last pass the sorted run is in src, which may be the temporary buffer
+	if (src != vector->data){
+		memcpy(vector->data, src, sizeof(void*) * n);
+	}
+
+	vcFree(tmp);
+	return true;
+}
+
+int searchVector(Vector* vector, const void* searchRecord){
+	if (vector == NULL || searchRecord == NULL){
+		return -1;
+	}
+
+	int lo = 0;
+	int hi = vector->length - 1;
+
+	while (lo <= hi){
+		int mid = lo + (hi - lo) / 2;
+		int result = vector->compare(searchRecord, vector->data[mid]);
+
+		if (result == 0){
+			return mid;
+		}else if (result < 0){
+			hi = mid - 1;
+		}else{
+			lo = mid + 1;
+		}
+	}
+
+	return -1;
+}
+
+void* findInVector(Vector* vector, bool (*customCompare)(const void* first,const void* second), const void* searchRecord){
+	if (vector == NULL || customCompare == NULL || searchRecord == NULL){
+		return NULL;
+	}
+
+	for (int i = 0; i < vector->length; i++){
+		if (customCompare(vector->data[i], searchRecord)){
+			return vector->data[i];
+		}
+	}
+
+	return NULL;
+}
+
+char* vectorToString(Vector* vector){
+	if (vector == NULL){
+		return NULL;
+	}
+
+	StringBuilder sb;
+	if (!initializeStringBuilder(&sb, 0)){
+		return NULL;
+	}
+
+	for (int i = 0; i < vector->length; i++){
+		char* currDescr = vector->printData(vector->data[i]);
+		if (currDescr != NULL){
+			bool appended = appendString(&sb, currDescr);
+			vcFree(currDescr);
+			if (!appended){
+				freeStringBuilder(&sb);
+				return NULL;
+			}
+		}
+	}
+
+	return detachString(&sb);
+}
+
+VectorIterator createVectorIterator(Vector* vector){
+	VectorIterator iter;
+
+	iter.vector = vector;
+	iter.index = 0;
+
+	return iter;
+}
+
+void* nextVectorElement(VectorIterator* iter){
+	if (iter->vector == NULL || iter->index >= iter->vector->length){
+		return NULL;
+	}
+
+	return iter->vector->data[(iter->index)++];
+}
@@ -0,0 +1,386 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, mkdir
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "VCParser.h"
+#include "VCLoader.h"
+#include "VCPipeline.h"
+#include "VCGen.h"
+
+// Benchmark driver for the parser.
+// Generates a corpus of cards for each shape with the vcgen generator, then times createCard, validateCard,
+// cardToString, writeCard and cloneCard over it, plus createCardsFromFiles (the batch loader) as createCardBatch
+// and runPipeline (load, parse and validate on all CPUs) as pipeline. Those two time whole batches or runs, so they
+// only get the mean per card; the others get latency percentiles as well. Every result is printed as one JSON object per line
+// so runs can be diffed or loaded into a spreadsheet between releases. A last "stats" line per shape
+// holds the parser counters (see VCStats.h) for the timed passes.
+//
+// Usage: vcbench [-n cards per shape] [-s seed] [-d corpus directory] [-t trace file]
+// -t needs a library built with make DEFS=-DVC_TRACE
+
+typedef struct
+{
+    const char *name;
+    int properties;     // Optional properties per card
+    double parameters;  // Average parameters per optional property
+    int valueLength;    // Length of the free text values
+    int foldWidth;      // Physical line width, long lines are folded at this column
+} CardShape;
+
+static const CardShape shapes[] = {
+    {"baseline", 8, 1, 24, 75},
+    {"folding", 8, 1, 400, 8},
+    {"parameters", 8, 12, 24, 75},
+    {"largeValues", 4, 1, 16000, 75},
+    {"manyProperties", 400, 1, 24, 75},
+};
+
+typedef struct
+{
+    uint64_t *samples; // Nanoseconds per call
+    int count;
+    int cards;    // Cards covered by the samples when a call handles many of them, 0 when every call is one card
+    size_t bytes; // Bytes processed by all calls
+} Timings;
+
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Turns a shape into generator options, everything else keeps the vcgen defaults
+static void shapeOptions(const CardShape *shape, uint64_t seed, GeneratorOptions *options)
+{
+    initializeGeneratorOptions(options);
+    options->seed = seed;
+    options->properties = shape->properties;
+    options->parameterDensity = shape->parameters;
+    options->valueMin = shape->valueLength;
+    options->valueMax = shape->valueLength;
+    options->foldWidth = shape->foldWidth;
+}
+
+static long fileSize(const char *fileName)
+{
+    struct stat st;
+    return stat(fileName, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static int compareSamples(const void *first, const void *second)
+{
+    uint64_t a = *(const uint64_t *)first;
+    uint64_t b = *(const uint64_t *)second;
+    return (a > b) - (a < b);
+}
+
+static void report(const char *shape, const char *op, Timings *t)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < t->count; i++)
+    {
+        total += t->samples[i];
+    }
+    int cards = t->cards > 0 ? t->cards : t->count;
+
+    double seconds = total / 1e9;
+    printf("{\"shape\":\"%s\",\"op\":\"%s\",\"cards\":%d,\"bytes\":%zu,\"seconds\":%.6f,"
+           "\"cards_per_sec\":%.1f,\"mb_per_sec\":%.2f,\"mean_ns\":%llu",
+           shape, op, cards, t->bytes, seconds,
+           seconds > 0 ? cards / seconds : 0.0,
+           seconds > 0 ? t->bytes / seconds / 1e6 : 0.0,
+           (unsigned long long)(total / cards));
+    if (t->cards > 0)
+    {
+        printf("}\n"); // A sample is a whole batch, its percentiles would say nothing about single cards
+        return;
+    }
+
+    qsort(t->samples, t->count, sizeof(uint64_t), compareSamples);
+    printf(",\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}\n",
+           (unsigned long long)t->samples[t->count / 2],
+           (unsigned long long)t->samples[(int)(t->count * 0.90)],
+           (unsigned long long)t->samples[(int)(t->count * 0.99)],
+           (unsigned long long)t->samples[t->count - 1]);
+}
+
+// Prints the parser counters collected over the timed passes of one shape
+static void reportStats(const char *shape)
+{
+    VCStats stats;
+    vcGetStats(&stats);
+    printf("{\"shape\":\"%s\",\"op\":\"stats\",\"bytes_read\":%llu,\"physical_lines\":%llu,"
+           "\"logical_lines\":%llu,\"folded_lines\":%llu,\"properties\":%llu,\"parameters\":%llu,"
+           "\"values\":%llu,\"allocations\":%llu,\"read_ns\":%llu,\"tokenize_ns\":%llu,"
+           "\"validate_ns\":%llu,\"serialize_ns\":%llu}\n",
+           shape, stats.bytesRead, stats.physicalLines, stats.logicalLines, stats.foldedLines,
+           stats.properties, stats.parameters, stats.values, stats.allocations,
+           stats.readNs, stats.tokenizeNs, stats.validateNs, stats.serializeNs);
+}
+
+static void deleteResult(const PipelineResult *result, void *context)
+{
+    (void)context;
+    deleteCard(result->card);
+}
+
+static int runShape(const CardShape *shape, uint64_t seed, int cardCount, const char *dir)
+{
+    GeneratorOptions options;
+    char **fileNames = calloc(cardCount, sizeof(char *));
+    Card **cards = calloc(cardCount, sizeof(Card *));
+    Timings create = {calloc(cardCount, sizeof(uint64_t)), 0, 0, 0};
+    Timings validate = {calloc(cardCount, sizeof(uint64_t)), 0, 0, 0};
+    Timings toString = {calloc(cardCount, sizeof(uint64_t)), 0, 0, 0};
+    Timings write = {calloc(cardCount, sizeof(uint64_t)), 0, 0, 0};
+    Timings clone = {calloc(cardCount, sizeof(uint64_t)), 0, 0, 0};
+    Timings batch = {calloc(cardCount, sizeof(uint64_t)), 0, 0, 0};
+    Timings pipeline = {calloc(cardCount, sizeof(uint64_t)), 0, 0, 0};
+    char outName[512];
+    int status = 0;
+
+    snprintf(outName, sizeof(outName), "%s/out.vcf", dir);
+    shapeOptions(shape, seed, &options);
+
+    for (int i = 0; i < cardCount; i++)
+    {
+        fileNames[i] = malloc(512);
+        snprintf(fileNames[i], 512, "%s/%s-%05d.vcf", dir, shape->name, i);
+        if (generateCardFile(fileNames[i], &options, i, NULL) != 0)
+        {
+            fprintf(stderr, "vcbench: could not write %s\n", fileNames[i]);
+            cardCount = i + 1;
+            status = 1;
+            goto cleanup;
+        }
+    }
+
+    // Untimed pass so the corpus is in the page cache for every shape alike
+    for (int i = 0; i < cardCount; i++)
+    {
+        Card *card = NULL;
+        if (createCard(fileNames[i], &card) == OK)
+        {
+            deleteCard(card);
+        }
+    }
+
+    vcResetStats();
+    for (int i = 0; i < cardCount; i++)
+    {
+        uint64_t start = nowNs();
+        VCardErrorCode err = createCard(fileNames[i], &cards[i]);
+        create.samples[create.count++] = nowNs() - start;
+        create.bytes += fileSize(fileNames[i]);
+        if (err != OK)
+        {
+            fprintf(stderr, "vcbench: %s: %s\n", fileNames[i], errorToString(err));
+            cards[i] = NULL;
+            status = 1;
+            goto cleanup;
+        }
+    }
+
+    for (int i = 0; i < cardCount; i++)
+    {
+        uint64_t start = nowNs();
+        validateCard(cards[i]);
+        validate.samples[validate.count++] = nowNs() - start;
+        validate.bytes += fileSize(fileNames[i]);
+    }
+
+    for (int i = 0; i < cardCount; i++)
+    {
+        uint64_t start = nowNs();
+        char *str = cardToString(cards[i]);
+        toString.samples[toString.count++] = nowNs() - start;
+        toString.bytes += str != NULL ? strlen(str) : 0;
+        vcFree(str);
+    }
+
+    for (int i = 0; i < cardCount; i++)
+    {
+        uint64_t start = nowNs();
+        writeCard(outName, cards[i]);
+        write.samples[write.count++] = nowNs() - start;
+        write.bytes += fileSize(outName);
+    }
+
+    for (int i = 0; i < cardCount; i++)
+    {
+        Card *copy = NULL;
+        uint64_t start = nowNs();
+        cloneCard(cards[i], &copy);
+        clone.samples[clone.count++] = nowNs() - start;
+        clone.bytes += fileSize(fileNames[i]);
+        deleteCard(copy);
+    }
+
+    // Batch loader: one sample per batch of 256 files
+    bool batchFailed = false;
+    VCLoader *loader = createLoader(0, true);
+    Card **batchCards = calloc(cardCount, sizeof(Card *));
+    VCardErrorCode *batchErrors = calloc(cardCount, sizeof(VCardErrorCode));
+    if (loader == NULL || batchCards == NULL || batchErrors == NULL)
+    {
+        fprintf(stderr, "vcbench: could not create the batch loader\n");
+        batchFailed = true;
+    }
+    else
+    {
+        const int batchSize = 256;
+        for (int i = 0; i < cardCount; i += batchSize)
+        {
+            int count = cardCount - i < batchSize ? cardCount - i : batchSize;
+            uint64_t start = nowNs();
+            createCardsFromFiles(loader, fileNames + i, count, batchCards + i, batchErrors + i);
+            batch.samples[batch.count++] = nowNs() - start;
+            batch.cards += count;
+            for (int j = i; j < i + count; j++)
+            {
+                batch.bytes += fileSize(fileNames[j]);
+                if (batchErrors[j] != OK)
+                {
+                    fprintf(stderr, "vcbench: createCardsFromFiles: %s: %s\n", fileNames[j], errorToString(batchErrors[j]));
+                    batchFailed = true;
+                }
+                deleteCard(batchCards[j]);
+            }
+        }
+    }
+    deleteLoader(loader);
+    free(batchCards);
+    free(batchErrors);
+
+    // Pipeline: one sample for the whole run, so cards_per_sec is the real throughput
+    uint64_t pipelineStart = nowNs();
+    int parsed = runPipeline(fileNames, cardCount, NULL, deleteResult, NULL);
+    pipeline.samples[pipeline.count++] = nowNs() - pipelineStart;
+    pipeline.cards = cardCount;
+    for (int i = 0; i < cardCount; i++)
+    {
+        pipeline.bytes += fileSize(fileNames[i]);
+    }
+    if (parsed != cardCount)
+    {
+        if (parsed < 0)
+        {
+            fprintf(stderr, "vcbench: runPipeline could not start its threads\n");
+        }
+        else
+        {
+            fprintf(stderr, "vcbench: runPipeline: %d of %d cards failed\n", cardCount - parsed, cardCount);
+        }
+    }
+
+    report(shape->name, "createCard", &create);
+    if (batchFailed)
+    {
+        status = 1;
+    }
+    else
+    {
+        report(shape->name, "createCardBatch", &batch);
+    }
+    if (parsed != cardCount)
+    {
+        status = 1;
+    }
+    else
+    {
+        report(shape->name, "pipeline", &pipeline);
+    }
+    report(shape->name, "validateCard", &validate);
+    report(shape->name, "cardToString", &toString);
+    report(shape->name, "writeCard", &write);
+    report(shape->name, "cloneCard", &clone);
+    reportStats(shape->name);
+
+cleanup:
+    for (int i = 0; i < cardCount; i++)
+    {
+        deleteCard(cards[i]);
+        free(fileNames[i]);
+    }
+    free(fileNames);
+    free(cards);
+    free(create.samples);
+    free(validate.samples);
+    free(toString.samples);
+    free(write.samples);
+    free(clone.samples);
+    free(batch.samples);
+    free(pipeline.samples);
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    int cardCount = 1000;
+    uint64_t seed = 2750;
+    const char *dir = "bin/bench";
+    const char *traceFile = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            cardCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            traceFile = argv[++i];
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n cards per shape] [-s seed] [-d corpus directory] [-t trace file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (cardCount < 1)
+    {
+        fprintf(stderr, "vcbench: need at least one card\n");
+        return 2;
+    }
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "vcbench: could not create %s\n", dir);
+        return 1;
+    }
+
+    if (traceFile != NULL && !vcTraceStart(0))
+    {
+        fprintf(stderr, "vcbench: tracing is not available, rebuild with make DEFS=-DVC_TRACE\n");
+        return 2;
+    }
+
+    int status = 0;
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+    {
+        status |= runShape(&shapes[s], seed, cardCount, dir);
+    }
+
+    if (traceFile != NULL)
+    {
+        if (!vcTraceDump(traceFile))
+        {
+            fprintf(stderr, "vcbench: could not write %s\n", traceFile);
+            status = 1;
+        }
+        vcTraceStop();
+    }
+
+    return status;
+}
@@ -83,8 +83,8 @@ int main()
     }
 
     // Clean up
-    free(origCardStr);
-    free(reParsedStr);
+    vcFree(origCardStr);
+    vcFree(reParsedStr);
     deleteCard(origCard);
     deleteCard(reParsedCard);
 
@@ -128,8 +128,8 @@ int main()
     printf("Error code: %d\n", error);
     printf("Error string: %s\n", errorString);
 
-    free(cardString); // Don't forget to free the allocated memory for cardString
-    free(cardString2); // Don't forget to free the allocated memory for cardString2
+    vcFree(cardString); // Don't forget to free the allocated memory for cardString
+    vcFree(cardString2); // Don't forget to free the allocated memory for cardString2
 
     // Call deleteCard
     deleteCard((testCard));
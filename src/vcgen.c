@@ -0,0 +1,153 @@
+#define _POSIX_C_SOURCE 200809L // mkdir
+#include <errno.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <stdlib.h>
+#include "VCGen.h"
+
+// Synthetic corpus generator.
+// Writes count cards as <dir>/card-NNNNNNN.vcf plus <dir>/manifest.txt, which lists every
+// file with "valid" or "invalid" so a test or load run knows what the parser should return.
+
+static void usage(const char *program)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -n count        number of cards (default 1000)\n"
+            "  -s seed         corpus seed (default 2750)\n"
+            "  -o dir          output directory (default bin/corpus)\n"
+            "  -p count        optional properties per card (default 10)\n"
+            "  -x mix          property mix, e.g. N=1,ADR=2,TEL=4,EMAIL=3,GEO=1,ORG=1\n"
+            "  -g fraction     fraction of properties with a group prefix (default 0)\n"
+            "  -m density      average parameters per property (default 1)\n"
+            "  -w width        fold width in columns (default 75)\n"
+            "  -f fraction     fraction of long lines that are folded (default 1)\n"
+            "  -l min:max      free text value length (default 5:40)\n"
+            "  -t              long-tail value lengths instead of uniform\n"
+            "  -i fraction     fraction of invalid cards (default 0)\n",
+            program);
+}
+
+int main(int argc, char **argv)
+{
+    GeneratorOptions options;
+    initializeGeneratorOptions(&options);
+    long count = 1000;
+    const char *dir = "bin/corpus";
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "-t") == 0)
+        {
+            options.distribution = GEN_LONG_TAIL;
+            continue;
+        }
+        if (value == NULL || arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0')
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+
+        switch (arg[1])
+        {
+        case 'n':
+            count = atol(value);
+            break;
+        case 's':
+            options.seed = strtoull(value, NULL, 10);
+            break;
+        case 'o':
+            dir = value;
+            break;
+        case 'p':
+            options.properties = atoi(value);
+            break;
+        case 'x':
+            if (!parsePropertyMix(&options, value))
+            {
+                fprintf(stderr, "vcgen: bad property mix '%s'\n", value);
+                return 2;
+            }
+            break;
+        case 'g':
+            options.groupFraction = atof(value);
+            break;
+        case 'm':
+            options.parameterDensity = atof(value);
+            break;
+        case 'w':
+            options.foldWidth = atoi(value);
+            break;
+        case 'f':
+            options.foldFraction = atof(value);
+            break;
+        case 'l':
+            if (sscanf(value, "%d:%d", &options.valueMin, &options.valueMax) != 2)
+            {
+                fprintf(stderr, "vcgen: bad length range '%s'\n", value);
+                return 2;
+            }
+            break;
+        case 'i':
+            options.invalidFraction = atof(value);
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (count < 0 || options.properties < 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "vcgen: could not create %s\n", dir);
+        return 1;
+    }
+
+    size_t pathSize = strlen(dir) + 32;
+    char *path = malloc(pathSize);
+    if (path == NULL)
+    {
+        return 1;
+    }
+
+    snprintf(path, pathSize, "%s/manifest.txt", dir);
+    FILE *manifest = fopen(path, "w");
+    if (manifest == NULL)
+    {
+        fprintf(stderr, "vcgen: could not create %s\n", path);
+        free(path);
+        return 1;
+    }
+
+    long invalidCount = 0;
+    for (long i = 0; i < count; i++)
+    {
+        bool invalid = false;
+        snprintf(path, pathSize, "%s/card-%07ld.vcf", dir, i);
+        if (generateCardFile(path, &options, i, &invalid) != 0)
+        {
+            fprintf(stderr, "vcgen: could not write %s\n", path);
+            fclose(manifest);
+            free(path);
+            return 1;
+        }
+        fprintf(manifest, "card-%07ld.vcf %s\n", i, invalid ? "invalid" : "valid");
+        invalidCount += invalid;
+    }
+
+    fclose(manifest);
+    free(path);
+
+    printf("vcgen: wrote %ld cards (%ld invalid) to %s\n", count, invalidCount, dir);
+    return 0;
+}
@@ -0,0 +1,933 @@
+#define _POSIX_C_SOURCE 200809L // mkdir
+#include <stdio.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "VCParser.h"
+#include "VCSource.h"
+#include "VCStructured.h"
+#include "VCWatch.h"
+#include "VCLoader.h"
+#include "VCPipeline.h"
+#include "VCShared.h"
+#include "VCDiff.h"
+#include "VCAlloc.h"
+
+// Regression tests for the parser and the writer.
+// Each test parses a card from a buffer, writes it with writeCard, reads the file back with createCard and
+// checks the lines of the written file and the values of both cards. A failed check prints the test and the
+// line it is on; the exit status is the number of failed checks.
+//
+// Usage: vctest, run from a directory it can write vctest.vcf into (make test runs it in bin/)
+
+#define TEST_FILE "vctest.vcf"
+
+static int failures = 0;
+
+#define CHECK(test, condition)                                                     \
+    do                                                                             \
+    {                                                                              \
+        if (!(condition))                                                          \
+        {                                                                          \
+            printf("FAIL %s (line %d): %s\n", test, __LINE__, #condition);         \
+            failures++;                                                            \
+        }                                                                          \
+    } while (0)
+
+// Reads the whole test file, the result is freed with vcFree
+static char *readTestFile(void)
+{
+    FILE *file = fopen(TEST_FILE, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = vcMalloc(length + 1);
+    if (text != NULL)
+    {
+        text[fread(text, 1, length, file)] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+// Writes text into a file
+static bool writeFileText(const char *fileName, const char *text)
+{
+    FILE *file = fopen(fileName, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool ok = fwrite(text, 1, strlen(text), file) == strlen(text);
+    return fclose(file) == 0 && ok;
+}
+
+// Writes text into the test file
+static bool writeTestFile(const char *text)
+{
+    return writeFileText(TEST_FILE, text);
+}
+
+// Returns the values of the first optional property with that name, or NULL
+static List *propertyValues(const Card *card, const char *name)
+{
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *property;
+    while ((property = nextElement(&iter)) != NULL)
+    {
+        if (strcmp(property->name, name) == 0)
+        {
+            return property->values;
+        }
+    }
+    return NULL;
+}
+
+// Returns the value at index in a values list, or NULL
+static const char *valueAt(const List *values, int index)
+{
+    if (values == NULL)
+    {
+        return NULL;
+    }
+    ListIterator iter = createIterator((List *)values);
+    char *value;
+    for (int i = 0; (value = nextElement(&iter)) != NULL; i++)
+    {
+        if (i == index)
+        {
+            return value;
+        }
+    }
+    return NULL;
+}
+
+static bool valueIs(const List *values, int index, const char *expected)
+{
+    const char *value = valueAt(values, index);
+    return value != NULL && strcmp(value, expected) == 0;
+}
+
+// Parses text, writes the card and parses the file again
+/*
+@param test - the test name, for the failures
+@param text - the card
+@param card - receives the parsed card, NULL if it failed
+@param reparsed - receives the card read back from the written file, NULL if it failed
+@return the written file, freed with vcFree; NULL if a step failed
+*/
+static char *roundTrip(const char *test, const char *text, Card **card, Card **reparsed)
+{
+    *card = NULL;
+    *reparsed = NULL;
+    VCardErrorCode error = createCardFromBuffer(text, strlen(text), card);
+    CHECK(test, error == OK);
+    if (error != OK)
+    {
+        *card = NULL;
+        return NULL;
+    }
+    CHECK(test, writeCard(TEST_FILE, *card) == OK);
+    error = createCard(TEST_FILE, reparsed);
+    CHECK(test, error == OK);
+    if (error != OK)
+    {
+        *reparsed = NULL;
+    }
+    char *written = readTestFile();
+    remove(TEST_FILE);
+    CHECK(test, written != NULL);
+    return written;
+}
+
+// Every escape of RFC 6350 3.4 in single values, comma lists and structured values, plus one it does not know,
+// whose backslash is dropped
+static void testEscapeRoundTrip(void)
+{
+    const char *test = "escapeRoundTrip";
+    const char *text = "BEGIN:VCARD\r\n"
+                       "VERSION:4.0\r\n"
+                       "FN:Doe\\, John\r\n"
+                       "N:Doe\\,Jr;John\\;Q;;Dr\\\\;\r\n"
+                       "CATEGORIES:a,b\\,c\r\n"
+                       "NICKNAME:Bob\\,by,Rob\r\n"
+                       "NOTE:semi\\;colon\\, comma\\\\ back\\nline\\Nbreak \\x end\r\n"
+                       "TITLE:trailing\\\\\r\n"
+                       "GEO:geo:46.772673,-71.282945\r\n"
+                       "TEL;VALUE=uri:tel:+1-418-656-9254,ext=102\r\n"
+                       "END:VCARD\r\n";
+    Card *card;
+    Card *reparsed;
+    char *written = roundTrip(test, text, &card, &reparsed);
+    if (written != NULL)
+    {
+        CHECK(test, strstr(written, "\r\nFN:Doe\\, John\r\n") != NULL);
+        CHECK(test, strstr(written, "\r\nN:Doe\\,Jr;John\\;Q;;Dr\\\\;\r\n") != NULL);
+        CHECK(test, strstr(written, "\r\nCATEGORIES:a,b\\,c\r\n") != NULL);
+        CHECK(test, strstr(written, "\r\nNICKNAME:Bob\\,by,Rob\r\n") != NULL);
+        CHECK(test, strstr(written, "\r\nNOTE:semi\\;colon\\, comma\\\\ back\\nline\\nbreak x end\r\n") != NULL);
+        CHECK(test, strstr(written, "\r\nTITLE:trailing\\\\\r\n") != NULL);
+        CHECK(test, strstr(written, "\r\nGEO:geo:46.772673,-71.282945\r\n") != NULL); // URIs keep their commas
+        CHECK(test, strstr(written, "\r\nTEL;VALUE=uri:tel:+1-418-656-9254,ext=102\r\n") != NULL);
+    }
+    for (int pass = 0; pass < 2; pass++)
+    {
+        Card *c = pass == 0 ? card : reparsed;
+        if (c == NULL)
+        {
+            continue;
+        }
+        CHECK(test, valueIs(c->fn->values, 0, "Doe, John"));
+        CHECK(test, valueIs(propertyValues(c, "CATEGORIES"), 0, "a,b\\,c"));
+        CHECK(test, valueIs(propertyValues(c, "NOTE"), 0, "semi;colon, comma\\ back\nline\nbreak x end"));
+        CHECK(test, valueIs(propertyValues(c, "TITLE"), 0, "trailing\\"));
+    }
+    if (card != NULL && reparsed != NULL)
+    {
+        char *first = cardToString(card);
+        char *second = cardToString(reparsed);
+        CHECK(test, first != NULL && second != NULL && strcmp(first, second) == 0);
+        vcFree(first);
+        vcFree(second);
+    }
+    vcFree(written);
+    deleteCard(card);
+    deleteCard(reparsed);
+}
+
+// Parameter names and values longer than the old fixed 30 byte buffers, from a 3.0 card and a 4.0 date-time
+static void testLongParameters(void)
+{
+    const char *test = "longParameters";
+    const char *text = "BEGIN:VCARD\r\n"
+                       "VERSION:3.0\r\n"
+                       "FN:Jane\r\n"
+                       "TEL;TYPE=WORK,VOICE,PREF,MSG,CELL,VIDEO,PAGER:+1 555\r\n"
+                       "X-A-VERY-LONG-EXTENSION-PROPERTY;X-A-VERY-LONG-PARAMETER-NAME-INDEED=1:x\r\n"
+                       "BDAY:1234567890123456789012345678901234567890T102200\r\n"
+                       "END:VCARD\r\n";
+    Card *card = NULL;
+    VCardErrorCode error = createCardFromBuffer(text, strlen(text), &card);
+    CHECK(test, error == OK);
+    if (error != OK)
+    {
+        return;
+    }
+    List *tel = NULL;
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *property;
+    while ((property = nextElement(&iter)) != NULL)
+    {
+        if (strcmp(property->name, "TEL") == 0)
+        {
+            tel = property->parameters;
+        }
+    }
+    const Parameter *type = tel != NULL ? getFromFront(tel) : NULL;
+    CHECK(test, type != NULL && strcmp(type->value, "WORK,VOICE,PREF,MSG,CELL,VIDEO,PAGER") == 0);
+    CHECK(test, card->birthday != NULL && strcmp(card->birthday->date, "1234567890123456789012345678901234567890") == 0);
+    deleteCard(card);
+}
+
+// Date-only values shorter than YYYYMMDD, the date is copied as it is
+static void testShortDates(void)
+{
+    const char *test = "shortDates";
+    const char *values[] = {"BDAY:", "BDAY:1", "ANNIVERSARY:2"};
+    const char *dates[] = {"", "1", "2"};
+    for (int i = 0; i < 3; i++)
+    {
+        char text[128];
+        snprintf(text, sizeof(text), "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\n%s\r\nEND:VCARD\r\n", values[i]);
+        Card *card = NULL;
+        VCardErrorCode error = createCardFromBuffer(text, strlen(text), &card);
+        if (error != OK)
+        {
+            CHECK(test, card == NULL); // An empty value may be rejected, but must not be read past
+            continue;
+        }
+        const DateTime *date = i < 2 ? card->birthday : card->anniversary;
+        CHECK(test, date != NULL && strcmp(date->date, dates[i]) == 0);
+        deleteCard(card);
+    }
+}
+
+// Base64 values are left as they are in the file, a backslash in one must not shift the text after it
+static void testBlobValueEscapes(void)
+{
+    const char *test = "blobValueEscapes";
+    const char *text = "BEGIN:VCARD\r\n"
+                       "VERSION:4.0\r\n"
+                       "FN:Jane\r\n"
+                       "PHOTO;ENCODING=b:A\\,BCDEFGHIJKLMNOPQRS\\nTUVWXYZabcdefghijklmnop\r\n"
+                       "NOTE:A\\,BCDEFGHIJKLMNOPQRS\\nTUVWXYZabcdefghijklmnop\r\n"
+                       "END:VCARD\r\n";
+    Card *card = NULL;
+    VCardErrorCode error = createCardFromBuffer(text, strlen(text), &card);
+    CHECK(test, error == OK);
+    if (error != OK)
+    {
+        return;
+    }
+    CHECK(test, valueIs(propertyValues(card, "PHOTO"), 0, "A\\,BCDEFGHIJKLMNOPQRS\\nTUVWXYZabcdefghijklmnop"));
+    CHECK(test, valueIs(propertyValues(card, "NOTE"), 0, "A,BCDEFGHIJKLMNOPQRS\nTUVWXYZabcdefghijklmnop"));
+    deleteCard(card);
+}
+
+// An incremental write of a 2.1 card whose lines are in writeCard's order still writes a whole 4.0 card
+static void testLegacyIncrementalWrite(void)
+{
+    const char *test = "legacyIncrementalWrite";
+    const char *text = "BEGIN:VCARD\r\n"
+                       "VERSION:2.1\r\n"
+                       "FN:Jane Doe\r\n"
+                       "N:Doe;Jane\r\n"
+                       "NOTE;ENCODING=QUOTED-PRINTABLE:caf=C3=A9\r\n"
+                       "TEL;WORK;VOICE:+1 555\r\n"
+                       "END:VCARD\r\n";
+    CHECK(test, writeTestFile(text));
+    Card *card = NULL;
+    CardSource *source = NULL;
+    VCardErrorCode error = createCardWithSource(TEST_FILE, &card, &source);
+    CHECK(test, error == OK);
+    if (error == OK)
+    {
+        CHECK(test, updateFN(card, "Jane Q. Doe") == OK);
+        CHECK(test, writeCardIncremental(TEST_FILE, card, source) == OK);
+        char *written = readTestFile();
+        CHECK(test, written != NULL && strstr(written, "\r\nVERSION:4.0\r\n") != NULL);
+        CHECK(test, written != NULL && strstr(written, "VERSION:2.1") == NULL);
+        CHECK(test, written != NULL && strstr(written, "\r\nTEL;TYPE=WORK;TYPE=VOICE:+1 555\r\n") != NULL);
+        CHECK(test, written != NULL && strstr(written, "\r\nNOTE:café\r\n") != NULL);
+        vcFree(written);
+
+        Card *reparsed = NULL;
+        CHECK(test, createCard(TEST_FILE, &reparsed) == OK);
+        CHECK(test, reparsed != NULL && valueIs(reparsed->fn->values, 0, "Jane Q. Doe"));
+        deleteCard(reparsed);
+        deleteCard(card);
+        deleteCardSource(source);
+    }
+    remove(TEST_FILE);
+}
+
+// A 2.1 base64 value as Outlook and Android export it: indented lines, then an empty line
+static void testLegacyBase64EmptyLine(void)
+{
+    const char *test = "legacyBase64EmptyLine";
+    const char *text = "BEGIN:VCARD\r\n"
+                       "VERSION:2.1\r\n"
+                       "FN:Jane Doe\r\n"
+                       "PHOTO;ENCODING=BASE64;TYPE=JPEG:\r\n"
+                       " SGVsbG8g\r\n"
+                       " d29ybGQ=\r\n"
+                       "\r\n"
+                       "EMAIL;INTERNET:jane@example.com\r\n"
+                       "END:VCARD\r\n";
+    Card *card = NULL;
+    VCardErrorCode error = createCardFromBuffer(text, strlen(text), &card);
+    CHECK(test, error == OK);
+    if (error != OK)
+    {
+        return;
+    }
+    CHECK(test, valueIs(propertyValues(card, "PHOTO"), 0, "SGVsbG8gd29ybGQ="));
+    CHECK(test, valueIs(propertyValues(card, "EMAIL"), 0, "jane@example.com"));
+    deleteCard(card);
+}
+
+// Copies a string with vcMalloc, for the properties built by hand
+static char *testString(const char *text)
+{
+    char *copy = vcMalloc(strlen(text) + 1);
+    if (copy != NULL)
+    {
+        strcpy(copy, text);
+    }
+    return copy;
+}
+
+static void testHandBuiltProperty(void)
+{
+    const char *test = "handBuiltProperty";
+    const char *text = "BEGIN:VCARD\r\n"
+                       "VERSION:4.0\r\n"
+                       "FN:Jane Doe\r\n"
+                       "END:VCARD\r\n";
+    Card *card = NULL;
+    VCardErrorCode error = createCardFromBuffer(text, strlen(text), &card);
+    CHECK(test, error == OK);
+    if (error != OK)
+    {
+        return;
+    }
+
+    // A property built field by field, like a caller of the public struct would
+    Property *property = vcMalloc(sizeof(Property));
+    property->name = testString("N");
+    property->group = testString("");
+    property->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
+    property->values = initializeList(&valueToString, &deleteValue, &compareValues);
+    insertBack(property->values, testString("Doe"));
+    insertBack(property->values, testString("Jane"));
+    insertBack(card->optionalProperties, property);
+
+    CHECK(test, getStructuredName(property) == NULL);
+    CHECK(test, refreshStructuredValue(property) == INV_PROP);
+    CHECK(test, writeCard(TEST_FILE, card) == OK);
+    char *written = readTestFile();
+    CHECK(test, written != NULL && strstr(written, "\r\nN:Doe;Jane;;;\r\n") != NULL);
+    vcFree(written);
+
+    // An FN without a name gets one of its own
+    card->fn->name[0] = '\0';
+    CHECK(test, updateFN(card, "John Doe") == OK);
+    CHECK(test, strcmp(card->fn->name, "FN") == 0);
+    CHECK(test, valueIs(card->fn->values, 0, "John Doe"));
+
+    Card *copy = NULL;
+    CHECK(test, cloneCard(card, &copy) == OK);
+    deleteCard(copy);
+    deleteCard(card);
+}
+
+// Writes a card with writeCardIncremental and checks the whole file, then that it reads back as the same card
+static void checkIncrementalWrite(const char *test, const Card *card, CardSource *source, const char *expected)
+{
+    CHECK(test, writeCardIncremental(TEST_FILE, card, source) == OK);
+    char *written = readTestFile();
+    CHECK(test, written != NULL && strcmp(written, expected) == 0);
+    if (written != NULL && strcmp(written, expected) != 0)
+    {
+        printf("  expected:\n%s  written:\n%s", expected, written);
+    }
+    vcFree(written);
+
+    Card *reparsed = NULL;
+    CHECK(test, createCard(TEST_FILE, &reparsed) == OK);
+    char *cardText = cardToString(card);
+    char *reparsedText = reparsed != NULL ? cardToString(reparsed) : NULL;
+    CHECK(test, cardText != NULL && reparsedText != NULL && strcmp(cardText, reparsedText) == 0);
+    vcFree(cardText);
+    vcFree(reparsedText);
+    deleteCard(reparsed);
+}
+
+// A file in another order than writeCard's (N in front of FN, BDAY last), with a group and a folded line:
+// every edit rewrites only its own part, the others keep their bytes
+static void testIncrementalWrite(void)
+{
+    const char *test = "incrementalWrite";
+    const char *text = "BEGIN:VCARD\r\n"
+                       "VERSION:4.0\r\n"
+                       "N:Doe;Jane;;;\r\n"
+                       "item1.EMAIL;TYPE=work:jane@example.com\r\n"
+                       "FN:Jane Doe\r\n"
+                       "NOTE:A note that is\r\n"
+                       "  folded\r\n"
+                       "BDAY:19850612\r\n"
+                       "END:VCARD\r\n";
+    CHECK(test, writeTestFile(text));
+    Card *card = NULL;
+    CardSource *source = NULL;
+    VCardErrorCode error = createCardWithSource(TEST_FILE, &card, &source);
+    CHECK(test, error == OK);
+    if (error != OK)
+    {
+        remove(TEST_FILE);
+        return;
+    }
+
+    // Same length, written in place
+    CHECK(test, updateFN(card, "John Doe") == OK);
+    checkIncrementalWrite(test, card, source,
+                          "BEGIN:VCARD\r\nVERSION:4.0\r\nN:Doe;Jane;;;\r\nitem1.EMAIL;TYPE=work:jane@example.com\r\n"
+                          "FN:John Doe\r\nNOTE:A note that is\r\n  folded\r\nBDAY:19850612\r\nEND:VCARD\r\n");
+
+    // Longer, and a part that comes after the optional properties in the file
+    CHECK(test, updateFN(card, "John Q. Doe") == OK);
+    CHECK(test, updateBirthday(card, "circa 1985") == OK);
+    checkIncrementalWrite(test, card, source,
+                          "BEGIN:VCARD\r\nVERSION:4.0\r\nN:Doe;Jane;;;\r\nitem1.EMAIL;TYPE=work:jane@example.com\r\n"
+                          "FN:John Q. Doe\r\nNOTE:A note that is\r\n  folded\r\nBDAY;VALUE=text:circa 1985\r\nEND:VCARD\r\n");
+
+    // Removal of a property between two others
+    Property *note = NULL;
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *property;
+    while ((property = nextElement(&iter)) != NULL)
+    {
+        if (strcmp(property->name, "NOTE") == 0)
+        {
+            note = property;
+        }
+    }
+    CHECK(test, note != NULL && deleteDataFromList(card->optionalProperties, note) == note);
+    deleteProperty(note);
+    checkIncrementalWrite(test, card, source,
+                          "BEGIN:VCARD\r\nVERSION:4.0\r\nN:Doe;Jane;;;\r\nitem1.EMAIL;TYPE=work:jane@example.com\r\n"
+                          "FN:John Q. Doe\r\nBDAY;VALUE=text:circa 1985\r\nEND:VCARD\r\n");
+
+    // Insertion: right after the property in front of it in the card
+    Property *tel = vcMalloc(sizeof(Property));
+    tel->name = testString("TEL");
+    tel->group = testString("");
+    tel->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
+    tel->values = initializeList(&valueToString, &deleteValue, &compareValues);
+    insertBack(tel->values, testString("+1 555"));
+    insertBack(card->optionalProperties, tel);
+    checkIncrementalWrite(test, card, source,
+                          "BEGIN:VCARD\r\nVERSION:4.0\r\nN:Doe;Jane;;;\r\nitem1.EMAIL;TYPE=work:jane@example.com\r\n"
+                          "TEL:+1 555\r\nFN:John Q. Doe\r\nBDAY;VALUE=text:circa 1985\r\nEND:VCARD\r\n");
+
+    // The spans follow the edits: another same-length edit still lands on FN
+    CHECK(test, updateFN(card, "Jane Q. Doe") == OK);
+    checkIncrementalWrite(test, card, source,
+                          "BEGIN:VCARD\r\nVERSION:4.0\r\nN:Doe;Jane;;;\r\nitem1.EMAIL;TYPE=work:jane@example.com\r\n"
+                          "TEL:+1 555\r\nFN:Jane Q. Doe\r\nBDAY;VALUE=text:circa 1985\r\nEND:VCARD\r\n");
+
+    deleteCard(card);
+    deleteCardSource(source);
+    remove(TEST_FILE);
+}
+
+// The events a watcher reported, in order
+typedef struct
+{
+    int count;
+    WatchEventType types[16];
+    char fileNames[16][32];
+    char fn[16][32]; // FN of the event's card, empty without one
+} WatchLog;
+
+static void logWatchEvent(const WatchEvent *event, void *context)
+{
+    WatchLog *log = context;
+    if (log->count == 16)
+    {
+        return;
+    }
+    log->types[log->count] = event->type;
+    snprintf(log->fileNames[log->count], 32, "%s", event->fileName);
+    const char *fn = event->card != NULL ? valueAt(event->card->fn->values, 0) : NULL;
+    snprintf(log->fn[log->count], 32, "%s", fn != NULL ? fn : "");
+    log->count++;
+}
+
+// Tells whether the log has an event of that type for a file, with that FN unless fn is NULL
+static bool logged(const WatchLog *log, WatchEventType type, const char *fileName, const char *fn)
+{
+    for (int i = 0; i < log->count; i++)
+    {
+        if (log->types[i] == type && strcmp(log->fileNames[i], fileName) == 0 && (fn == NULL || strcmp(log->fn[i], fn) == 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A file already there, one added, one changed, one that is not a valid card, one removed, then the directory moved away
+static void testWatchDirectory(void)
+{
+    const char *test = "watchDirectory";
+    const char *janeCard = "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jane\r\nEND:VCARD\r\n";
+    const char *johnCard = "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:John\r\nEND:VCARD\r\n";
+    const char *noFnCard = "BEGIN:VCARD\r\nVERSION:4.0\r\nNOTE:no FN\r\nEND:VCARD\r\n";
+    CHECK(test, mkdir("vctest.d", 0755) == 0);
+    CHECK(test, writeFileText("vctest.d/a.vcf", janeCard));
+
+    WatchLog log = {0};
+    CardWatcher *watcher = vcWatchDirectory("vctest.d", logWatchEvent, &log);
+    CHECK(test, watcher != NULL);
+    if (watcher == NULL)
+    {
+        remove("vctest.d/a.vcf");
+        remove("vctest.d");
+        return;
+    }
+    CHECK(test, log.count == 1 && logged(&log, WATCH_ADDED, "a.vcf", "Jane"));
+
+    log.count = 0;
+    CHECK(test, writeFileText("vctest.d/b.vcf", johnCard));
+    CHECK(test, vcProcessWatchEvents(watcher, 1000) == 1);
+    CHECK(test, logged(&log, WATCH_ADDED, "b.vcf", "John"));
+
+    log.count = 0;
+    CHECK(test, writeFileText("vctest.d/a.vcf", johnCard));
+    CHECK(test, vcProcessWatchEvents(watcher, 1000) == 1);
+    CHECK(test, logged(&log, WATCH_CHANGED, "a.vcf", "John"));
+    const Card *watched = vcGetWatchedCard(watcher, "a.vcf");
+    CHECK(test, watched != NULL && valueIs(watched->fn->values, 0, "John"));
+
+    log.count = 0;
+    CHECK(test, writeFileText("vctest.d/c.vcf", noFnCard));
+    CHECK(test, vcProcessWatchEvents(watcher, 1000) == 1);
+    CHECK(test, logged(&log, WATCH_INVALID, "c.vcf", ""));
+    CHECK(test, vcGetWatchedCard(watcher, "c.vcf") == NULL);
+
+    log.count = 0;
+    CHECK(test, remove("vctest.d/b.vcf") == 0);
+    CHECK(test, vcProcessWatchEvents(watcher, 1000) == 1);
+    CHECK(test, logged(&log, WATCH_REMOVED, "b.vcf", NULL));
+    CHECK(test, vcGetWatchedCard(watcher, "b.vcf") == NULL);
+
+    // The files of a directory that went away are reported as removed, then the watcher returns -1
+    log.count = 0;
+    CHECK(test, rename("vctest.d", "vctest.moved") == 0);
+    CHECK(test, vcProcessWatchEvents(watcher, 1000) >= 1);
+    CHECK(test, logged(&log, WATCH_REMOVED, "a.vcf", NULL));
+    CHECK(test, vcProcessWatchEvents(watcher, 0) == -1);
+    vcStopWatching(watcher);
+
+    remove("vctest.moved/a.vcf");
+    remove("vctest.moved/c.vcf");
+    remove("vctest.moved");
+}
+
+// A weak hash, so the keys share a few home slots and deletions have long probe runs to shift back
+static unsigned long lengthHash(const void *data)
+{
+    return strlen(data);
+}
+
+// Lookups through the hash index after deletions in the middle of probe runs, and after clearList
+static void testListIndex(void)
+{
+    const char *test = "listIndex";
+    List *list = initializeList(&valueToString, &deleteValue, &compareValues);
+    char key[16];
+    for (int i = 0; i < 200; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        insertBack(list, testString(key));
+    }
+    CHECK(test, createListIndex(list, lengthHash));
+
+    for (int i = 0; i < 200; i += 3)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        char *deleted = deleteDataFromList(list, key);
+        CHECK(test, deleted != NULL && strcmp(deleted, key) == 0);
+        vcFree(deleted);
+    }
+    bool found = true;
+    for (int i = 0; i < 200; i++)
+    {
+        snprintf(key, sizeof(key), "k%d", i);
+        const char *element = findIndexedElement(list, key);
+        found = found && (i % 3 == 0 ? element == NULL : element != NULL && strcmp(element, key) == 0);
+    }
+    CHECK(test, found);
+    CHECK(test, getLength(list) == 133);
+
+    // clearList empties the index too, and it keeps working for new elements
+    clearList(list);
+    CHECK(test, getLength(list) == 0 && findIndexedElement(list, "k1") == NULL);
+    insertBack(list, testString("k1"));
+    const char *element = findIndexedElement(list, "k1");
+    CHECK(test, element != NULL && strcmp(element, "k1") == 0);
+    CHECK(test, findIndexedElement(list, "k2") == NULL);
+    freeList(list);
+}
+
+// The same files through the io_uring loader (when the kernel has it) and the plain system call path,
+// in batches of two: every file gets what createCard gives it
+static void testLoader(void)
+{
+    const char *test = "loader";
+    char *fileNames[] = {"vctest-1.vcf", "vctest-missing.vcf", "vctest-2.vcf", "vctest-3.vcf", "vctest-4.vcf"};
+    const char *fns[] = {"Ann", NULL, NULL, "Bob", "Cy"};
+    const char *annCard = "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Ann\r\nEND:VCARD\r\n";
+    CHECK(test, writeFileText(fileNames[0], annCard));
+    CHECK(test, writeFileText(fileNames[2], "BEGIN:VCARD\r\nVERSION:4.0\r\nNOTE:no FN\r\nEND:VCARD\r\n"));
+    CHECK(test, writeFileText(fileNames[3], "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Bob\r\nEND:VCARD\r\n"));
+    CHECK(test, writeFileText(fileNames[4], "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Cy\r\nEND:VCARD\r\n"));
+
+    for (int ring = 0; ring < 2; ring++)
+    {
+        VCLoader *loader = createLoader(2, ring == 1);
+        CHECK(test, loader != NULL);
+        if (loader == NULL)
+        {
+            continue;
+        }
+        if (ring == 0)
+        {
+            CHECK(test, !loaderUsesIoUring(loader));
+        }
+
+        LoadedFile files[5];
+        loadFiles(loader, fileNames, 5, files);
+        CHECK(test, files[0].error == 0 && files[0].data != NULL && files[0].length == strlen(annCard) &&
+                        strcmp(files[0].data, annCard) == 0);
+        CHECK(test, files[1].error == ENOENT && files[1].data == NULL);
+        for (int i = 0; i < 5; i++)
+        {
+            vcFree(files[i].data);
+        }
+
+        Card *cards[5];
+        VCardErrorCode errors[5];
+        CHECK(test, createCardsFromFiles(loader, fileNames, 5, cards, errors) == 3);
+        for (int i = 0; i < 5; i++)
+        {
+            Card *expected = NULL;
+            VCardErrorCode error = createCard(fileNames[i], &expected);
+            CHECK(test, errors[i] == error);
+            CHECK(test, fns[i] == NULL ? cards[i] == NULL : cards[i] != NULL && valueIs(cards[i]->fn->values, 0, fns[i]));
+            deleteCard(expected);
+            deleteCard(cards[i]);
+        }
+        deleteLoader(loader);
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        remove(fileNames[i]);
+    }
+}
+
+#define PIPELINE_FILES 40
+
+// What the pipeline consumer saw
+typedef struct
+{
+    int count;
+    int order[PIPELINE_FILES]; // Indices in delivery order
+    bool rightCard;            // Every result had the card or error of its own file
+} PipelineLog;
+
+static void logPipelineResult(const PipelineResult *result, void *context)
+{
+    PipelineLog *log = context;
+    char fn[16];
+    snprintf(fn, sizeof(fn), "Card %d", result->index);
+    bool invalid = result->index % 10 == 9; // Those have no FN
+    if (log->count < PIPELINE_FILES)
+    {
+        log->order[log->count] = result->index;
+    }
+    log->count++;
+    log->rightCard = log->rightCard && (invalid ? result->card == NULL && result->error != OK
+                                                : result->card != NULL && valueIs(result->card->fn->values, 0, fn));
+    deleteCard(result->card);
+}
+
+// Ordered results come in input order even with small rings and several workers; unordered ones come once each
+static void testPipeline(void)
+{
+    const char *test = "pipeline";
+    char names[PIPELINE_FILES][32];
+    char *fileNames[PIPELINE_FILES];
+    for (int i = 0; i < PIPELINE_FILES; i++)
+    {
+        char text[128];
+        snprintf(names[i], sizeof(names[i]), "vctest-p%02d.vcf", i);
+        fileNames[i] = names[i];
+        if (i % 10 == 9)
+        {
+            snprintf(text, sizeof(text), "BEGIN:VCARD\r\nVERSION:4.0\r\nNOTE:%d\r\nEND:VCARD\r\n", i);
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Card %d\r\nEND:VCARD\r\n", i);
+        }
+        CHECK(test, writeFileText(names[i], text));
+    }
+
+    for (int ordered = 0; ordered < 2; ordered++)
+    {
+        PipelineOptions options;
+        initializePipelineOptions(&options);
+        options.workers = 4;
+        options.queueSize = 4;
+        options.ordered = ordered == 1;
+        PipelineLog log = {.rightCard = true};
+        CHECK(test, runPipeline(fileNames, PIPELINE_FILES, &options, logPipelineResult, &log) == PIPELINE_FILES - 4);
+        CHECK(test, log.count == PIPELINE_FILES && log.rightCard);
+
+        bool seen[PIPELINE_FILES] = {false};
+        bool inOrder = true;
+        bool once = true;
+        for (int i = 0; i < PIPELINE_FILES && i < log.count; i++)
+        {
+            int index = log.order[i];
+            once = once && index >= 0 && index < PIPELINE_FILES && !seen[index];
+            if (index >= 0 && index < PIPELINE_FILES)
+            {
+                seen[index] = true;
+            }
+            inOrder = inOrder && index == i;
+        }
+        CHECK(test, once);
+        CHECK(test, !options.ordered || inOrder);
+    }
+
+    for (int i = 0; i < PIPELINE_FILES; i++)
+    {
+        remove(names[i]);
+    }
+}
+
+// Versions of a shared card share their unchanged properties, and each one lives as long as its references
+static void testSharedCard(void)
+{
+    const char *test = "sharedCard";
+    const char *text = "BEGIN:VCARD\r\n"
+                       "VERSION:4.0\r\n"
+                       "FN:Jane\r\n"
+                       "EMAIL:jane@example.com\r\n"
+                       "BDAY:19850612\r\n"
+                       "END:VCARD\r\n";
+    Card *card = NULL;
+    VCardErrorCode error = createCardFromBuffer(text, strlen(text), &card);
+    CHECK(test, error == OK);
+    SharedCard *first = error == OK ? shareCard(card) : NULL;
+    CHECK(test, first != NULL);
+    if (first == NULL)
+    {
+        deleteCard(card);
+        return;
+    }
+    CHECK(test, sharedCardReferences(first) == 1);
+    CHECK(test, retainSharedCard(first) == first && sharedCardReferences(first) == 2);
+    releaseSharedCard(first);
+    CHECK(test, sharedCardReferences(first) == 1);
+
+    SharedCard *second = NULL;
+    SharedCard *rejected = NULL;
+    CHECK(test, updateSharedFN(first, "", &rejected) == INV_PROP && rejected == NULL);
+    CHECK(test, updateSharedFN(first, "John", &second) == OK);
+    if (second == NULL)
+    {
+        releaseSharedCard(first);
+        return;
+    }
+    const Card *before = sharedCardView(first);
+    const Card *after = sharedCardView(second);
+    CHECK(test, sharedCardReferences(second) == 1);
+    CHECK(test, valueIs(before->fn->values, 0, "Jane") && valueIs(after->fn->values, 0, "John"));
+    CHECK(test, getFromFront(before->optionalProperties) == getFromFront(after->optionalProperties));
+    CHECK(test, before->birthday == after->birthday);
+
+    // The old version goes first, the new one still has the shared parts
+    releaseSharedCard(first);
+    CHECK(test, valueIs(propertyValues(after, "EMAIL"), 0, "jane@example.com"));
+    CHECK(test, after->birthday != NULL && strcmp(after->birthday->date, "19850612") == 0);
+    CHECK(test, validateCard(after) == OK);
+    releaseSharedCard(second);
+}
+
+// Applies a patch to a copy of from and checks that the copy then reads like to
+static void checkPatch(const char *test, const Card *from, const Card *to, const Vector *patch)
+{
+    Card *copy = NULL;
+    CHECK(test, cloneCard(from, &copy) == OK);
+    if (copy == NULL)
+    {
+        return;
+    }
+    CHECK(test, applyCardPatch(copy, patch) == OK);
+    char *patched = cardToString(copy);
+    char *expected = cardToString(to);
+    CHECK(test, patched != NULL && expected != NULL && strcmp(patched, expected) == 0);
+    vcFree(patched);
+    vcFree(expected);
+    deleteCard(copy);
+}
+
+// diffCards and applyCardPatch round trips: removals, additions, a change, FN and the dates
+static void testCardPatch(void)
+{
+    const char *test = "cardPatch";
+    const char *fromText = "BEGIN:VCARD\r\n"
+                           "VERSION:4.0\r\n"
+                           "FN:Jane\r\n"
+                           "N:Doe;Jane;;;\r\n"
+                           "EMAIL;TYPE=work:jane@work.example\r\n"
+                           "TEL:+1 555\r\n"
+                           "NOTE:old\r\n"
+                           "BDAY:19850612\r\n"
+                           "END:VCARD\r\n";
+    const char *toText = "BEGIN:VCARD\r\n"
+                         "VERSION:4.0\r\n"
+                         "FN:Jane Doe\r\n"
+                         "ORG:Example\r\n"
+                         "N:Doe;Jane;;;\r\n"
+                         "TEL:+1 556\r\n"
+                         "NOTE:new\r\n"
+                         "item1.URL:https://example.com\r\n"
+                         "ANNIVERSARY:20100101\r\n"
+                         "END:VCARD\r\n";
+    Card *from = NULL;
+    Card *to = NULL;
+    CHECK(test, createCardFromBuffer(fromText, strlen(fromText), &from) == OK);
+    CHECK(test, createCardFromBuffer(toText, strlen(toText), &to) == OK);
+    if (from == NULL || to == NULL)
+    {
+        deleteCard(from);
+        deleteCard(to);
+        return;
+    }
+
+    Vector *same = diffCards(from, from);
+    CHECK(test, same != NULL && getVectorLength(same) == 0);
+    freeVector(same);
+
+    Vector *forward = diffCards(from, to);
+    Vector *backward = diffCards(to, from);
+    CHECK(test, forward != NULL && backward != NULL);
+    if (forward != NULL && backward != NULL)
+    {
+        checkPatch(test, from, to, forward);
+        checkPatch(test, from, to, forward); // The patch is not used up
+        checkPatch(test, to, from, backward);
+
+        // A patch that does not fit leaves the card as it was
+        const char *otherText = "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Other\r\nEND:VCARD\r\n";
+        Card *other = NULL;
+        CHECK(test, createCardFromBuffer(otherText, strlen(otherText), &other) == OK);
+        if (other != NULL)
+        {
+            char *before = cardToString(other);
+            CHECK(test, applyCardPatch(other, forward) == INV_PROP);
+            char *after = cardToString(other);
+            CHECK(test, before != NULL && after != NULL && strcmp(before, after) == 0);
+            vcFree(before);
+            vcFree(after);
+            deleteCard(other);
+        }
+    }
+    freeVector(forward);
+    freeVector(backward);
+    deleteCard(from);
+    deleteCard(to);
+}
+
+int main(void)
+{
+    testEscapeRoundTrip();
+    testLongParameters();
+    testShortDates();
+    testBlobValueEscapes();
+    testLegacyIncrementalWrite();
+    testLegacyBase64EmptyLine();
+    testHandBuiltProperty();
+    testIncrementalWrite();
+    testWatchDirectory();
+    testListIndex();
+    testLoader();
+    testPipeline();
+    testSharedCard();
+    testCardPatch();
+
+    if (failures == 0)
+    {
+        printf("All tests passed\n");
+    }
+    return failures;
+}